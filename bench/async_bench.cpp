@@ -9,6 +9,7 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/async.h"
 #include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/null_sink.h"
 
 #if defined(SPDLOG_USE_STD_FORMAT)
     #include <format>
@@ -32,6 +33,9 @@ using namespace spdlog::sinks;
 using namespace utils;
 
 void bench_mt(int howmany, std::shared_ptr<spdlog::logger> log, int thread_count);
+void bench_scaling(int howmany, int queue_size, int max_threads);
+void bench_batch_sizes(int howmany, int queue_size, int threads);
+void bench_wait_strategies(int howmany, int queue_size);
 
 #ifdef _MSC_VER
     #pragma warning(push)
@@ -128,6 +132,10 @@ int main(int argc, char *argv[]) {
                                                async_overflow_policy::overrun_oldest);
             bench_mt(howmany, std::move(logger), threads);
         }
+
+        bench_scaling(howmany, queue_size, threads);
+        bench_batch_sizes(howmany, queue_size, threads);
+        bench_wait_strategies(howmany, queue_size);
         spdlog::shutdown();
     } catch (std::exception &ex) {
         std::cerr << "Error: " << ex.what() << std::endl;
@@ -166,3 +174,74 @@ void bench_mt(int howmany, std::shared_ptr<spdlog::logger> logger, int thread_co
     auto delta_d = duration_cast<duration<double>>(delta).count();
     spdlog::info("Elapsed: {} secs\t {:L}/sec", delta_d, int(howmany / delta_d));
 }
+
+// compare the queue types with an increasing number of producer threads.
+// a null sink is used so the numbers reflect the queue and not the file io.
+void bench_scaling(int howmany, int queue_size, int max_threads) {
+    const std::pair<const char *, async_queue_type> queue_types[] = {
+        {"mutex", async_queue_type::mutex},
+        {"lock_free", async_queue_type::lock_free},
+        {"per_thread", async_queue_type::per_thread}};
+
+    for (const auto &qt : queue_types) {
+        spdlog::info("");
+        spdlog::info("*********************************");
+        spdlog::info("Scaling - Queue type: {}", qt.first);
+        spdlog::info("*********************************");
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            auto tp = std::make_shared<details::thread_pool>(queue_size, 1, qt.second);
+            auto null_sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+            auto logger =
+                std::make_shared<async_logger>("async_logger", std::move(null_sink),
+                                               std::move(tp), async_overflow_policy::block);
+            spdlog::info("Producer threads: {}", threads);
+            bench_mt(howmany, std::move(logger), threads);
+        }
+    }
+}
+
+// compare the number of messages the worker thread dequeues and sinks at once.
+void bench_batch_sizes(int howmany, int queue_size, int threads) {
+    const size_t batch_sizes[] = {1, 8, 64, 256};
+
+    spdlog::info("");
+    spdlog::info("*********************************");
+    spdlog::info("Batch sizes - Producer threads: {}", threads);
+    spdlog::info("*********************************");
+    for (auto batch_size : batch_sizes) {
+        details::thread_pool_options options;
+        options.q_max_items = static_cast<size_t>(queue_size);
+        options.max_batch_size = batch_size;
+        auto tp = std::make_shared<details::thread_pool>(options);
+        auto null_sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+        auto logger = std::make_shared<async_logger>("async_logger", std::move(null_sink),
+                                                     std::move(tp), async_overflow_policy::block);
+        spdlog::info("Batch size: {}", batch_size);
+        bench_mt(howmany, std::move(logger), threads);
+    }
+}
+
+// compare how the worker thread waits for messages, with a single producer thread.
+void bench_wait_strategies(int howmany, int queue_size) {
+    const std::pair<const char *, async_wait_strategy> wait_strategies[] = {
+        {"blocking", async_wait_strategy::blocking},
+        {"spin_park", async_wait_strategy::spin_park},
+        {"spin_yield", async_wait_strategy::spin_yield},
+        {"busy_spin", async_wait_strategy::busy_spin}};
+
+    spdlog::info("");
+    spdlog::info("*********************************");
+    spdlog::info("Wait strategies - Producer threads: 1");
+    spdlog::info("*********************************");
+    for (const auto &ws : wait_strategies) {
+        details::thread_pool_options options;
+        options.q_max_items = static_cast<size_t>(queue_size);
+        options.wait_strategy = ws.second;
+        auto tp = std::make_shared<details::thread_pool>(options);
+        auto null_sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+        auto logger = std::make_shared<async_logger>("async_logger", std::move(null_sink),
+                                                     std::move(tp), async_overflow_policy::block);
+        spdlog::info("Wait strategy: {}", ws.first);
+        bench_mt(howmany, std::move(logger), 1);
+    }
+}
@@ -7,6 +7,9 @@
 
 #include "spdlog/spdlog.h"
 #include "spdlog/pattern_formatter.h"
+#include "spdlog/compiled_pattern.h"
+#include "spdlog/json_formatter.h"
+#include "spdlog/details/json_escape.h"
 
 void bench_formatter(benchmark::State &state, std::string pattern) {
     auto formatter = spdlog::details::make_unique<spdlog::pattern_formatter>(pattern);
@@ -25,6 +28,76 @@ void bench_formatter(benchmark::State &state, std::string pattern) {
     }
 }
 
+// the fixed width integer kernels used by the time flags
+template <void (*Pad)(uint32_t, spdlog::memory_buf_t &)>
+void bench_pad(benchmark::State &state, uint32_t max) {
+    spdlog::memory_buf_t dest;
+    uint32_t n = 0;
+    for (auto _ : state) {
+        dest.clear();
+        Pad(n, dest);
+        benchmark::DoNotOptimize(dest);
+        n = n + 7 < max ? n + 7 : 0;
+    }
+}
+
+void pad2(uint32_t n, spdlog::memory_buf_t &dest) {
+    spdlog::details::fmt_helper::pad2(static_cast<int>(n), dest);
+}
+
+void bench_json_formatter(benchmark::State &state) {
+    auto formatter = spdlog::details::make_unique<spdlog::json_formatter>();
+    spdlog::memory_buf_t dest;
+    std::string logger_name = "logger-name";
+    const char *text =
+        "Hello. This is some message with length of 80                                   ";
+
+    spdlog::source_loc source_loc{"a/b/c/d/myfile.cpp", 123, "some_func()"};
+    spdlog::details::log_msg msg(source_loc, logger_name, spdlog::level::info, text);
+
+    for (auto _ : state) {
+        dest.clear();
+        formatter->format(msg, dest);
+        benchmark::DoNotOptimize(dest);
+    }
+}
+
+void bench_json_escape(benchmark::State &state, std::string text) {
+    spdlog::memory_buf_t dest;
+    for (auto _ : state) {
+        dest.clear();
+        spdlog::details::json::append_escaped(text, dest);
+        benchmark::DoNotOptimize(dest);
+    }
+}
+
+#ifdef SPDLOG_HAS_COMPILED_PATTERN
+template <spdlog::details::compiled::pattern_string Pattern>
+void bench_compiled_formatter(benchmark::State &state) {
+    auto formatter = spdlog::details::make_unique<spdlog::compiled_pattern<Pattern>>();
+    spdlog::memory_buf_t dest;
+    std::string logger_name = "logger-name";
+    const char *text =
+        "Hello. This is some message with length of 80                                   ";
+
+    spdlog::source_loc source_loc{"a/b/c/d/myfile.cpp", 123, "some_func()"};
+    spdlog::details::log_msg msg(source_loc, logger_name, spdlog::level::info, text);
+
+    for (auto _ : state) {
+        dest.clear();
+        formatter->format(msg, dest);
+        benchmark::DoNotOptimize(dest);
+    }
+}
+
+template <spdlog::details::compiled::pattern_string Pattern>
+void register_compiled_bench() {
+    auto name = std::string("compiled ") + Pattern.data;
+    benchmark::RegisterBenchmark(name.c_str(), &bench_compiled_formatter<Pattern>)
+        ->Iterations(2500000);
+}
+#endif
+
 void bench_formatters() {
     // basic patterns(single flag)
     std::string all_flags = "+vtPnlLaAbBcCYDmdHIMSefFprRTXzEisg@luioO%";
@@ -41,6 +114,14 @@ void bench_formatters() {
         //        benchmark::RegisterBenchmark(pattern.c_str(), &bench_formatter, pattern);
     }
 
+    benchmark::RegisterBenchmark("pad2", &bench_pad<pad2>, 100u);
+    benchmark::RegisterBenchmark("pad3", &bench_pad<spdlog::details::fmt_helper::pad3<uint32_t>>,
+                                 1000u);
+    benchmark::RegisterBenchmark("pad6", &bench_pad<spdlog::details::fmt_helper::pad6<uint32_t>>,
+                                 1000000u);
+    benchmark::RegisterBenchmark("pad9", &bench_pad<spdlog::details::fmt_helper::pad9<uint32_t>>,
+                                 1000000000u);
+
     // complex patterns
     std::vector<std::string> patterns = {
         "[%D %X] [%l] [%n] %v",
@@ -51,6 +132,27 @@ void bench_formatters() {
         benchmark::RegisterBenchmark(pattern.c_str(), &bench_formatter, pattern)
             ->Iterations(2500000);
     }
+
+    // json lines, and the same (unescaped) layout by a pattern
+    benchmark::RegisterBenchmark("json_formatter", &bench_json_formatter)->Iterations(2500000);
+    std::string json_pattern =
+        "{\"time\":\"%Y-%m-%dT%H:%M:%S.%f%z\",\"level\":\"%l\",\"logger\":\"%n\",\"thread\":%t,"
+        "\"source\":{\"file\":\"%s\",\"line\":%#,\"function\":\"%!\"},\"message\":\"%v\"}";
+    benchmark::RegisterBenchmark(json_pattern.c_str(), &bench_formatter, json_pattern)
+        ->Iterations(2500000);
+
+    std::string plain(80, 'x');
+    std::string quoted = plain;
+    quoted[20] = quoted[60] = '"';
+    benchmark::RegisterBenchmark("json escape 80 plain", &bench_json_escape, plain);
+    benchmark::RegisterBenchmark("json escape 80 with quotes", &bench_json_escape, quoted);
+
+#ifdef SPDLOG_HAS_COMPILED_PATTERN
+    // same patterns compiled at compile time
+    register_compiled_bench<"[%D %X] [%l] [%n] %v">();
+    register_compiled_bench<"[%Y-%m-%d %H:%M:%S.%e] [%l] [%n] %v">();
+    register_compiled_bench<"[%Y-%m-%d %H:%M:%S.%e] [%l] [%n] [%t] %v">();
+#endif
 }
 
 int main(int argc, char *argv[]) {
@@ -73,12 +73,17 @@ inline std::shared_ptr<spdlog::logger> create_async_nb(std::string logger_name,
 }
 
 // set global thread pool.
+inline void init_thread_pool(const details::thread_pool_options &options) {
+    details::registry::instance().set_tp(std::make_shared<details::thread_pool>(options));
+}
+
 inline void init_thread_pool(size_t q_size,
                              size_t thread_count,
                              std::function<void()> on_thread_start,
-                             std::function<void()> on_thread_stop) {
+                             std::function<void()> on_thread_stop,
+                             async_queue_type queue_type = async_queue_type::mutex) {
     auto tp = std::make_shared<details::thread_pool>(q_size, thread_count, on_thread_start,
-                                                     on_thread_stop);
+                                                     on_thread_stop, queue_type);
     details::registry::instance().set_tp(std::move(tp));
 }
 
@@ -93,6 +98,11 @@ inline void init_thread_pool(size_t q_size, size_t thread_count) {
         q_size, thread_count, [] {}, [] {});
 }
 
+inline void init_thread_pool(size_t q_size, size_t thread_count, async_queue_type queue_type) {
+    init_thread_pool(
+        q_size, thread_count, [] {}, [] {}, queue_type);
+}
+
 // get the global thread pool.
 inline std::shared_ptr<spdlog::details::thread_pool> thread_pool() {
     return details::registry::instance().get_tp();
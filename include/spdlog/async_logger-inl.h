@@ -7,6 +7,7 @@
     #include <spdlog/async_logger.h>
 #endif
 
+#include <spdlog/details/format_cache.h>
 #include <spdlog/details/thread_pool.h>
 #include <spdlog/sinks/sink.h>
 
@@ -31,45 +32,151 @@ SPDLOG_INLINE spdlog::async_logger::async_logger(std::string logger_name,
           std::move(logger_name), {std::move(single_sink)}, std::move(tp), overflow_policy) {}
 
 // send the log message to the thread pool
-SPDLOG_INLINE void spdlog::async_logger::sink_it_(const details::log_msg &msg){
-    SPDLOG_TRY{if (auto pool_ptr = thread_pool_.lock()){
-        pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
-}
-else {
-    throw_spdlog_ex("async log: thread pool doesn't exist anymore");
-}
+SPDLOG_INLINE void spdlog::async_logger::sink_it_(const details::log_msg &msg) {
+    SPDLOG_TRY {
+        details::thread_pool::producer_scope scope(*this);
+        if (scope.pool() != nullptr) {
+            scope.pool()->post_log(this, msg, overflow_policy_);
+        } else if (auto pool_ptr = thread_pool_.lock()) {
+            pool_ptr->post_log(pool_handle_(*pool_ptr), msg, overflow_policy_);
+        } else {
+            throw_spdlog_ex("async log: thread pool doesn't exist anymore");
+        }
+    }
+    SPDLOG_LOGGER_CATCH(msg.source)
 }
-SPDLOG_LOGGER_CATCH(msg.source)
+
+// send the packed message to the thread pool, to be formatted there
+SPDLOG_INLINE void spdlog::async_logger::sink_deferred_(const details::log_msg &msg,
+                                                       details::deferred_format_fn format_fn) {
+    SPDLOG_TRY {
+        details::thread_pool::producer_scope scope(*this);
+        if (scope.pool() != nullptr) {
+            scope.pool()->post_log(this, msg, overflow_policy_, format_fn);
+        } else if (auto pool_ptr = thread_pool_.lock()) {
+            pool_ptr->post_log(pool_handle_(*pool_ptr), msg, overflow_policy_, format_fn);
+        } else {
+            throw_spdlog_ex("async log: thread pool doesn't exist anymore");
+        }
+    }
+    SPDLOG_LOGGER_CATCH(msg.source)
 }
 
-// send flush request to the thread pool
-SPDLOG_INLINE void spdlog::async_logger::flush_(){SPDLOG_TRY{auto pool_ptr = thread_pool_.lock();
-if (!pool_ptr) {
-    throw_spdlog_ex("async flush: thread pool doesn't exist anymore");
+// reserve a record in the queue and format the message into it
+SPDLOG_INLINE bool spdlog::async_logger::sink_in_place_(const details::log_msg &msg,
+                                                       string_view_t fmt,
+                                                       fmt_lib::format_args args) {
+#ifdef SPDLOG_USE_STD_FORMAT
+    // std::vformat_to_n() doesn't take type erased args - format as usual
+    (void)msg;
+    (void)fmt;
+    (void)args;
+    return false;
+#else
+    // the usual path registers the logger and the thread with the pool
+    details::thread_pool::producer_scope scope(*this);
+    auto *pool_ptr = scope.pool();
+    if (pool_ptr == nullptr) {
+        return false;
+    }
+    auto size = reserve_size_.value.load(std::memory_order_relaxed);
+    details::log_reservation reservation;
+    auto status = pool_ptr->reserve_log(this, msg, size, overflow_policy_, reservation);
+    if (status != details::reserve_status::reserved) {
+        if (status == details::reserve_status::unsupported && size > reserve_size::min) {
+            // the grown reservation may not fit the queue - don't keep asking for it
+            reserve_size_.value.store(reserve_size::min, std::memory_order_relaxed);
+        }
+        return status == details::reserve_status::dropped;
+    }
+    // cancelled by the reservation's destructor if the formatting throws
+    auto result = fmt::vformat_to_n(reservation.data(), reservation.capacity(), fmt, args);
+    if (result.size <= reservation.capacity()) {
+        reservation.commit(result.size);
+        if (result.size < size / 4 && size > reserve_size::min) {
+            size = size / 2 > reserve_size::min ? size / 2 : reserve_size::min;
+            reserve_size_.value.store(size, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    // too big for the reservation. reserve enough for such messages from now on, unless it's
+    // an outlier bigger than the max.
+    if (result.size <= reserve_size::max) {
+        while (size < result.size && !reserve_size_.value.compare_exchange_weak(
+                                         size, result.size, std::memory_order_relaxed)) {
+        }
+    }
+    return false;
+#endif
 }
 
-std::future<void> future = pool_ptr->post_flush(shared_from_this(), overflow_policy_);
-// Wait for the flush operation to complete.
-// This might throw exception if the flush message get dropped because of overflow.
-future.get();
+// send flush request to the thread pool and wait until it was served
+SPDLOG_INLINE void spdlog::async_logger::flush_() {
+    SPDLOG_TRY {
+        auto pool_ptr = thread_pool_.lock();
+        if (!pool_ptr) {
+            throw_spdlog_ex("async flush: thread pool doesn't exist anymore");
+        }
+
+        auto flush_seq = flush_requests_.request();
+        pool_ptr->post_flush(pool_handle_(*pool_ptr), flush_seq, overflow_policy_);
+        if (!flush_requests_.wait(flush_seq)) {
+            throw_spdlog_ex("async flush: flush request was dropped (queue overflow)");
+        }
+    }
+    SPDLOG_LOGGER_CATCH(source_loc())
 }
-SPDLOG_LOGGER_CATCH(source_loc())
+
+SPDLOG_INLINE spdlog::async_logger *spdlog::async_logger::pool_handle_(
+    details::thread_pool &pool) {
+    if (registered_pool_.value.load(std::memory_order_acquire) == nullptr) {
+        pool.register_logger(shared_from_this());
+    }
+    pool.register_producer();
+    return this;
 }
 
 //
 // backend functions - called from the thread pool to do the actual job
 //
 SPDLOG_INLINE void spdlog::async_logger::backend_sink_it_(const details::log_msg &msg) {
+    backend_sink_batch_(&msg, 1);
+}
+
+// pass the whole batch to each sink before moving to the next sink
+SPDLOG_INLINE void spdlog::async_logger::backend_sink_batch_(const details::log_msg *msgs,
+                                                            size_t count) {
+    if (count == 0) {
+        return;
+    }
+    // sinks with the same pattern format each message once
+    auto fingerprint = sinks_fingerprint_.get(sinks_);
+    details::format_cache cache(msgs, fingerprint != 0 ? count : 0, fingerprint);
+    details::format_cache::scope cache_scope(cache);
     for (auto &sink : sinks_) {
-        if (sink->should_log(msg.level)) {
-            SPDLOG_TRY { sink->log(msg); }
-            SPDLOG_LOGGER_CATCH(msg.source)
+        SPDLOG_TRY { sink->log_batch(msgs, count); }
+        SPDLOG_LOGGER_CATCH(msgs[0].source)
+    }
+
+    // flush once if any of the messages requires it
+    for (size_t i = 0; i < count; i++) {
+        if (should_flush_(msgs[i])) {
+            backend_flush_();
+            break;
         }
     }
+}
 
-    if (should_flush_(msg)) {
-        backend_flush_();
+SPDLOG_INLINE bool spdlog::async_logger::backend_format_deferred_(
+    const details::log_msg &packed_msg,
+    details::deferred_format_fn format_fn,
+    memory_buf_t &dest) {
+    SPDLOG_TRY {
+        format_fn(packed_msg.payload, dest);
+        return true;
     }
+    SPDLOG_LOGGER_CATCH(packed_msg.source)
+    return false;
 }
 
 SPDLOG_INLINE void spdlog::async_logger::backend_flush_() {
@@ -79,8 +186,70 @@ SPDLOG_INLINE void spdlog::async_logger::backend_flush_() {
     }
 }
 
+SPDLOG_INLINE void spdlog::async_logger::backend_drop_flush_(size_t flush_seq) SPDLOG_NOEXCEPT {
+    SPDLOG_TRY { flush_requests_.drop(flush_seq); }
+    SPDLOG_CATCH_STD
+}
+
+SPDLOG_INLINE void spdlog::async_logger::backend_count_drop_() SPDLOG_NOEXCEPT {
+    dropped_.value.fetch_add(1, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::backend_complete_flush_(size_t flush_seq) {
+    if (flush_requests_.served(flush_seq)) {
+        return;
+    }
+    backend_flush_();
+    flush_requests_.complete(flush_seq);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::enable_deferred_formatting() {
+    deferred_formatting_.store(true, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::disable_deferred_formatting() {
+    deferred_formatting_.store(false, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::enable_in_place_formatting() {
+    in_place_formatting_.store(true, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::disable_in_place_formatting() {
+    in_place_formatting_.store(false, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::set_shard(size_t shard) {
+    shard_.value.store(shard, std::memory_order_relaxed);
+    shard_.pinned.store(true, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::shard() const {
+    return shard_.value.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::set_block_timeout(std::chrono::milliseconds timeout) {
+    block_timeout_ = timeout;
+}
+
+SPDLOG_INLINE std::chrono::milliseconds spdlog::async_logger::block_timeout() const {
+    return block_timeout_;
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::drop_counter() const {
+    return dropped_.value.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void spdlog::async_logger::reset_drop_counter() {
+    dropped_.value.store(0, std::memory_order_relaxed);
+}
+
 SPDLOG_INLINE std::shared_ptr<spdlog::logger> spdlog::async_logger::clone(std::string new_name) {
     auto cloned = std::make_shared<spdlog::async_logger>(*this);
     cloned->name_ = std::move(new_name);
+    if (!shard_.pinned.load(std::memory_order_relaxed)) {
+        cloned->shard_.value.store(std::hash<std::string>()(cloned->name_),
+                                   std::memory_order_relaxed);
+    }
     return cloned;
 }
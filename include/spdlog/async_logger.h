@@ -14,25 +14,54 @@
 // Upon destruction, logs all remaining messages in the queue before
 // destructing..
 
+#include <spdlog/details/flush_requests.h>
 #include <spdlog/logger.h>
 
 namespace spdlog {
 
 // Async overflow policy - block by default.
 enum class async_overflow_policy {
-    block,           // Block until message can be enqueued
-    overrun_oldest,  // Discard oldest message in the queue if full when trying to
-                     // add new item.
-    discard_new      // Discard new message if the queue is full when trying to add new item.
+    block,              // Block until message can be enqueued
+    overrun_oldest,     // Discard oldest message in the queue if full when trying to
+                        // add new item.
+    discard_new,        // Discard new message if the queue is full when trying to add new item.
+    block_with_timeout  // Block until message can be enqueued or the logger's block timeout
+                        // has passed, then discard it (see async_logger::set_block_timeout()).
+};
+
+// Queue implementation used by the thread pool.
+enum class async_queue_type {
+    mutex,      // Circular queue protected by a mutex and condition variables (default)
+    lock_free,  // Bounded lock-free queue. Producers never take a lock unless the queue is full
+                // under the block policy.
+    per_thread,  // Each producer thread pushes to its own lane (see
+                 // thread_pool_options::lane_max_items).
+                 // The pool threads merge the lanes in message time order.
+    byte_ring    // Variable length records packed in one preallocated byte arena.
+                 // The queue size is given in bytes instead of messages.
+};
+
+// How the pool threads wait for new messages.
+// With the spinning strategies the pool threads stay awake, so the producers never have to wake
+// them up (no system call on the logging path), at the cost of keeping a core busy.
+// With any strategy, the pool threads sleep while the pool holds no loggers (see
+// thread_pool::register_logger()).
+enum class async_wait_strategy {
+    blocking,    // Sleep until a producer wakes the thread up (default)
+    spin_park,   // Poll the queue for a while, then sleep as with blocking
+    spin_yield,  // Poll the queue for a while, then keep polling and yield between polls
+    busy_spin    // Poll the queue without ever yielding the core
 };
 
 namespace details {
 class thread_pool;
+struct async_msg;
 }
 
 class SPDLOG_API async_logger final : public std::enable_shared_from_this<async_logger>,
                                       public logger {
     friend class details::thread_pool;
+    friend struct details::async_msg;
 
 public:
     template <typename It>
@@ -43,7 +72,8 @@ public:
                  async_overflow_policy overflow_policy = async_overflow_policy::block)
         : logger(std::move(logger_name), begin, end),
           thread_pool_(std::move(tp)),
-          overflow_policy_(overflow_policy) {}
+          overflow_policy_(overflow_policy),
+          shard_(std::hash<std::string>()(name_)) {}
 
     async_logger(std::string logger_name,
                  sinks_init_list sinks_list,
@@ -57,15 +87,117 @@ public:
 
     std::shared_ptr<logger> clone(std::string new_name) override;
 
+    // deferred formatting support.
+    // copy the format string and args to the queue and format them in the thread pool,
+    // to take the formatting cost off the calling thread.
+    // only arithmetic, void pointer and string args are supported (strings are copied by value).
+    // log calls with other arg types, or while backtrace is enabled, are formatted as usual.
+    void enable_deferred_formatting();
+    void disable_deferred_formatting();
+
+    // in place formatting support (async_queue_type::byte_ring pools only).
+    // reserve a record in the queue and format the message straight into it, so the payload is
+    // copied once - from the formatter to the queue. the record is reserved for the size of the
+    // recent messages (256 to 4096 bytes) and trimmed to the message when written. a message
+    // that doesn't fit, log calls to the priority lane, and log calls while backtrace is enabled
+    // are posted as usual.
+    // the deferred formatting takes precedence for the args it supports.
+    // the pool threads process the messages behind a reserved record only once it's written, so
+    // under the block policy, arg types whose formatting logs to the same pool may deadlock.
+    void enable_in_place_formatting();
+    void disable_in_place_formatting();
+
+    // pin the logger to a shard of a sharded thread pool (see thread_pool_options::sharded).
+    // the pool thread of the shard is taken as shard % number of shards.
+    // by default the logger is pinned by the hash of its name.
+    // should be called before logging - messages already queued in the old shard aren't moved.
+    // a clone of the logger keeps the pinned shard, otherwise it's pinned by the hash of its name.
+    void set_shard(size_t shard);
+    size_t shard() const;
+
+    // how long to wait for room in the queue under async_overflow_policy::block_with_timeout.
+    // should be called before logging.
+    void set_block_timeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds block_timeout() const;
+
+    // number of messages of this logger dropped by the thread pool (overflow policy, queue
+    // budget). the pool wide counters are in thread_pool::stats().
+    size_t drop_counter() const;
+    void reset_drop_counter();
+
 protected:
     void sink_it_(const details::log_msg &msg) override;
+    void sink_deferred_(const details::log_msg &msg,
+                        details::deferred_format_fn format_fn) override;
+    bool sink_in_place_(const details::log_msg &msg,
+                        string_view_t fmt,
+                        fmt_lib::format_args args) override;
     void flush_() override;
     void backend_sink_it_(const details::log_msg &incoming_log_msg);
+    void backend_sink_batch_(const details::log_msg *msgs, size_t count);
+    // format a deferred message into dest. on failure report the error and return false.
+    bool backend_format_deferred_(const details::log_msg &packed_msg,
+                                  details::deferred_format_fn format_fn,
+                                  memory_buf_t &dest);
     void backend_flush_();
+    // flush the sinks unless flush request flush_seq was already served, and wake its waiters
+    void backend_complete_flush_(size_t flush_seq);
+    // flush request flush_seq was dropped by the queue (overflow policy), wake its waiter
+    void backend_drop_flush_(size_t flush_seq) SPDLOG_NOEXCEPT;
+    // a log message was dropped by the queue
+    void backend_count_drop_() SPDLOG_NOEXCEPT;
 
 private:
+    // the pool while it holds a reference to this logger (see thread_pool::register_logger()).
+    // producers post through it without locking thread_pool_ (see thread_pool::producer_scope).
+    // a copy of the logger starts unregistered.
+    struct registered_pool {
+        std::atomic<details::thread_pool *> value{nullptr};
+        registered_pool() = default;
+        registered_pool(const registered_pool &) {}
+    };
+
+    // the shard of the logger. hashed from the name unless pinned by set_shard().
+    // read by the producers, so it's atomic.
+    struct shard_pin {
+        std::atomic<size_t> value;
+        std::atomic<bool> pinned{false};
+        explicit shard_pin(size_t shard)
+            : value(shard) {}
+        shard_pin(const shard_pin &other)
+            : value(other.value.load(std::memory_order_relaxed)),
+              pinned(other.pinned.load(std::memory_order_relaxed)) {}
+    };
+
+    struct drop_count {
+        std::atomic<size_t> value{0};
+        drop_count() = default;
+        drop_count(const drop_count &) {}
+    };
+
+    // payload size to reserve for in place formatting. grows to the messages that didn't fit
+    // (up to max), halves when the messages take less than a quarter of it (down to min).
+    struct reserve_size {
+        static constexpr size_t min = 256;
+        static constexpr size_t max = 4096;
+        std::atomic<size_t> value{min};
+        reserve_size() = default;
+        reserve_size(const reserve_size &other)
+            : value(other.value.load(std::memory_order_relaxed)) {}
+    };
+
+    // the logger handle to put in the messages. registers the logger and the calling thread
+    // with the pool if needed.
+    async_logger *pool_handle_(details::thread_pool &pool);
+
     std::weak_ptr<details::thread_pool> thread_pool_;
     async_overflow_policy overflow_policy_;
+    shard_pin shard_;
+    std::chrono::milliseconds block_timeout_{100};
+    registered_pool registered_pool_;
+    details::flush_requests flush_requests_;
+    drop_count dropped_;
+    reserve_size reserve_size_;
 };
 }  // namespace spdlog
 
@@ -0,0 +1,312 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Pattern formatter compiled at compile time (requires C++20).
+// The pattern is parsed by the compiler into a sequence of flags, each formatted by inlined code,
+// so formatting a message makes no virtual calls per flag and no formatter objects are allocated.
+//
+// Usage:
+//   sink->set_formatter(
+//       std::make_unique<spdlog::compiled_pattern<"[%Y-%m-%d %H:%M:%S.%e] [%l] %v">>());
+//
+// Output is the same as of pattern_formatter with the same pattern.
+// Supported flags: %v %n %l %L %t %P %Y %C %m %d %H %I %M %S %e %f %F %E %p %D %x %R %T %X
+// %^ %$ %@ %s %g %# %! %%. Other flags, padding specs and custom flags fail to compile - use
+// pattern_formatter for those.
+//
+// SPDLOG_HAS_COMPILED_PATTERN is defined if supported by the compiler.
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+    #define SPDLOG_HAS_COMPILED_PATTERN
+
+    #include <spdlog/common.h>
+    #include <spdlog/details/fmt_helper.h>
+    #include <spdlog/details/log_msg.h>
+    #include <spdlog/details/os.h>
+    #include <spdlog/formatter.h>
+
+    #include <array>
+    #include <chrono>
+    #include <cstring>
+    #include <ctime>
+    #include <memory>
+    #include <string>
+    #include <utility>
+
+namespace spdlog {
+namespace details {
+namespace compiled {
+
+// pattern string usable as a template argument
+template <size_t N>
+struct pattern_string {
+    char data[N]{};
+
+    constexpr pattern_string(const char (&str)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            data[i] = str[i];
+        }
+    }
+
+    constexpr size_t size() const { return N - 1; }
+};
+
+// a flag, or a run of literal text [begin, end) of the pattern (flag 0)
+struct element {
+    char flag = 0;
+    bool padded = false;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+constexpr bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+// split the pattern the same way as pattern_formatter::compile_pattern_(). if out is null, only
+// count the elements.
+template <size_t N>
+constexpr size_t parse(const pattern_string<N> &pattern, element *out) {
+    size_t count = 0;
+    auto add = [&](element e) {
+        if (out != nullptr) {
+            out[count] = e;
+        }
+        count++;
+    };
+    size_t text_begin = 0;
+    size_t i = 0;
+    auto flush_text = [&] {
+        if (i > text_begin) {
+            add(element{0, false, text_begin, i});
+        }
+    };
+    while (i < pattern.size()) {
+        if (pattern.data[i] != '%') {
+            i++;
+            continue;
+        }
+        flush_text();
+        i++;
+        // skip the padspec (see pattern_formatter::handle_padspec_())
+        if (i < pattern.size() && (pattern.data[i] == '-' || pattern.data[i] == '=')) {
+            i++;
+        }
+        bool padded = false;
+        while (i < pattern.size() && is_digit(pattern.data[i])) {
+            padded = true;
+            i++;
+        }
+        if (padded && i < pattern.size() && pattern.data[i] == '!') {
+            i++;
+        }
+        if (i == pattern.size()) {
+            text_begin = i;
+            break;  // trailing '%' is ignored
+        }
+        if (pattern.data[i] == '%') {
+            add(element{0, false, i, i + 1});
+        } else {
+            add(element{pattern.data[i], padded, i, i + 1});
+        }
+        i++;
+        text_begin = i;
+    }
+    flush_text();
+    return count;
+}
+
+template <pattern_string Pattern>
+constexpr auto parse() {
+    std::array<element, parse(Pattern, nullptr)> elements{};
+    parse(Pattern, elements.data());
+    return elements;
+}
+
+constexpr bool needs_time(char flag) {
+    constexpr char time_flags[] = "YCmdHIMSpDxRTX";
+    for (auto f : time_flags) {
+        if (f != '\0' && f == flag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <pattern_string Pattern>
+constexpr bool needs_time() {
+    for (auto &e : parse<Pattern>()) {
+        if (needs_time(e.flag)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <char Flag>
+constexpr bool unsupported_flag = false;
+
+inline const char *short_filename(const char *filename) {
+    const char *result = filename;
+    for (const char *p = filename; *p != '\0'; ++p) {
+        for (const char *sep = os::folder_seps; *sep != '\0'; ++sep) {
+            if (*p == *sep) {
+                result = p + 1;
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace compiled
+}  // namespace details
+
+template <details::compiled::pattern_string Pattern>
+class compiled_pattern final : public formatter {
+public:
+    explicit compiled_pattern(pattern_time_type time_type = pattern_time_type::local,
+                              std::string eol = spdlog::details::os::default_eol)
+        : eol_(std::move(eol)),
+          pattern_time_type_(time_type) {
+        std::memset(&cached_tm_, 0, sizeof(cached_tm_));
+    }
+
+    std::unique_ptr<formatter> clone() const override {
+        return details::make_unique<compiled_pattern>(pattern_time_type_, eol_);
+    }
+
+    void format(const details::log_msg &msg, memory_buf_t &dest) override {
+        if constexpr (details::compiled::needs_time<Pattern>()) {
+            const auto secs =
+                std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+            if (secs != last_log_secs_) {
+                auto t = log_clock::to_time_t(msg.time);
+                cached_tm_ = pattern_time_type_ == pattern_time_type::local
+                                 ? details::os::localtime(t)
+                                 : details::os::gmtime(t);
+                last_log_secs_ = secs;
+            }
+        }
+        format_elements_(msg, dest, std::make_index_sequence<elements_.size()>{});
+        details::fmt_helper::append_string_view(eol_, dest);
+    }
+
+private:
+    static constexpr auto elements_ = details::compiled::parse<Pattern>();
+
+    std::string eol_;
+    pattern_time_type pattern_time_type_;
+    std::tm cached_tm_;
+    std::chrono::seconds last_log_secs_{0};
+
+    template <size_t... I>
+    void format_elements_(const details::log_msg &msg,
+                          memory_buf_t &dest,
+                          std::index_sequence<I...>) {
+        (format_element_<elements_[I]>(msg, dest), ...);
+    }
+
+    template <details::compiled::element E>
+    void format_element_(const details::log_msg &msg, memory_buf_t &dest) {
+        namespace fmt_helper = details::fmt_helper;
+        static_assert(!E.padded, "compiled_pattern: padding is not supported");
+        const std::tm &tm_time = cached_tm_;
+        if constexpr (E.flag == 0) {
+            dest.append(Pattern.data + E.begin, Pattern.data + E.end);
+        } else if constexpr (E.flag == 'v') {
+            fmt_helper::append_string_view(msg.payload, dest);
+        } else if constexpr (E.flag == 'n') {
+            fmt_helper::append_string_view(msg.logger_name, dest);
+        } else if constexpr (E.flag == 'l') {
+            fmt_helper::append_string_view(level::to_string_view(msg.level), dest);
+        } else if constexpr (E.flag == 'L') {
+            fmt_helper::append_string_view(level::to_short_c_str(msg.level), dest);
+        } else if constexpr (E.flag == 't') {
+            fmt_helper::append_int(msg.thread_id, dest);
+        } else if constexpr (E.flag == 'P') {
+            fmt_helper::append_int(static_cast<uint32_t>(details::os::pid()), dest);
+        } else if constexpr (E.flag == 'Y') {
+            fmt_helper::append_int(tm_time.tm_year + 1900, dest);
+        } else if constexpr (E.flag == 'C') {
+            fmt_helper::pad2(tm_time.tm_year % 100, dest);
+        } else if constexpr (E.flag == 'm') {
+            fmt_helper::pad2(tm_time.tm_mon + 1, dest);
+        } else if constexpr (E.flag == 'd') {
+            fmt_helper::pad2(tm_time.tm_mday, dest);
+        } else if constexpr (E.flag == 'H') {
+            fmt_helper::pad2(tm_time.tm_hour, dest);
+        } else if constexpr (E.flag == 'I') {
+            fmt_helper::pad2(tm_time.tm_hour > 12 ? tm_time.tm_hour - 12 : tm_time.tm_hour, dest);
+        } else if constexpr (E.flag == 'M') {
+            fmt_helper::pad2(tm_time.tm_min, dest);
+        } else if constexpr (E.flag == 'S') {
+            fmt_helper::pad2(tm_time.tm_sec, dest);
+        } else if constexpr (E.flag == 'e') {
+            auto millis = fmt_helper::time_fraction<std::chrono::milliseconds>(msg.time);
+            fmt_helper::pad3(static_cast<uint32_t>(millis.count()), dest);
+        } else if constexpr (E.flag == 'f') {
+            auto micros = fmt_helper::time_fraction<std::chrono::microseconds>(msg.time);
+            fmt_helper::pad6(static_cast<size_t>(micros.count()), dest);
+        } else if constexpr (E.flag == 'F') {
+            auto ns = fmt_helper::time_fraction<std::chrono::nanoseconds>(msg.time);
+            fmt_helper::pad9(static_cast<size_t>(ns.count()), dest);
+        } else if constexpr (E.flag == 'E') {
+            auto duration = msg.time.time_since_epoch();
+            fmt_helper::append_int(
+                std::chrono::duration_cast<std::chrono::seconds>(duration).count(), dest);
+        } else if constexpr (E.flag == 'p') {
+            fmt_helper::append_string_view(tm_time.tm_hour >= 12 ? "PM" : "AM", dest);
+        } else if constexpr (E.flag == 'D' || E.flag == 'x') {
+            fmt_helper::pad2(tm_time.tm_mon + 1, dest);
+            dest.push_back('/');
+            fmt_helper::pad2(tm_time.tm_mday, dest);
+            dest.push_back('/');
+            fmt_helper::pad2(tm_time.tm_year % 100, dest);
+        } else if constexpr (E.flag == 'R') {
+            fmt_helper::pad2(tm_time.tm_hour, dest);
+            dest.push_back(':');
+            fmt_helper::pad2(tm_time.tm_min, dest);
+        } else if constexpr (E.flag == 'T' || E.flag == 'X') {
+            fmt_helper::pad2(tm_time.tm_hour, dest);
+            dest.push_back(':');
+            fmt_helper::pad2(tm_time.tm_min, dest);
+            dest.push_back(':');
+            fmt_helper::pad2(tm_time.tm_sec, dest);
+        } else if constexpr (E.flag == '^') {
+            msg.color_range_start = dest.size();
+        } else if constexpr (E.flag == '$') {
+            msg.color_range_end = dest.size();
+        } else if constexpr (E.flag == '@') {
+            if (!msg.source.empty()) {
+                fmt_helper::append_string_view(msg.source.filename, dest);
+                dest.push_back(':');
+                fmt_helper::append_int(msg.source.line, dest);
+            }
+        } else if constexpr (E.flag == 's') {
+            if (!msg.source.empty()) {
+                fmt_helper::append_string_view(
+                    details::compiled::short_filename(msg.source.filename), dest);
+            }
+        } else if constexpr (E.flag == 'g') {
+            if (!msg.source.empty()) {
+                fmt_helper::append_string_view(msg.source.filename, dest);
+            }
+        } else if constexpr (E.flag == '#') {
+            if (!msg.source.empty()) {
+                fmt_helper::append_int(msg.source.line, dest);
+            }
+        } else if constexpr (E.flag == '!') {
+            if (!msg.source.empty()) {
+                fmt_helper::append_string_view(msg.source.funcname, dest);
+            }
+        } else {
+            static_assert(details::compiled::unsupported_flag<E.flag>,
+                          "compiled_pattern: unsupported flag - use pattern_formatter");
+        }
+    }
+};
+
+}  // namespace spdlog
+
+#endif
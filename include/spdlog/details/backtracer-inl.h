@@ -18,12 +18,14 @@ SPDLOG_INLINE backtracer::backtracer(backtracer &&other) SPDLOG_NOEXCEPT {
     std::lock_guard<std::mutex> lock(other.mutex_);
     enabled_ = other.enabled();
     messages_ = std::move(other.messages_);
+    charge_ = std::move(other.charge_);
 }
 
 SPDLOG_INLINE backtracer &backtracer::operator=(backtracer other) {
     std::lock_guard<std::mutex> lock(mutex_);
     enabled_ = other.enabled();
     messages_ = std::move(other.messages_);
+    charge_ = std::move(other.charge_);
     return *this;
 }
 
@@ -31,6 +33,7 @@ SPDLOG_INLINE void backtracer::enable(size_t size) {
     std::lock_guard<std::mutex> lock{mutex_};
     enabled_.store(true, std::memory_order_relaxed);
     messages_ = circular_q<log_msg_buffer>{size};
+    charge_.reset();
 }
 
 SPDLOG_INLINE void backtracer::disable() {
@@ -42,7 +45,7 @@ SPDLOG_INLINE bool backtracer::enabled() const { return enabled_.load(std::memor
 
 SPDLOG_INLINE void backtracer::push_back(const log_msg &msg) {
     std::lock_guard<std::mutex> lock{mutex_};
-    messages_.push_back(log_msg_buffer{msg});
+    push_charged(messages_, charge_, msg);
 }
 
 SPDLOG_INLINE bool backtracer::empty() const {
@@ -56,7 +59,7 @@ SPDLOG_INLINE void backtracer::foreach_pop(std::function<void(const details::log
     while (!messages_.empty()) {
         auto &front_msg = messages_.front();
         fun(front_msg);
-        messages_.pop_front();
+        pop_charged(messages_, charge_);
     }
 }
 }  // namespace details
@@ -5,6 +5,7 @@
 
 #include <spdlog/details/circular_q.h>
 #include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/details/memory_budget.h>
 
 #include <atomic>
 #include <functional>
@@ -19,6 +20,7 @@ class SPDLOG_API backtracer {
     mutable std::mutex mutex_;
     std::atomic<bool> enabled_{false};
     circular_q<log_msg_buffer> messages_;
+    memory_charge charge_;  // the bytes of messages_ (see memory_budget::global())
 
 public:
     backtracer() = default;
@@ -0,0 +1,415 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+    #include <spdlog/details/binary_format.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+
+namespace spdlog {
+namespace details {
+namespace binary {
+
+// frames larger than this are considered corrupted
+static constexpr uint64_t max_frame_size = uint64_t(1) << 30;
+
+static void append_byte(unsigned char b, memory_buf_t &dest) {
+    dest.push_back(static_cast<char>(b));
+}
+
+// write the varint at p, return its end
+static char *write_varint(uint64_t n, char *p) {
+    while (n >= 0x80) {
+        *p++ = static_cast<char>(n | 0x80);
+        n >>= 7;
+    }
+    *p++ = static_cast<char>(n);
+    return p;
+}
+
+static constexpr size_t max_varint_size = 10;
+
+static void append_varint(uint64_t n, memory_buf_t &dest) {
+    char buf[max_varint_size];
+    dest.append(buf, write_varint(n, buf));
+}
+
+static size_t varint_size(uint64_t n) {
+    size_t size = 1;
+    while (n >= 0x80) {
+        n >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static uint64_t zigzag_encode(int64_t n) {
+    return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t n) {
+    return static_cast<int64_t>((n >> 1) ^ (~(n & 1) + 1));
+}
+
+static int64_t to_nanoseconds(log_clock::time_point tp) {
+    return static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count());
+}
+
+// reads the fields of a frame body, throws if past its end
+class cursor {
+public:
+    cursor(const char *begin, const char *end)
+        : p_(begin),
+          end_(end) {}
+
+    unsigned char byte() {
+        need_(1);
+        return static_cast<unsigned char>(*p_++);
+    }
+
+    uint64_t varint() {
+        uint64_t n = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            auto b = byte();
+            n |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return n;
+            }
+        }
+        throw_spdlog_ex("binary_reader: corrupted varint");
+    }
+
+    string_view_t bytes(uint64_t size) {
+        need_(size);
+        string_view_t s(p_, static_cast<size_t>(size));
+        p_ += size;
+        return s;
+    }
+
+    string_view_t rest() { return bytes(static_cast<uint64_t>(end_ - p_)); }
+
+private:
+    const char *p_;
+    const char *end_;
+
+    void need_(uint64_t size) const {
+        if (size > static_cast<uint64_t>(end_ - p_)) {
+            throw_spdlog_ex("binary_reader: corrupted frame");
+        }
+    }
+};
+
+}  // namespace binary
+
+SPDLOG_INLINE size_t binary_encoder::view_hash::operator()(string_view_t s) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto ch : s) {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+SPDLOG_INLINE void binary_encoder::begin_session(memory_buf_t &dest) {
+    ids_.clear();
+    strings_.clear();
+    last_logger_id_ = 0;
+    last_time_ = 0;
+
+    body_.clear();
+    auto magic = binary::magic();
+    body_.append(magic.data(), magic.data() + magic.size());
+    binary::append_varint(binary::version, body_);
+    append_frame_(binary::frame_kind::session, body_, dest);
+}
+
+SPDLOG_INLINE void binary_encoder::encode(const log_msg &msg, memory_buf_t &dest) {
+    using binary::write_varint;
+    // intern the strings first, their frames must precede the record
+    auto logger_id = intern_logger_name_(msg.logger_name, dest);
+    uint32_t file_id = 0;
+    uint32_t function_id = 0;
+    if (!msg.source.empty()) {
+        file_id = msg.source.filename ? intern_(msg.source.filename, dest) : 0;
+        function_id = msg.source.funcname ? intern_(msg.source.funcname, dest) : 0;
+    }
+    body_.clear();
+    if (!msg.fields.empty()) {
+        encode_fields_(msg.fields, dest);
+    }
+
+    // the fixed part of the record, up to the fields
+    char head[8 * binary::max_varint_size];
+    char *p = head;
+    auto time = binary::to_nanoseconds(msg.time);
+    p = write_varint(binary::zigzag_encode(time - last_time_), p);
+    last_time_ = time;
+    *p++ = static_cast<char>(msg.level);
+    p = write_varint(msg.thread_id, p);
+    p = write_varint(logger_id, p);
+    p = write_varint(static_cast<uint32_t>(msg.source.line), p);
+    if (!msg.source.empty()) {
+        p = write_varint(file_id, p);
+        p = write_varint(function_id, p);
+    }
+    p = write_varint(msg.fields.size(), p);
+    auto head_size = static_cast<size_t>(p - head);
+
+    // write the frame in place
+    auto body_size = head_size + body_.size() + msg.payload.size();
+    auto start = dest.size();
+    dest.resize(start + 1 + binary::varint_size(body_size) + body_size);
+    char *out = dest.data() + start;
+    *out++ = static_cast<char>(binary::frame_kind::record);
+    out = write_varint(body_size, out);
+    std::memcpy(out, head, head_size);
+    out += head_size;
+    if (body_.size() > 0) {
+        std::memcpy(out, body_.data(), body_.size());
+        out += body_.size();
+    }
+    if (msg.payload.size() > 0) {
+        std::memcpy(out, msg.payload.data(), msg.payload.size());
+    }
+}
+
+// encode the fields into body_
+SPDLOG_INLINE void binary_encoder::encode_fields_(field_list fields, memory_buf_t &dest) {
+    using binary::append_varint;
+    for (auto &f : fields) {
+        append_varint(intern_(f.key(), dest), body_);
+        binary::append_byte(static_cast<unsigned char>(f.type()), body_);
+        switch (f.type()) {
+            case field_type::signed_int:
+                append_varint(binary::zigzag_encode(f.signed_int()), body_);
+                break;
+            case field_type::unsigned_int:
+                append_varint(f.unsigned_int(), body_);
+                break;
+            case field_type::floating: {
+                double value = f.floating();
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                char bytes[8];
+                for (int i = 0; i < 8; i++) {
+                    bytes[i] = static_cast<char>(bits >> (i * 8));
+                }
+                body_.append(bytes, bytes + 8);
+                break;
+            }
+            case field_type::boolean:
+                binary::append_byte(f.boolean() ? 1 : 0, body_);
+                break;
+            case field_type::string: {
+                auto value = f.string();
+                append_varint(value.size(), body_);
+                body_.append(value.data(), value.data() + value.size());
+                break;
+            }
+        }
+    }
+}
+
+// most records are of the same logger as the previous one
+SPDLOG_INLINE uint32_t binary_encoder::intern_logger_name_(string_view_t name,
+                                                           memory_buf_t &dest) {
+    if (last_logger_id_ != 0) {
+        auto &last = strings_[last_logger_id_ - 1];
+        if (last.size() == name.size() && std::memcmp(last.data(), name.data(), name.size()) == 0) {
+            return last_logger_id_;
+        }
+    }
+    auto id = intern_(name, dest);
+    last_logger_id_ = id;
+    return id;
+}
+
+// return the id of the string, adding it to the dictionary (and writing its frame) if new
+SPDLOG_INLINE uint32_t binary_encoder::intern_(string_view_t s, memory_buf_t &dest) {
+    if (s.size() == 0) {
+        return 0;
+    }
+    auto it = ids_.find(s);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    strings_.emplace_back(s.data(), s.size());
+    auto id = static_cast<uint32_t>(strings_.size());
+    ids_.emplace(string_view_t(strings_.back().data(), s.size()), id);
+
+    binary::append_byte(static_cast<unsigned char>(binary::frame_kind::string), dest);
+    binary::append_varint(binary::varint_size(id) + s.size(), dest);
+    binary::append_varint(id, dest);
+    dest.append(s.data(), s.data() + s.size());
+    return id;
+}
+
+SPDLOG_INLINE void binary_encoder::append_frame_(binary::frame_kind kind,
+                                                 const memory_buf_t &body,
+                                                 memory_buf_t &dest) {
+    binary::append_byte(static_cast<unsigned char>(kind), dest);
+    binary::append_varint(body.size(), dest);
+    dest.append(body.data(), body.data() + body.size());
+}
+
+SPDLOG_INLINE binary_reader::binary_reader(std::istream &in)
+    : in_(in) {}
+
+SPDLOG_INLINE bool binary_reader::read(log_msg &msg) {
+    binary::frame_kind kind;
+    while (read_frame_(kind)) {
+        switch (kind) {
+            case binary::frame_kind::session:
+                read_session_();
+                break;
+            case binary::frame_kind::string:
+                read_string_();
+                break;
+            case binary::frame_kind::record:
+                read_record_(msg);
+                return true;
+            default:
+                break;  // written by a newer version
+        }
+    }
+    return false;
+}
+
+SPDLOG_INLINE bool binary_reader::read_frame_(binary::frame_kind &kind) {
+    auto c = in_.get();
+    if (c == std::char_traits<char>::eof()) {
+        return false;
+    }
+    kind = static_cast<binary::frame_kind>(c);
+    if (!in_session_ && kind != binary::frame_kind::session) {
+        throw_spdlog_ex("binary_reader: not a spdlog binary log");
+    }
+
+    uint64_t size = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        auto b = in_.get();
+        if (b == std::char_traits<char>::eof()) {
+            truncated_ = true;
+            return false;
+        }
+        if (shift >= 64) {
+            throw_spdlog_ex("binary_reader: corrupted frame size");
+        }
+        size |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+    if (size > binary::max_frame_size) {
+        throw_spdlog_ex("binary_reader: corrupted frame size");
+    }
+
+    frame_.resize(static_cast<size_t>(size));
+    in_.read(frame_.data(), static_cast<std::streamsize>(size));
+    if (static_cast<uint64_t>(in_.gcount()) != size) {
+        truncated_ = true;
+        return false;
+    }
+    return true;
+}
+
+SPDLOG_INLINE void binary_reader::read_session_() {
+    binary::cursor c(frame_.data(), frame_.data() + frame_.size());
+    auto magic = binary::magic();
+    if (frame_.size() < magic.size() ||
+        std::memcmp(c.bytes(magic.size()).data(), magic.data(), magic.size()) != 0) {
+        throw_spdlog_ex("binary_reader: not a spdlog binary log");
+    }
+    if (c.varint() > binary::version) {
+        throw_spdlog_ex("binary_reader: unsupported version of spdlog binary log");
+    }
+    strings_.assign(1, std::string());  // id 0
+    last_time_ = 0;
+    in_session_ = true;
+}
+
+SPDLOG_INLINE void binary_reader::read_string_() {
+    binary::cursor c(frame_.data(), frame_.data() + frame_.size());
+    if (c.varint() != strings_.size()) {
+        throw_spdlog_ex("binary_reader: corrupted dictionary");
+    }
+    auto text = c.rest();
+    strings_.emplace_back(text.data(), text.size());
+}
+
+SPDLOG_INLINE void binary_reader::read_record_(log_msg &msg) {
+    binary::cursor c(frame_.data(), frame_.data() + frame_.size());
+    msg = log_msg();
+
+    last_time_ += binary::zigzag_decode(c.varint());
+    msg.time = log_clock::time_point(std::chrono::duration_cast<log_clock::duration>(
+        std::chrono::nanoseconds(last_time_)));
+    auto level = c.byte();
+    if (level >= level::n_levels) {
+        throw_spdlog_ex("binary_reader: corrupted level");
+    }
+    msg.level = static_cast<level::level_enum>(level);
+    msg.thread_id = static_cast<size_t>(c.varint());
+    msg.logger_name = string_(c.varint());
+
+    msg.source.line = static_cast<int>(static_cast<uint32_t>(c.varint()));
+    if (!msg.source.empty()) {
+        auto file_id = c.varint();
+        auto function_id = c.varint();
+        msg.source.filename = file_id != 0 ? string_(file_id).c_str() : nullptr;
+        msg.source.funcname = function_id != 0 ? string_(function_id).c_str() : nullptr;
+    }
+
+    auto count = c.varint();
+    if (count > frame_.size()) {
+        throw_spdlog_ex("binary_reader: corrupted fields");
+    }
+    fields_.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        string_view_t key = string_(c.varint());
+        auto type = static_cast<field_type>(c.byte());
+        switch (type) {
+            case field_type::signed_int:
+                fields_.emplace_back(key, binary::zigzag_decode(c.varint()));
+                break;
+            case field_type::unsigned_int:
+                fields_.emplace_back(key, c.varint());
+                break;
+            case field_type::floating: {
+                uint64_t bits = 0;
+                for (int b = 0; b < 8; b++) {
+                    bits |= static_cast<uint64_t>(c.byte()) << (b * 8);
+                }
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                fields_.emplace_back(key, value);
+                break;
+            }
+            case field_type::boolean:
+                fields_.emplace_back(key, c.byte() != 0);
+                break;
+            case field_type::string:
+                fields_.emplace_back(key, c.bytes(c.varint()));
+                break;
+            default:
+                throw_spdlog_ex("binary_reader: corrupted fields");
+        }
+    }
+    msg.fields = field_list(fields_.data(), fields_.size());
+    msg.payload = c.rest();
+}
+
+SPDLOG_INLINE const std::string &binary_reader::string_(uint64_t id) const {
+    if (id >= strings_.size()) {
+        throw_spdlog_ex("binary_reader: unknown string id");
+    }
+    return strings_[static_cast<size_t>(id)];
+}
+
+}  // namespace details
+}  // namespace spdlog
@@ -0,0 +1,116 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Compact binary encoding of log messages (see sinks/binary_file_sink.h), decoded back to
+// log messages by binary_reader (e.g. by the spdlog-decode tool).
+//
+// The encoded stream is a sequence of frames: <kind:u8> <body size:varint> <body>.
+//   session - "spdlogbin" <version:varint>. Starts the stream and every reopening of it (e.g. a
+//             file appended to by a new process). Resets the dictionary and the time.
+//   string  - <id:varint> <text>. Adds a string to the dictionary. Ids are 1, 2, 3...
+//   record  - <time delta ns:zigzag varint> <level:u8> <thread id:varint> <logger name id:varint>
+//             <source line:varint> [<source file id:varint> <function id:varint> if line != 0]
+//             <fields count:varint> <field>... <payload: the rest of the body>
+//             field: <key id:varint> <type:u8> <value>, value by type - signed: zigzag varint,
+//             unsigned: varint, floating: 8 bytes (little endian), boolean: u8,
+//             string: <size:varint> <text>
+// Varints are little endian base 128. The time is relative to the previous record of the session
+// (to the epoch for the first one). Frames of unknown kinds are skipped by the reader.
+//
+// Logger names, source file/function names and field keys are interned in the dictionary, so
+// each is written once per session (id 0 is the empty string, or a missing file/function name).
+// A string frame is always written before the first record using it. The dictionary of the
+// encoder is kept for the whole session, so it grows with every distinct string - keep field
+// keys fixed rather than made up at run time.
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+namespace binary {
+
+enum class frame_kind : unsigned char { session = 1, string = 2, record = 3 };
+
+static constexpr unsigned version = 1;
+
+inline string_view_t magic() { return string_view_t("spdlogbin", 9); }
+
+}  // namespace binary
+
+class SPDLOG_API binary_encoder {
+public:
+    binary_encoder() = default;
+    binary_encoder(const binary_encoder &) = delete;
+    binary_encoder &operator=(const binary_encoder &) = delete;
+
+    // append a session frame to dest, and restart the dictionary and the time
+    void begin_session(memory_buf_t &dest);
+
+    // append the record frame of msg to dest, preceded by the string frames of its new strings
+    void encode(const log_msg &msg, memory_buf_t &dest);
+
+private:
+    struct view_hash {
+        size_t operator()(string_view_t s) const;
+    };
+
+    // the dictionary: ids of the strings written in the session (keys point into strings_)
+    std::unordered_map<string_view_t, uint32_t, view_hash> ids_;
+    std::deque<std::string> strings_;
+    uint32_t last_logger_id_ = 0;
+    int64_t last_time_ = 0;
+    memory_buf_t body_;  // the encoded fields
+
+    void encode_fields_(field_list fields, memory_buf_t &dest);
+    uint32_t intern_logger_name_(string_view_t name, memory_buf_t &dest);
+    uint32_t intern_(string_view_t s, memory_buf_t &dest);
+    void append_frame_(binary::frame_kind kind, const memory_buf_t &body, memory_buf_t &dest);
+};
+
+// Reads the log messages of an encoded stream.
+// Throws spdlog_ex if the stream is not a binary log or is corrupted.
+class SPDLOG_API binary_reader {
+public:
+    explicit binary_reader(std::istream &in);
+    binary_reader(const binary_reader &) = delete;
+    binary_reader &operator=(const binary_reader &) = delete;
+
+    // read the next message into msg, which is valid until the next call.
+    // return false at the end of the stream.
+    bool read(log_msg &msg);
+
+    // true if the stream ended in the middle of a frame (e.g. the writer crashed)
+    bool truncated() const { return truncated_; }
+
+private:
+    std::istream &in_;
+    std::vector<char> frame_;
+    std::vector<std::string> strings_;
+    std::vector<field> fields_;
+    bool in_session_ = false;
+    bool truncated_ = false;
+    int64_t last_time_ = 0;
+
+    bool read_frame_(binary::frame_kind &kind);
+    void read_session_();
+    void read_string_();
+    void read_record_(log_msg &msg);
+    const std::string &string_(uint64_t id) const;
+};
+
+}  // namespace details
+}  // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+    #include "binary_format-inl.h"
+#endif
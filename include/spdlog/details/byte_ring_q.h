@@ -0,0 +1,747 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-multi consumer blocking queue of variable length records.
+// Instead of fixed size item slots, the messages are packed into one preallocated byte arena:
+// [record header][logger name][MDC][payload][fields]
+// so the queue is sized in bytes and pushing a log message never allocates.
+// The MDC of the pushing thread is stored with the message (see log_msg::mdc()).
+// A record that doesn't fit at the end of the arena starts at its beginning, and the space left
+// at the end is skipped.
+//
+// Has the same interface as mpmc_blocking_queue, and in addition
+// enqueue_log(..), enqueue_log_for(..), enqueue_log_nowait(..) and enqueue_log_if_have_room(..)
+// which pack a log message directly from a log_msg, without building an item first, and
+// reserve_log(..) / commit(..) which let the caller write the payload in place.
+//
+// A message bigger than the whole arena is always discarded.
+//
+// The dequeued items are not copies of the records: they refer to the logger name, MDC,
+// payload and fields in the arena (see log_msg_buffer::borrow()), and hold the record by a
+// ring_record. The record's space is released by release(..) once the items are processed, or
+// when the item is destroyed or dequeued into again. The overrun policy can't drop records
+// that were dequeued but not released yet - the new message is discarded instead.
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/details/queue_stats.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace spdlog {
+namespace details {
+
+// the queue a ring_record belongs to
+class ring_record_owner {
+public:
+    virtual void release_record(size_t pos) = 0;
+
+protected:
+    ~ring_record_owner() = default;
+};
+
+// a dequeued record, whose space is released when the handle is reset or destroyed
+class ring_record {
+public:
+    ring_record() = default;
+    ring_record(ring_record_owner *owner, size_t pos)
+        : owner_(owner),
+          pos_(pos) {}
+    ~ring_record() { reset(); }
+
+    ring_record(const ring_record &) = delete;
+    ring_record &operator=(const ring_record &) = delete;
+
+    ring_record(ring_record &&other) SPDLOG_NOEXCEPT : owner_(other.owner_),
+                                                       pos_(other.pos_) {
+        other.owner_ = nullptr;
+    }
+
+    ring_record &operator=(ring_record &&other) SPDLOG_NOEXCEPT {
+        if (this != &other) {
+            reset();
+            owner_ = other.owner_;
+            pos_ = other.pos_;
+            other.owner_ = nullptr;
+        }
+        return *this;
+    }
+
+    void reset() {
+        if (owner_ != nullptr) {
+            auto *owner = owner_;
+            owner_ = nullptr;
+            owner->release_record(pos_);
+        }
+    }
+
+    // forget the record without releasing it (the owner releases it itself)
+    void detach() SPDLOG_NOEXCEPT { owner_ = nullptr; }
+
+    ring_record_owner *owner() const { return owner_; }
+    size_t pos() const { return pos_; }
+
+private:
+    ring_record_owner *owner_ = nullptr;
+    size_t pos_ = 0;
+};
+
+template <typename T>
+class byte_ring_queue final : public ring_record_owner {
+public:
+    using item_type = T;
+    using logger_ptr = decltype(T::worker_ptr);
+    using msg_type_t = decltype(T::msg_type);
+    using format_fn_t = decltype(T::format_fn);
+    using charge_t = decltype(T::charge);
+
+    enum class push_mode { block, block_for, overrun, discard };
+
+    explicit byte_ring_queue(size_t max_bytes)
+        : capacity_(max_bytes / record_align * record_align),
+          arena_(new block[capacity_ / record_align]()),  // touched by the constructing thread
+          wrap_pos_(capacity_) {}
+
+    byte_ring_queue(const byte_ring_queue &) = delete;
+    byte_ring_queue &operator=(const byte_ring_queue &) = delete;
+
+    // the dequeued items must have been released by now
+    ~byte_ring_queue() {
+        while (unread_ > 0) {
+            pop_oldest_();
+        }
+    }
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item) { push_item_(std::move(item), push_mode::block); }
+
+    // try to enqueue and block up to timeout if no room left, then discard the new message.
+    // return false if discarded.
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout) {
+        return push_item_(std::move(item), push_mode::block_for, timeout);
+    }
+
+    // enqueue immediately. overrun oldest messages in the queue if no room left.
+    void enqueue_nowait(T &&item) { push_item_(std::move(item), push_mode::overrun); }
+
+    void enqueue_if_have_room(T &&item) { push_item_(std::move(item), push_mode::discard); }
+
+    // pack a log message. same policies as the enqueue functions above.
+    // return false if the message was discarded.
+    bool enqueue_log(logger_ptr worker,
+                     const log_msg &msg,
+                     format_fn_t format_fn,
+                     charge_t &&charge = charge_t()) {
+        return push_(msg, msg_type_t::log, std::move(worker), format_fn, 0, charge,
+                     push_mode::block);
+    }
+
+    bool enqueue_log_for(logger_ptr worker,
+                         const log_msg &msg,
+                         format_fn_t format_fn,
+                         std::chrono::milliseconds timeout,
+                         charge_t &&charge = charge_t()) {
+        return push_(msg, msg_type_t::log, std::move(worker), format_fn, 0, charge,
+                     push_mode::block_for, timeout);
+    }
+
+    bool enqueue_log_nowait(logger_ptr worker,
+                            const log_msg &msg,
+                            format_fn_t format_fn,
+                            charge_t &&charge = charge_t()) {
+        return push_(msg, msg_type_t::log, std::move(worker), format_fn, 0, charge,
+                     push_mode::overrun);
+    }
+
+    bool enqueue_log_if_have_room(logger_ptr worker,
+                                  const log_msg &msg,
+                                  format_fn_t format_fn,
+                                  charge_t &&charge = charge_t()) {
+        return push_(msg, msg_type_t::log, std::move(worker), format_fn, 0, charge,
+                     push_mode::discard);
+    }
+
+    // reserve a log record with room for up to max_payload bytes of payload, which the caller
+    // writes in place and then publishes by commit(pos, payload_size), or skips by cancel(pos).
+    // the records behind it are not dequeued until then.
+    // return where to write the payload and set pos to the record position, or return nullptr
+    // if the record was discarded (by the mode).
+    char *reserve_log(logger_ptr worker,
+                      const log_msg &msg,
+                      size_t max_payload,
+                      charge_t &&charge,
+                      push_mode mode,
+                      std::chrono::milliseconds timeout,
+                      size_t &pos) {
+        auto mdc = msg.mdc();
+        size_t size =
+            align_up_(header_size_() + msg.logger_name.size() + mdc.data_size() + max_payload);
+        if (size > capacity_) {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!make_room_(lock, size, mode, timeout, pos)) {
+            return nullptr;
+        }
+        auto *p = write_record_(pos, size, msg, mdc, msg_type_t::log, std::move(worker), nullptr,
+                                0, charge, max_payload);
+        header_at_(pos)->committed = false;
+        return p;
+    }
+
+    // true if a record of the message with payload_size bytes of payload fits in the arena
+    bool fits(const log_msg &msg, size_t payload_size) const {
+        return align_up_(header_size_() + msg.logger_name.size() + msg.mdc().data_size() +
+                         payload_size) <= capacity_;
+    }
+
+    // publish a reserved record with payload_size bytes of payload. the charge of the unused
+    // bytes is released. so is their space if no record was reserved behind it meanwhile,
+    // otherwise it's released when the record is dequeued.
+    void commit(size_t pos, size_t payload_size) {
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            auto *header = header_at_(pos);
+            header->charge.remove(header->payload_size - payload_size);
+            header->payload_size = payload_size;
+            header->committed = true;
+            size_t end = pos + header->size;
+            if ((end == capacity_ ? 0 : end) == tail_) {
+                header->size = align_up_(header_size_() + header->logger_name_size +
+                                         header->mdc_count * sizeof(mdc_entry) +
+                                         header->mdc_text_size + payload_size);
+                tail_ = pos + header->size;
+            }
+            notify = waiting_consumers_ > 0 && pos == read_;
+        }
+        if (notify) {
+            push_cv_.notify_one();
+        }
+    }
+
+    // drop a reserved record. it's not reported as a discarded message.
+    void cancel(size_t pos) {
+        bool notify_consumer = false;
+        bool notify_producers = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            auto *header = header_at_(pos);
+            header->worker_ptr = nullptr;
+            header->committed = true;
+            header->cancelled = true;
+            if (pos == read_) {
+                size_t count = count_;
+                notify_consumer = ready_() && waiting_consumers_ > 0;
+                notify_producers = count_ < count && waiting_producers_ > 0;
+            }
+        }
+        if (notify_consumer) {
+            push_cv_.notify_one();
+        }
+        if (notify_producers) {
+            pop_cv_.notify_all();
+        }
+    }
+
+    // blocking dequeue without a timeout.
+    void dequeue(T &popped_item) { dequeue_bulk(&popped_item, 1); }
+
+    // blocking dequeue of up to max_items items (at least one).
+    // Return the number of items dequeued.
+    size_t dequeue_bulk(T *popped_items, size_t max_items) {
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!ready_()) {
+                waiting_consumers_++;
+                push_cv_.wait(lock, [this] { return this->ready_(); });
+                waiting_consumers_--;
+            }
+            size_t records = count_;
+            count = pop_bulk_(popped_items, max_items);
+            notify = count_ < records && waiting_producers_ > 0;
+        }
+        // the waiting producers need different sizes - let all of them check
+        if (notify) {
+            pop_cv_.notify_all();
+        }
+        return count;
+    }
+
+    // dequeue_bulk() waiting at most wait_duration.
+    // Return the number of items dequeued (0 on timeout).
+    size_t dequeue_bulk_for(T *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds wait_duration) {
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!ready_()) {
+                waiting_consumers_++;
+                bool have_items =
+                    push_cv_.wait_for(lock, wait_duration, [this] { return this->ready_(); });
+                waiting_consumers_--;
+                if (!have_items) {
+                    return 0;
+                }
+            }
+            size_t records = count_;
+            count = pop_bulk_(popped_items, max_items);
+            notify = count_ < records && waiting_producers_ > 0;
+        }
+        if (notify) {
+            pop_cv_.notify_all();
+        }
+        return count;
+    }
+
+    // non blocking dequeue of up to max_items items.
+    // Return the number of items dequeued (0 if the queue is empty).
+    size_t try_dequeue_bulk(T *popped_items, size_t max_items) {
+        if (unread_hint_.load(std::memory_order_acquire) == 0) {
+            return 0;  // don't contend on the mutex while polling an empty queue
+        }
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            size_t records = count_;
+            count = pop_bulk_(popped_items, max_items);
+            notify = count_ < records && waiting_producers_ > 0;
+        }
+        if (notify) {
+            pop_cv_.notify_all();
+        }
+        return count;
+    }
+
+    // release the records of the processed items (the items keep their other members)
+    void release(T *items, size_t count) {
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            size_t records = count_;
+            for (size_t i = 0; i < count; i++) {
+                take_back_(items[i]);
+            }
+            release_done_();
+            notify = count_ < records && waiting_producers_ > 0;
+        }
+        if (notify) {
+            pop_cv_.notify_all();
+        }
+    }
+
+    void release_record(size_t pos) override {
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            size_t records = count_;
+            header_at_(pos)->done = true;
+            release_done_();
+            notify = count_ < records && waiting_producers_ > 0;
+        }
+        if (notify) {
+            pop_cv_.notify_all();
+        }
+    }
+
+    size_t overrun_counter() { return overrun_counter_.load(std::memory_order_relaxed); }
+
+    size_t discard_counter() { return discard_counter_.load(std::memory_order_relaxed); }
+
+    size_t size() {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return unread_;
+    }
+
+    void reset_overrun_counter() { overrun_counter_.store(0, std::memory_order_relaxed); }
+
+    void reset_discard_counter() { discard_counter_.store(0, std::memory_order_relaxed); }
+
+    queue_stats &stats() { return stats_; }
+
+private:
+
+    struct record_header {
+        size_t size = 0;  // bytes taken by the record, including the header
+        msg_type_t msg_type{};
+        size_t flush_seq = 0;
+        level::level_enum level{level::off};
+        log_clock::time_point time;
+        size_t thread_id = 0;
+        source_loc source;
+        format_fn_t format_fn{};
+        size_t logger_name_size = 0;
+        size_t payload_size = 0;
+        size_t fields_count = 0;
+        size_t mdc_count = 0;
+        size_t mdc_text_size = 0;
+        logger_ptr worker_ptr;
+        charge_t charge;
+        bool committed = true;   // false while a reserved record is being written
+        bool cancelled = false;  // reserved record to be skipped
+        bool done = false;       // dequeued and released, or skipped
+    };
+
+    static constexpr size_t record_align = alignof(record_header);
+
+    struct block {
+        alignas(record_align) unsigned char bytes[record_align];
+    };
+
+    static constexpr size_t align_up_(size_t n) {
+        return (n + record_align - 1) / record_align * record_align;
+    }
+
+    static constexpr size_t header_size_() { return align_up_(sizeof(record_header)); }
+
+    unsigned char *at_(size_t pos) { return reinterpret_cast<unsigned char *>(arena_.get()) + pos; }
+
+    bool push_item_(T &&item,
+                    push_mode mode,
+                    std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        if (push_(item, item.msg_type, item.worker_ptr, item.format_fn, item.flush_seq, item.charge,
+                  mode, timeout)) {
+            // moved to the queue
+            item.flush_seq = 0;
+            item.worker_ptr = nullptr;
+            return true;
+        }
+        return false;
+    }
+
+    // return true if the message was stored. the charge is moved to the record only then.
+    bool push_(const log_msg &msg,
+               msg_type_t msg_type,
+               logger_ptr worker,
+               format_fn_t format_fn,
+               size_t flush_seq,
+               charge_t &charge,
+               push_mode mode,
+               std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        auto mdc = msg_type == msg_type_t::log ? msg.mdc() : mdc_view();
+        size_t fields_offset = align_up_(header_size_() + msg.logger_name.size() +
+                                         mdc.data_size() + msg.payload.size());
+        size_t size = align_up_(fields_offset + fields_size_(msg.fields));
+        if (size > capacity_) {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            size_t pos = 0;
+            if (!make_room_(lock, size, mode, timeout, pos)) {
+                return false;
+            }
+            auto *p = write_record_(pos, size, msg, mdc, msg_type, std::move(worker), format_fn,
+                                    flush_seq, charge, msg.payload.size());
+            if (msg.payload.size() > 0) {
+                std::memcpy(p, msg.payload.data(), msg.payload.size());
+            }
+            if (!msg.fields.empty()) {
+                write_fields_(pos, fields_offset, msg.fields);
+            }
+            // the consumers that are awake will find the record without being notified
+            notify = waiting_consumers_ > 0;
+        }
+        if (notify) {
+            push_cv_.notify_one();
+        }
+        return true;
+    }
+
+    // find room for a record of size bytes according to the mode. return false if the record
+    // is to be discarded.
+    bool make_room_(std::unique_lock<std::mutex> &lock,
+                    size_t size,
+                    push_mode mode,
+                    std::chrono::milliseconds timeout,
+                    size_t &pos) {
+        if (mode == push_mode::block) {
+            if (!reserve_(size, pos)) {
+                auto start = queue_stats::clock::now();
+                waiting_producers_++;
+                pop_cv_.wait(lock, [&] { return this->reserve_(size, pos); });
+                waiting_producers_--;
+                stats_.add_blocked_since(start);
+            }
+        } else if (mode == push_mode::block_for) {
+            if (!reserve_(size, pos)) {
+                auto start = queue_stats::clock::now();
+                waiting_producers_++;
+                bool room =
+                    pop_cv_.wait_for(lock, timeout, [&] { return this->reserve_(size, pos); });
+                waiting_producers_--;
+                stats_.add_blocked_since(start);
+                if (!room) {
+                    discard_counter_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+        } else if (mode == push_mode::overrun) {
+            while (!reserve_(size, pos)) {
+                if (ready_() && count_ == unread_) {
+                    pop_oldest_();
+                    overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+                } else if (count_ > 0) {
+                    // the oldest record is still being written or processed, so it can't be
+                    // overrun
+                    discard_counter_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+        } else if (!reserve_(size, pos)) {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // write the header, the logger name and the MDC of a record with room for payload_size
+    // bytes of payload at pos. return the payload position.
+    char *write_record_(size_t pos,
+                        size_t size,
+                        const log_msg &msg,
+                        const mdc_view &mdc,
+                        msg_type_t msg_type,
+                        logger_ptr worker,
+                        format_fn_t format_fn,
+                        size_t flush_seq,
+                        charge_t &charge,
+                        size_t payload_size) {
+        auto *header = new (at_(pos)) record_header();
+        header->size = size;
+        header->msg_type = msg_type;
+        header->flush_seq = flush_seq;
+        header->level = msg.level;
+        header->time = msg.time;
+        header->thread_id = msg.thread_id;
+        header->source = msg.source;
+        header->format_fn = format_fn;
+        header->logger_name_size = msg.logger_name.size();
+        header->payload_size = payload_size;
+        header->mdc_count = mdc.size();
+        header->mdc_text_size = mdc.text().size();
+        header->worker_ptr = std::move(worker);
+        header->charge = std::move(charge);
+
+        auto *p = reinterpret_cast<char *>(at_(pos + header_size_()));
+        if (msg.logger_name.size() > 0) {
+            std::memcpy(p, msg.logger_name.data(), msg.logger_name.size());
+            p += msg.logger_name.size();
+        }
+        if (!mdc.empty()) {
+            std::memcpy(p, mdc.entries_data(), mdc.entries_size());
+            p += mdc.entries_size();
+            std::memcpy(p, mdc.text().data(), mdc.text().size());
+            p += mdc.text().size();
+        }
+        count_++;
+        unread_++;
+        unread_hint_.store(unread_, std::memory_order_release);
+        stats_.update_high_water_mark(unread_);
+        return p;
+    }
+
+    record_header *header_at_(size_t pos) { return reinterpret_cast<record_header *>(at_(pos)); }
+
+    // the fields are stored as an array of fields, followed by their keys and string values
+    static size_t fields_size_(field_list fields) {
+        size_t size = fields.size() * sizeof(field);
+        for (auto &f : fields) {
+            size += f.data_size();
+        }
+        return size;
+    }
+
+    void write_fields_(size_t pos, size_t fields_offset, field_list fields) {
+        header_at_(pos)->fields_count = fields.size();
+        auto *stored = reinterpret_cast<field *>(at_(pos + fields_offset));
+        auto *p = reinterpret_cast<char *>(stored + fields.size());
+        for (auto &f : fields) {
+            auto key = f.key();
+            if (key.size() > 0) {
+                std::memcpy(p, key.data(), key.size());
+            }
+            char *value = p + key.size();
+            if (f.type() == field_type::string && f.string().size() > 0) {
+                std::memcpy(value, f.string().data(), f.string().size());
+            }
+            (new (stored++) field(f))->rebind(p, value);
+            p += f.data_size();
+        }
+    }
+
+    // skip the cancelled records at the read position. return true if the oldest unread record
+    // can be dequeued (i.e. it's not still being written).
+    bool ready_() {
+        while (unread_ > 0 && header_at_(read_)->cancelled) {
+            header_at_(read_)->done = true;
+            advance_read_();
+        }
+        release_done_();
+        unread_hint_.store(unread_, std::memory_order_release);
+        return unread_ > 0 && header_at_(read_)->committed;
+    }
+
+    void advance_read_() {
+        read_ += header_at_(read_)->size;
+        unread_--;
+        if (read_ == wrap_pos_ || read_ == capacity_) {
+            read_ = 0;
+        }
+    }
+
+    // release the space of the done records at the head of the queue
+    void release_done_() {
+        while (count_ > unread_ && header_at_(head_)->done) {
+            release_front_(header_at_(head_));
+        }
+    }
+
+    // find room for size bytes. on success set pos to the record position and return true.
+    bool reserve_(size_t size, size_t &pos) {
+        if (count_ == 0) {
+            head_ = tail_ = read_ = 0;
+            wrap_pos_ = capacity_;
+        } else if (tail_ == head_) {
+            return false;  // full
+        }
+
+        if (tail_ >= head_) {
+            if (size <= capacity_ - tail_) {
+                pos = tail_;
+            } else if (size <= head_) {
+                // skip the space left at the end of the arena
+                wrap_pos_ = tail_;
+                pos = 0;
+                if (unread_ == 0) {
+                    read_ = 0;
+                }
+            } else {
+                return false;
+            }
+        } else if (size <= head_ - tail_) {
+            pos = tail_;
+        } else {
+            return false;
+        }
+
+        tail_ = pos + size;
+        if (tail_ == capacity_) {
+            tail_ = 0;
+        }
+        return true;
+    }
+
+    size_t pop_bulk_(T *popped_items, size_t max_items) {
+        size_t count = 0;
+        while (count < max_items && ready_()) {
+            pop_front_(popped_items[count++]);
+        }
+        release_done_();
+        unread_hint_.store(unread_, std::memory_order_release);
+        return count;
+    }
+
+    // mark the record held by item as done, if it's one of ours. no release_record() call -
+    // the caller holds the lock.
+    void take_back_(T &item) {
+        if (item.record.owner() == this) {
+            header_at_(item.record.pos())->done = true;
+            item.record.detach();
+        }
+    }
+
+    // point popped_item at the oldest unread record, which is held until it's released.
+    // whatever popped_item held is reported as dropped, as moving into it would.
+    void pop_front_(T &popped_item) {
+        take_back_(popped_item);
+        popped_item.report_drop();
+        size_t pos = read_;
+        auto *header = header_at_(pos);
+        auto *p = reinterpret_cast<const char *>(at_(pos + header_size_()));
+
+        log_msg msg;
+        msg.logger_name = string_view_t(p, header->logger_name_size);
+        p += header->logger_name_size;
+        size_t mdc_entries_size = header->mdc_count * sizeof(mdc_entry);
+        msg.captured_mdc = mdc_view(p, header->mdc_count,
+                                    string_view_t(p + mdc_entries_size, header->mdc_text_size));
+        p += mdc_entries_size + header->mdc_text_size;
+        msg.level = header->level;
+        msg.time = header->time;
+        msg.thread_id = header->thread_id;
+        msg.source = header->source;
+        msg.payload = string_view_t(p, header->payload_size);
+        if (header->fields_count > 0) {
+            size_t fields_offset =
+                align_up_(header_size_() + header->logger_name_size + mdc_entries_size +
+                          header->mdc_text_size + header->payload_size);
+            msg.fields = field_list(reinterpret_cast<const field *>(at_(pos + fields_offset)),
+                                    header->fields_count);
+        }
+
+        popped_item.borrow(msg);
+        popped_item.msg_type = header->msg_type;
+        popped_item.worker_ptr = std::move(header->worker_ptr);
+        popped_item.format_fn = header->format_fn;
+        popped_item.flush_seq = header->flush_seq;
+        popped_item.charge = std::move(header->charge);
+        popped_item.record = ring_record(this, pos);
+        advance_read_();
+    }
+
+    // drop the oldest record. no record may be held by a consumer.
+    void pop_oldest_() {
+        T oldest;
+        pop_front_(oldest);
+        take_back_(oldest);
+        release_done_();
+    }
+
+    void release_front_(record_header *header) {
+        head_ += header->size;
+        header->~record_header();
+        count_--;
+        if (head_ == wrap_pos_ || head_ == capacity_) {
+            head_ = 0;
+            wrap_pos_ = capacity_;
+        }
+    }
+
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+
+    size_t capacity_;
+    std::unique_ptr<block[]> arena_;
+    size_t head_ = 0;      // position of the oldest record
+    size_t read_ = 0;      // position of the oldest record not dequeued yet
+    size_t tail_ = 0;      // position of the next record
+    size_t wrap_pos_;      // records from head_ up to here are followed by records from 0
+    size_t count_ = 0;     // records in the arena
+    size_t unread_ = 0;    // records not dequeued yet
+    size_t waiting_consumers_ = 0;
+    size_t waiting_producers_ = 0;
+    std::atomic<size_t> unread_hint_{0};  // unread_ as of the last push or pop
+
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<size_t> discard_counter_{0};
+    queue_stats stats_;
+};
+}  // namespace details
+}  // namespace spdlog
@@ -92,6 +92,9 @@ public:
         return false;
     }
 
+    // max number of elements (0 for a disabled queue)
+    size_t max_size() const { return max_items_ > 0 ? max_items_ - 1 : 0; }
+
     size_t overrun_counter() const { return overrun_counter_; }
 
     void reset_overrun_counter() { overrun_counter_ = 0; }
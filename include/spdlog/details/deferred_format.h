@@ -0,0 +1,221 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Support for deferred formatting (see async_logger::enable_deferred_formatting()).
+// Instead of formatting on the calling thread, the format string and the arguments are packed
+// by value into a byte buffer which travels through the async queue. The backend thread later
+// unpacks them and does the actual formatting.
+//
+// Only arguments that can be safely copied as bytes are supported: arithmetic types, void
+// pointers and strings (C strings, std::string and string views), which are copied by value.
+// A log call with any other argument type is formatted on the calling thread as usual.
+//
+// Packed layout: [format string][arg 1]...[arg n], where each string is stored as its size
+// followed by its chars, and each other value is stored as its raw bytes. C strings are stored
+// null terminated, and a null C string as the size null_c_string only, so the backend passes
+// the formatting function the same pointer (and gets the same error) as eager formatting would.
+
+#include <spdlog/common.h>
+
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#if __cplusplus >= 201703L  // C++17
+    #include <string_view>
+#endif
+
+namespace spdlog {
+namespace details {
+
+// formats the packed format string and arguments into dest
+using deferred_format_fn = void (*)(string_view_t packed, memory_buf_t &dest);
+
+namespace deferred {
+
+inline void write_bytes(memory_buf_t &dest, const void *src, size_t size) {
+    auto *p = static_cast<const char *>(src);
+    dest.append(p, p + size);
+}
+
+inline void write_string(memory_buf_t &dest, const char *str, size_t size) {
+    write_bytes(dest, &size, sizeof(size));
+    dest.append(str, str + size);
+}
+
+// size of a null C string
+static constexpr size_t null_c_string = static_cast<size_t>(-1);
+
+inline void write_c_string(memory_buf_t &dest, const char *str) {
+    if (str == nullptr) {
+        write_bytes(dest, &null_c_string, sizeof(null_c_string));
+        return;
+    }
+    size_t size = std::char_traits<char>::length(str);
+    write_bytes(dest, &size, sizeof(size));
+    dest.append(str, str + size + 1);
+}
+
+// sequential reader of a packed buffer
+class reader {
+public:
+    explicit reader(string_view_t packed)
+        : pos_(packed.data()) {}
+
+    template <typename T>
+    T read_value() {
+        T value;
+        std::memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    string_view_t read_string() {
+        auto size = read_value<size_t>();
+        string_view_t str(pos_, size);
+        pos_ += size;
+        return str;
+    }
+
+    const char *read_c_string() {
+        auto size = read_value<size_t>();
+        if (size == null_c_string) {
+            return nullptr;
+        }
+        const char *str = pos_;
+        pos_ += size + 1;
+        return str;
+    }
+
+private:
+    const char *pos_;
+};
+
+// how each argument type is packed and unpacked.
+// stored_type is the type the backend passes to the formatting function.
+template <typename T, typename = void>
+struct arg_traits : std::false_type {};
+
+template <typename T>
+struct arg_traits<T, enable_if_t<std::is_arithmetic<T>::value>> : std::true_type {
+    using stored_type = T;
+    static void write(memory_buf_t &dest, T value) { write_bytes(dest, &value, sizeof(T)); }
+    static T read(reader &r) { return r.read_value<T>(); }
+};
+
+template <typename T>
+struct arg_traits<T,
+                  enable_if_t<std::is_same<T, const void *>::value ||
+                              std::is_same<T, void *>::value>> : std::true_type {
+    using stored_type = const void *;
+    static void write(memory_buf_t &dest, const void *value) {
+        write_bytes(dest, &value, sizeof(value));
+    }
+    static const void *read(reader &r) { return r.read_value<const void *>(); }
+};
+
+struct string_arg_traits : std::true_type {
+    using stored_type = string_view_t;
+    static string_view_t read(reader &r) { return r.read_string(); }
+};
+
+template <typename T>
+struct arg_traits<T,
+                  enable_if_t<std::is_same<T, const char *>::value ||
+                              std::is_same<T, char *>::value>> : std::true_type {
+    using stored_type = const char *;
+    static void write(memory_buf_t &dest, const char *value) { write_c_string(dest, value); }
+    static const char *read(reader &r) { return r.read_c_string(); }
+};
+
+template <typename T>
+struct arg_traits<T,
+                  enable_if_t<std::is_same<T, std::string>::value ||
+                              std::is_same<T, string_view_t>::value>> : string_arg_traits {
+    static void write(memory_buf_t &dest, const T &value) {
+        write_string(dest, value.data(), value.size());
+    }
+};
+
+#if __cplusplus >= 201703L && !defined(SPDLOG_USE_STD_FORMAT)  // C++17
+template <>
+struct arg_traits<std::string_view> : string_arg_traits {
+    static void write(memory_buf_t &dest, std::string_view value) {
+        write_string(dest, value.data(), value.size());
+    }
+};
+#endif
+
+template <typename T>
+using traits_of = arg_traits<typename std::decay<T>::type>;
+
+template <typename... Args>
+struct all_supported;
+
+template <>
+struct all_supported<> : std::true_type {};
+
+template <typename T, typename... Rest>
+struct all_supported<T, Rest...>
+    : std::integral_constant<bool, traits_of<T>::value && all_supported<Rest...>::value> {};
+
+// c++11 replacement of std::index_sequence
+template <size_t... I>
+struct index_sequence {};
+
+template <size_t N, size_t... I>
+struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct make_index_sequence<0, I...> {
+    using type = index_sequence<I...>;
+};
+
+inline void write_args(memory_buf_t &) {}
+
+template <typename T, typename... Rest>
+void write_args(memory_buf_t &dest, const T &arg, const Rest &...rest) {
+    traits_of<T>::write(dest, arg);
+    write_args(dest, rest...);
+}
+
+template <typename Tuple, size_t... I>
+void vformat_tuple(string_view_t fmt, Tuple &values, memory_buf_t &dest, index_sequence<I...>) {
+#ifdef SPDLOG_USE_STD_FORMAT
+    fmt_lib::vformat_to(std::back_inserter(dest), fmt,
+                        fmt_lib::make_format_args(std::get<I>(values)...));
+#else
+    fmt::vformat_to(fmt::appender(dest), fmt, fmt::make_format_args(std::get<I>(values)...));
+#endif
+}
+}  // namespace deferred
+
+// true if all the argument types can be packed
+template <typename... Args>
+struct is_deferrable : deferred::all_supported<Args...> {};
+
+// pack the format string and the arguments into dest.
+// the format string is copied as well, since it is not guaranteed to be a literal.
+template <typename... Args>
+void pack_deferred_args(memory_buf_t &dest, string_view_t fmt, const Args &...args) {
+    deferred::write_string(dest, fmt.data(), fmt.size());
+    deferred::write_args(dest, args...);
+}
+
+// unpack what pack_deferred_args<Args...>() has packed and format it into dest.
+template <typename... Args>
+void format_deferred_args(string_view_t packed, memory_buf_t &dest) {
+    deferred::reader r(packed);
+    auto fmt = r.read_string();
+    // braced init lists are evaluated left to right, so the args are read in order
+    std::tuple<typename deferred::traits_of<Args>::stored_type...> values{
+        deferred::traits_of<Args>::read(r)...};
+    deferred::vformat_tuple(fmt, values, dest,
+                            typename deferred::make_index_sequence<sizeof...(Args)>::type{});
+}
+
+}  // namespace details
+}  // namespace spdlog
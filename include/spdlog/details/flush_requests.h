@@ -0,0 +1,95 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Flush requests of an async logger. Requests are numbered. A request is served once the pool
+// has flushed the sinks after all the messages posted before it, which also serves the
+// requests with a lower number. A request dropped by the queue (overflow policy) is reported to
+// its waiter, unless a later request was served meanwhile.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+class flush_requests {
+public:
+    flush_requests() = default;
+    // a copy starts with no requests
+    flush_requests(const flush_requests &) {}
+    flush_requests &operator=(const flush_requests &) = delete;
+
+    // number a new request
+    size_t request() { return requested_.fetch_add(1, std::memory_order_acq_rel) + 1; }
+
+    bool served(size_t seq) const { return completed_.load(std::memory_order_acquire) >= seq; }
+
+    // request seq was served. wake its waiters.
+    void complete(size_t seq) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (completed_.load(std::memory_order_relaxed) < seq) {
+                completed_.store(seq, std::memory_order_release);
+            }
+        }
+        cv_.notify_all();
+    }
+
+    // request seq was dropped. wake its waiter.
+    void drop(size_t seq) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // already served by a later request - its waiter may be gone
+            if (completed_.load(std::memory_order_relaxed) >= seq) {
+                return;
+            }
+            dropped_.push_back(seq);
+        }
+        cv_.notify_all();
+    }
+
+    // wait until request seq is served (return true) or dropped (return false)
+    bool wait(size_t seq) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool was_dropped = false;
+        cv_.wait(lock, [&] {
+            auto completed = completed_.load(std::memory_order_relaxed);
+            if (completed >= seq) {
+                // forget the drops of the requests served meanwhile
+                dropped_.erase(std::remove_if(dropped_.begin(), dropped_.end(),
+                                              [&](size_t d) { return d <= completed; }),
+                               dropped_.end());
+                return true;
+            }
+            auto it = std::find(dropped_.begin(), dropped_.end(), seq);
+            if (it != dropped_.end()) {
+                dropped_.erase(it);
+                was_dropped = true;
+            }
+            return was_dropped;
+        });
+        return !was_dropped;
+    }
+
+    // number of dropped requests not reported to their waiters yet
+    size_t pending_drops() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_.size();
+    }
+
+private:
+    std::atomic<size_t> requested_{0};
+    std::atomic<size_t> completed_{0};
+    std::vector<size_t> dropped_;  // guarded by mutex_
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+}  // namespace details
+}  // namespace spdlog
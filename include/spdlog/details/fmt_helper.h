@@ -81,6 +81,68 @@ inline unsigned int count_digits(T n) {
 #endif
 }
 
+// "00", "01", ... "99". fixed width numbers are written two digits per lookup.
+inline const char *digit_pairs() {
+    static const char pairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    return pairs;
+}
+
+inline void write_pair(uint32_t n, char *out) {
+    auto pair = digit_pairs() + n * 2;
+    out[0] = pair[0];
+    out[1] = pair[1];
+}
+
+// write n zero padded to exactly width digits at out. n must be less than 10^width.
+// the digits are split in groups of four, which convert independently of each other.
+inline void write_padded(uint32_t n, unsigned int width, char *out) {
+    char *p = out + width;
+    while (p - out > 4) {
+        uint32_t group = n % 10000;
+        n /= 10000;
+        p -= 4;
+        write_pair(group / 100, p);
+        write_pair(group % 100, p + 2);
+    }
+    while (p - out >= 2) {
+        p -= 2;
+        write_pair(n % 100, p);
+        n /= 100;
+    }
+    if (p != out) {
+        *--p = static_cast<char>('0' + n);
+    }
+}
+
+template <unsigned int Width>
+struct pow10 {
+    static const uint32_t value = 10 * pow10<Width - 1>::value;
+};
+
+template <>
+struct pow10<0> {
+    static const uint32_t value = 1;
+};
+
+// append n zero padded to Width digits (or as is if it has more digits)
+template <unsigned int Width, typename T>
+inline void append_padded(T n, memory_buf_t &dest) {
+    static_assert(std::is_unsigned<T>::value, "append_padded must get unsigned T");
+    static_assert(Width > 0 && Width <= 9, "append_padded supports up to 9 digits");
+    if (n < pow10<Width>::value) {
+        auto size = dest.size();
+        dest.resize(size + Width);
+        write_padded(static_cast<uint32_t>(n), Width, dest.data() + size);
+    } else {
+        append_int(n, dest);
+    }
+}
+
 inline void pad2(int n, memory_buf_t &dest) {
     if (n >= 0 && n < 100)  // 0-99
     {
@@ -104,24 +166,17 @@ inline void pad_uint(T n, unsigned int width, memory_buf_t &dest) {
 template <typename T>
 inline void pad3(T n, memory_buf_t &dest) {
     static_assert(std::is_unsigned<T>::value, "pad3 must get unsigned T");
-    if (n < 1000) {
-        dest.push_back(static_cast<char>(n / 100 + '0'));
-        n = n % 100;
-        dest.push_back(static_cast<char>((n / 10) + '0'));
-        dest.push_back(static_cast<char>((n % 10) + '0'));
-    } else {
-        append_int(n, dest);
-    }
+    append_padded<3>(n, dest);
 }
 
 template <typename T>
 inline void pad6(T n, memory_buf_t &dest) {
-    pad_uint(n, 6, dest);
+    append_padded<6>(n, dest);
 }
 
 template <typename T>
 inline void pad9(T n, memory_buf_t &dest) {
-    pad_uint(n, 9, dest);
+    append_padded<9>(n, dest);
 }
 
 // return fraction of a second of the given time_point.
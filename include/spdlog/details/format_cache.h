@@ -0,0 +1,236 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Formatted output of messages, shared by the sinks of a logger (or a dist_sink).
+// While a format_cache::scope is active on a thread, pattern_formatters with the same
+// format key (pattern, eol, time type) format each message once: the first one stores its
+// output in the cache and the others copy it. The fingerprint, a hash of the key, is compared
+// first, and the key itself before the output is copied.
+// The owner of the sinks installs a cache only if two of them share a fingerprint (see
+// shared_fingerprint()), so sinks that all format differently pay no copy. The owner keeps that
+// fingerprint in a sinks_fingerprint, so it's found once per change of its sinks.
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/sinks/sink.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+class format_cache {
+public:
+    // cache the output for msgs[0..count) of the formatters with the given fingerprint
+    // (0 - of any formatter)
+    format_cache(const log_msg *msgs, size_t count, uint64_t fingerprint = 0)
+        : msgs_(msgs),
+          count_(count),
+          fingerprint_(fingerprint) {
+        if (count > 1) {
+            entries_.resize(count);
+        }
+    }
+
+    format_cache(const format_cache &) = delete;
+    format_cache &operator=(const format_cache &) = delete;
+
+    // the first fingerprint shared by two of the sinks, or 0 if they all format differently
+    static uint64_t shared_fingerprint(const std::vector<sink_ptr> &sinks) {
+        for (size_t i = 0; i + 1 < sinks.size(); i++) {
+            auto fingerprint = sinks[i]->format_fingerprint();
+            if (fingerprint == 0) {
+                continue;
+            }
+            for (size_t j = i + 1; j < sinks.size(); j++) {
+                if (sinks[j]->format_fingerprint() == fingerprint) {
+                    return fingerprint;
+                }
+            }
+        }
+        return 0;
+    }
+
+    // append the cached output of msg by a formatter with the given fingerprint and key to
+    // dest. return false if there is none.
+    bool append_to(const log_msg &msg,
+                   uint64_t fingerprint,
+                   string_view_t key,
+                   memory_buf_t &dest) const {
+        auto e = find_(msg);
+        if (e == nullptr || e->fingerprint != fingerprint || !same_key_(e->key_offset, key)) {
+            return false;
+        }
+        auto start = dest.size();
+        dest.append(text_.data() + e->offset, text_.data() + e->offset + e->size);
+        if (e->has_color_range) {
+            // ranges set by the formatter are relative to where its output started
+            auto move = [&](size_t pos) { return pos >= e->start ? pos - e->start + start : pos; };
+            msg.color_range_start = move(e->color_range_start);
+            msg.color_range_end = move(e->color_range_end);
+        }
+        return true;
+    }
+
+    // store dest[start..] as the output of msg by a formatter with the given fingerprint and
+    // key. only the first output of each message is kept.
+    void store(const log_msg &msg,
+               uint64_t fingerprint,
+               string_view_t key,
+               const memory_buf_t &dest,
+               size_t start,
+               bool has_color_range) {
+        if (fingerprint_ != 0 && fingerprint != fingerprint_) {
+            return;  // no other sink would copy it
+        }
+        auto e = find_(msg);
+        if (e == nullptr || e->fingerprint != 0) {
+            return;
+        }
+        // the key is stored once for consecutive messages of the same formatter
+        if (!(last_key_fingerprint_ == fingerprint && same_key_(last_key_offset_, key))) {
+            last_key_fingerprint_ = fingerprint;
+            last_key_offset_ = text_.size();
+            auto size = key.size();
+            text_.append(reinterpret_cast<const char *>(&size),
+                         reinterpret_cast<const char *>(&size) + sizeof(size));
+            text_.append(key.data(), key.data() + key.size());
+        }
+        e->fingerprint = fingerprint;
+        e->key_offset = last_key_offset_;
+        e->offset = text_.size();
+        e->size = dest.size() - start;
+        e->start = start;
+        e->has_color_range = has_color_range;
+        e->color_range_start = msg.color_range_start;
+        e->color_range_end = msg.color_range_end;
+        text_.append(dest.data() + start, dest.data() + dest.size());
+    }
+
+#ifndef SPDLOG_NO_TLS
+    // the cache of the current thread, if any
+    static format_cache *current() { return current_(); }
+
+    // make the cache the current thread's one, unless it's empty or the thread has one already
+    class scope {
+    public:
+        explicit scope(format_cache &cache)
+            : installed_(cache.count_ > 0 && current_() == nullptr) {
+            if (installed_) {
+                current_() = &cache;
+            }
+        }
+
+        ~scope() {
+            if (installed_) {
+                current_() = nullptr;
+            }
+        }
+
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+
+    private:
+        bool installed_;
+    };
+
+private:
+    static format_cache *&current_() {
+        static thread_local format_cache *cache = nullptr;
+        return cache;
+    }
+#else
+    static format_cache *current() { return nullptr; }
+
+    class scope {
+    public:
+        explicit scope(format_cache &) {}
+    };
+#endif
+
+private:
+    struct entry {
+        uint64_t fingerprint = 0;  // 0 - not stored yet
+        size_t key_offset = 0;     // of the key size and the key in text_
+        size_t offset = 0;
+        size_t size = 0;
+        size_t start = 0;  // in the buffer of the formatter
+        bool has_color_range = false;
+        size_t color_range_start = 0;
+        size_t color_range_end = 0;
+    };
+
+    const log_msg *msgs_;
+    size_t count_;
+    uint64_t fingerprint_;
+    entry single_;
+    std::vector<entry> entries_;  // of batches
+    memory_buf_t text_;           // the keys and the outputs
+    uint64_t last_key_fingerprint_ = 0;
+    size_t last_key_offset_ = 0;
+
+    bool same_key_(size_t key_offset, string_view_t key) const {
+        size_t size = 0;
+        std::memcpy(&size, text_.data() + key_offset, sizeof(size));
+        return size == key.size() &&
+               std::memcmp(text_.data() + key_offset + sizeof(size), key.data(), size) == 0;
+    }
+
+    entry *find_(const log_msg &msg) {
+        std::less<const log_msg *> less;
+        if (less(&msg, msgs_) || !less(&msg, msgs_ + count_)) {
+            return nullptr;  // some other message
+        }
+        return count_ == 1 ? &single_ : &entries_[static_cast<size_t>(&msg - msgs_)];
+    }
+
+    const entry *find_(const log_msg &msg) const {
+        return const_cast<format_cache *>(this)->find_(msg);
+    }
+};
+
+// the shared fingerprint of the sinks of a logger or a dist_sink (see
+// format_cache::shared_fingerprint()). found again only after some sink replaced its formatter
+// (see sink::format_generation()), or the owner changed its sinks and called invalidate().
+class sinks_fingerprint {
+public:
+    sinks_fingerprint() = default;
+    // the copy finds it again
+    sinks_fingerprint(const sinks_fingerprint &) {}
+    sinks_fingerprint &operator=(const sinks_fingerprint &) = delete;
+
+    uint64_t get(const std::vector<sink_ptr> &sinks) {
+        auto generation = sinks::sink::format_generation();
+        if (generation_.load(std::memory_order_acquire) == generation) {
+            return fingerprint_.load(std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto fingerprint = format_cache::shared_fingerprint(sinks);
+        fingerprint_.store(fingerprint, std::memory_order_relaxed);
+        generation_.store(generation, std::memory_order_release);
+        return fingerprint;
+    }
+
+    void invalidate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_.store(invalid_generation, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t invalid_generation = (std::numeric_limits<size_t>::max)();
+
+    std::mutex mutex_;  // serializes the updates
+    std::atomic<uint64_t> fingerprint_{0};
+    std::atomic<size_t> generation_{invalid_generation};
+};
+
+}  // namespace details
+}  // namespace spdlog
@@ -0,0 +1,219 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Escaping of JSON strings (see json_formatter).
+// Most log text needs no escaping, so the text is scanned for the bytes to escape ('"', '\' and
+// control characters) and the non-ASCII bytes 32 bytes at a time with AVX2 or 16 bytes at a time
+// with SSE2 when the compiler targets them, and the runs between them are copied as is.
+// Valid UTF-8 sequences are copied as is. Each byte of an invalid sequence is replaced by U+FFFD,
+// so the output is valid UTF-8 (as JSON requires) whatever the text.
+
+#include <spdlog/common.h>
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define SPDLOG_JSON_ESCAPE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SPDLOG_JSON_ESCAPE_SSE2
+#endif
+
+#if defined(_MSC_VER) && (defined(SPDLOG_JSON_ESCAPE_AVX2) || defined(SPDLOG_JSON_ESCAPE_SSE2))
+    #include <intrin.h>
+#endif
+
+namespace spdlog {
+namespace details {
+namespace json {
+
+inline bool needs_escape(unsigned char ch) { return ch < 0x20 || ch == '"' || ch == '\\'; }
+
+// bytes to be escaped or validated as UTF-8
+inline bool needs_attention(unsigned char ch) { return needs_escape(ch) || ch >= 0x80; }
+
+#if defined(SPDLOG_JSON_ESCAPE_AVX2) || defined(SPDLOG_JSON_ESCAPE_SSE2)
+inline unsigned int lowest_bit(uint32_t mask) {
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+    #else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+    #endif
+}
+#endif
+
+// return the position of the first byte of [data, data + size) to escape or validate, or size
+// if none.
+// text shorter than a vector is scanned a byte at a time.
+inline size_t find_escape(const char *data, size_t size) {
+    size_t i = 0;
+#if defined(SPDLOG_JSON_ESCAPE_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i max_control = _mm256_set1_epi8(0x1f);
+    auto scan = [&](size_t at) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + at));
+        // unsigned chunk <= 0x1f
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, max_control), chunk);
+        __m256i found = _mm256_or_si256(
+            control, _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                                     _mm256_cmpeq_epi8(chunk, backslash)));
+        // non-ASCII bytes have their high bit set
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(found, chunk)));
+    };
+    const size_t width = 32;
+#elif defined(SPDLOG_JSON_ESCAPE_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i max_control = _mm_set1_epi8(0x1f);
+    auto scan = [&](size_t at) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + at));
+        // unsigned chunk <= 0x1f
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, max_control), chunk);
+        __m128i found = _mm_or_si128(
+            control,
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        // non-ASCII bytes have their high bit set
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(found, chunk)));
+    };
+    const size_t width = 16;
+#endif
+#if defined(SPDLOG_JSON_ESCAPE_AVX2) || defined(SPDLOG_JSON_ESCAPE_SSE2)
+    if (size >= width) {
+        for (; i + width <= size; i += width) {
+            auto mask = scan(i);
+            if (mask != 0) {
+                return i + lowest_bit(mask);
+            }
+        }
+        // the last partial chunk is scanned by a chunk that overlaps the bytes already
+        // checked, which have nothing to escape
+        if (i < size) {
+            auto mask = scan(size - width);
+            return mask != 0 ? size - width + lowest_bit(mask) : size;
+        }
+        return size;
+    }
+#endif
+    for (; i < size; i++) {
+        if (needs_attention(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return size;
+}
+
+inline void append_escaped_char(unsigned char ch, memory_buf_t &dest) {
+    const char *escaped = nullptr;
+    switch (ch) {
+        case '"':
+            escaped = "\\\"";
+            break;
+        case '\\':
+            escaped = "\\\\";
+            break;
+        case '\b':
+            escaped = "\\b";
+            break;
+        case '\f':
+            escaped = "\\f";
+            break;
+        case '\n':
+            escaped = "\\n";
+            break;
+        case '\r':
+            escaped = "\\r";
+            break;
+        case '\t':
+            escaped = "\\t";
+            break;
+        default: {
+            static const char hex[] = "0123456789abcdef";
+            const char unicode[] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xf]};
+            dest.append(unicode, unicode + sizeof(unicode));
+            return;
+        }
+    }
+    dest.append(escaped, escaped + 2);
+}
+
+// length of the valid UTF-8 sequence at [data, data + size), or 0 if it's invalid (RFC 3629:
+// no overlong forms, surrogates or code points above U+10FFFF)
+inline size_t utf8_sequence_length(const unsigned char *data, size_t size) {
+    unsigned char lead = data[0];
+    size_t length = 0;
+    unsigned char min = 0x80, max = 0xbf;  // of the second byte
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        min = lead == 0xe0 ? 0xa0 : 0x80;
+        max = lead == 0xed ? 0x9f : 0xbf;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        min = lead == 0xf0 ? 0x90 : 0x80;
+        max = lead == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+    if (size < length || data[1] < min || data[1] > max) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (data[i] < 0x80 || data[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// append the text escaped to be placed between the quotes of a JSON string
+inline void append_escaped(string_view_t text, memory_buf_t &dest) {
+    const char *p = text.data();
+    size_t left = text.size();
+    for (;;) {
+        size_t run = find_escape(p, left);
+        dest.append(p, p + run);
+        p += run;
+        left -= run;
+        if (left == 0) {
+            return;
+        }
+        // the non-ASCII text that follows is validated here, without going back to the scan
+        auto ch = static_cast<unsigned char>(*p);
+        if (ch < 0x80) {
+            append_escaped_char(ch, dest);
+            p++;
+            left--;
+            continue;
+        }
+        while (left > 0 && static_cast<unsigned char>(*p) >= 0x80) {
+            size_t length = utf8_sequence_length(reinterpret_cast<const unsigned char *>(p), left);
+            if (length > 0) {
+                dest.append(p, p + length);
+            } else {
+                static const char replacement[] = "\xef\xbf\xbd";  // U+FFFD
+                dest.append(replacement, replacement + 3);
+                length = 1;
+            }
+            p += length;
+            left -= length;
+        }
+    }
+}
+
+// append the text as a JSON string, quotes included
+inline void append_string(string_view_t text, memory_buf_t &dest) {
+    dest.push_back('"');
+    append_escaped(text, dest);
+    dest.push_back('"');
+}
+
+}  // namespace json
+}  // namespace details
+}  // namespace spdlog
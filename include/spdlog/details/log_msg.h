@@ -4,6 +4,8 @@
 #pragma once
 
 #include <spdlog/common.h>
+#include <spdlog/field.h>
+#include <spdlog/mdc.h>
 #include <string>
 
 namespace spdlog {
@@ -31,6 +33,14 @@ struct SPDLOG_API log_msg {
 
     source_loc source;
     string_view_t payload;
+    // structured key/value fields (see field.h)
+    field_list fields;
+    // the MDC of the logging thread, captured when the message is copied for later (see
+    // log_msg_buffer and the async queues)
+    mdc_view captured_mdc;
+
+    // the MDC of the message: the captured one, or else the current thread's
+    mdc_view mdc() const { return captured_mdc.valid() ? captured_mdc : spdlog::mdc::view(); }
 };
 }  // namespace details
 }  // namespace spdlog
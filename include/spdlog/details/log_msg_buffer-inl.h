@@ -14,6 +14,8 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg &orig_msg)
     : log_msg{orig_msg} {
     buffer.append(logger_name.begin(), logger_name.end());
     buffer.append(payload.begin(), payload.end());
+    copy_fields();
+    copy_mdc();
     update_string_views();
 }
 
@@ -21,19 +23,30 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg_buffer &other)
     : log_msg{other} {
     buffer.append(logger_name.begin(), logger_name.end());
     buffer.append(payload.begin(), payload.end());
+    copy_fields();
+    copy_mdc();
     update_string_views();
 }
 
 SPDLOG_INLINE log_msg_buffer::log_msg_buffer(log_msg_buffer &&other) SPDLOG_NOEXCEPT
     : log_msg{other},
-      buffer{std::move(other.buffer)} {
-    update_string_views();
+      buffer{std::move(other.buffer)},
+      fields_buffer{std::move(other.fields_buffer)},
+      borrowed{other.borrowed} {
+    if (!borrowed) {
+        update_string_views();
+    }
 }
 
 SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(const log_msg_buffer &other) {
+    if (other.borrowed) {
+        return *this = log_msg_buffer(other);
+    }
     log_msg::operator=(other);
     buffer.clear();
     buffer.append(other.buffer.data(), other.buffer.data() + other.buffer.size());
+    fields_buffer = other.fields_buffer;
+    borrowed = false;
     update_string_views();
     return *this;
 }
@@ -41,13 +54,55 @@ SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(const log_msg_buffer &ot
 SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(log_msg_buffer &&other) SPDLOG_NOEXCEPT {
     log_msg::operator=(other);
     buffer = std::move(other.buffer);
-    update_string_views();
+    fields_buffer = std::move(other.fields_buffer);
+    borrowed = other.borrowed;
+    if (!borrowed) {
+        update_string_views();
+    }
     return *this;
 }
 
+SPDLOG_INLINE void log_msg_buffer::borrow(const log_msg &msg) {
+    log_msg::operator=(msg);
+    buffer.clear();
+    fields_buffer.clear();
+    borrowed = true;
+}
+
+// copy the fields, and their keys and string values after the payload
+SPDLOG_INLINE void log_msg_buffer::copy_fields() {
+    fields_buffer.assign(fields.begin(), fields.end());
+    for (auto &f : fields_buffer) {
+        auto key = f.key();
+        buffer.append(key.begin(), key.end());
+        if (f.type() == field_type::string) {
+            auto value = f.string();
+            buffer.append(value.begin(), value.end());
+        }
+    }
+}
+
+// copy the MDC of the message - the current thread's if it has none yet
+SPDLOG_INLINE void log_msg_buffer::copy_mdc() {
+    captured_mdc = mdc();
+    buffer.append(captured_mdc.entries_data(),
+                  captured_mdc.entries_data() + captured_mdc.entries_size());
+    auto text = captured_mdc.text();
+    buffer.append(text.begin(), text.end());
+}
+
 SPDLOG_INLINE void log_msg_buffer::update_string_views() {
     logger_name = string_view_t{buffer.data(), logger_name.size()};
     payload = string_view_t{buffer.data() + logger_name.size(), payload.size()};
+    const char *p = payload.data() + payload.size();
+    for (auto &f : fields_buffer) {
+        f.rebind(p, p + f.key().size());
+        p += f.data_size();
+    }
+    fields = field_list(fields_buffer.data(), fields_buffer.size());
+    if (captured_mdc.valid()) {
+        captured_mdc.rebind(p, p + captured_mdc.entries_size());
+    }
 }
 
 }  // namespace details
@@ -5,14 +5,24 @@
 
 #include <spdlog/details/log_msg.h>
 
+#include <vector>
+
 namespace spdlog {
 namespace details {
 
 // Extend log_msg with internal buffer to store its payload.
 // This is needed since log_msg holds string_views that points to stack data.
+// The keys and string values of the fields are stored in the buffer after the payload, followed
+// by a snapshot of the MDC.
+// A borrowed buffer refers to storage owned by someone else (e.g. a byte_ring_queue record)
+// instead - moving it keeps the views, copying it copies the message.
 
 class SPDLOG_API log_msg_buffer : public log_msg {
     memory_buf_t buffer;
+    std::vector<field> fields_buffer;  // allocated only for messages with fields
+    bool borrowed = false;
+    void copy_fields();
+    void copy_mdc();
     void update_string_views();
 
 public:
@@ -22,6 +32,9 @@ public:
     log_msg_buffer(log_msg_buffer &&other) SPDLOG_NOEXCEPT;
     log_msg_buffer &operator=(const log_msg_buffer &other);
     log_msg_buffer &operator=(log_msg_buffer &&other) SPDLOG_NOEXCEPT;
+
+    // refer to the storage of msg instead of copying it. the storage must outlive the views
+    void borrow(const log_msg &msg);
 };
 
 }  // namespace details
@@ -0,0 +1,20 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+    #include <spdlog/details/memory_budget.h>
+#endif
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE memory_budget &memory_budget::global() {
+    // trivially destructible, so it stays usable by objects destroyed at exit
+    static memory_budget s_global;
+    return s_global;
+}
+
+}  // namespace details
+}  // namespace spdlog
@@ -0,0 +1,183 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Accounting of the memory held by stored log messages (async queues, backtracers and ringbuffer
+// sinks). A message is accounted by the bytes of its logger name, payload, fields (the field
+// array and the keys and string values) and MDC snapshot.
+//
+// memory_budget - usage counter with an optional limit. Budgets can be chained to a parent
+// (e.g. a thread pool's queue budget to the global budget), so a charge must fit in all of them.
+// memory_charge - bytes charged to a budget, released when the charge is destroyed. Moves with the
+// message (or container) holding it.
+//
+// The usage is tracked only while a limit is set on the budget or one of its parents, so there
+// is no accounting cost otherwise.
+
+#include <spdlog/details/circular_q.h>
+#include <spdlog/details/log_msg_buffer.h>
+
+#include <atomic>
+
+namespace spdlog {
+namespace details {
+
+class SPDLOG_API memory_budget {
+public:
+    // limit of 0 means no limit
+    explicit memory_budget(size_t limit = 0, memory_budget *parent = nullptr)
+        : limit_(limit),
+          parent_(parent) {}
+
+    memory_budget(const memory_budget &) = delete;
+    memory_budget &operator=(const memory_budget &) = delete;
+
+    // process wide budget. parent of the thread pool budgets.
+    static memory_budget &global();
+
+    static size_t bytes_of(const log_msg &msg) {
+        size_t bytes =
+            msg.logger_name.size() + msg.payload.size() + msg.fields.size() * sizeof(field);
+        bytes += msg.mdc().data_size();
+        for (auto &f : msg.fields) {
+            bytes += f.data_size();
+        }
+        return bytes;
+    }
+
+    void set_limit(size_t limit) { limit_.store(limit, std::memory_order_relaxed); }
+
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+    size_t usage() const { return usage_.load(std::memory_order_relaxed); }
+
+    bool tracking() const {
+        return limit() > 0 || (parent_ != nullptr && parent_->tracking());
+    }
+
+    // charge bytes to this budget and its parents. return false (and charge nothing) if any of
+    // them would go over its limit. a charge bigger than a limit is accepted only when nothing
+    // else is charged, so a big message can't be blocked forever.
+    bool try_acquire(size_t bytes) {
+        auto used = usage_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        auto lim = limit();
+        if ((lim > 0 && used > lim && used != bytes) ||
+            (parent_ != nullptr && !parent_->try_acquire(bytes))) {
+            usage_.fetch_sub(bytes, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void release(size_t bytes) {
+        usage_.fetch_sub(bytes, std::memory_order_relaxed);
+        if (parent_ != nullptr) {
+            parent_->release(bytes);
+        }
+    }
+
+private:
+    std::atomic<size_t> limit_;
+    std::atomic<size_t> usage_{0};
+    memory_budget *parent_;
+};
+
+class memory_charge {
+public:
+    memory_charge() = default;
+    ~memory_charge() { reset(); }
+
+    memory_charge(const memory_charge &) = delete;
+    memory_charge &operator=(const memory_charge &) = delete;
+
+    memory_charge(memory_charge &&other) SPDLOG_NOEXCEPT : budget_(other.budget_),
+                                                           bytes_(other.bytes_) {
+        other.budget_ = nullptr;
+        other.bytes_ = 0;
+    }
+
+    memory_charge &operator=(memory_charge &&other) SPDLOG_NOEXCEPT {
+        if (this != &other) {
+            reset();
+            budget_ = other.budget_;
+            bytes_ = other.bytes_;
+            other.budget_ = nullptr;
+            other.bytes_ = 0;
+        }
+        return *this;
+    }
+
+    // charge bytes more to the budget. return false if it's exhausted.
+    bool try_add(memory_budget &budget, size_t bytes) {
+        if (budget_ != nullptr && budget_ != &budget) {
+            reset();
+        }
+        if (!budget.try_acquire(bytes)) {
+            return false;
+        }
+        budget_ = &budget;
+        bytes_ += bytes;
+        return true;
+    }
+
+    // release up to bytes of the charge
+    void remove(size_t bytes) {
+        bytes = bytes < bytes_ ? bytes : bytes_;
+        if (bytes > 0) {
+            budget_->release(bytes);
+            bytes_ -= bytes;
+        }
+    }
+
+    void reset() {
+        if (budget_ != nullptr) {
+            budget_->release(bytes_);
+            budget_ = nullptr;
+            bytes_ = 0;
+        }
+    }
+
+    size_t bytes() const { return bytes_; }
+
+private:
+    memory_budget *budget_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+// helpers for the message rings of the backtracer and the ringbuffer sink, whose whole content is
+// charged to the global budget by a single charge.
+// when the budget is exhausted the oldest messages are dropped. if the budget is still exhausted
+// with an empty ring, the new message is dropped too. return false if the message was dropped.
+inline bool push_charged(circular_q<log_msg_buffer> &q, memory_charge &charge, const log_msg &msg) {
+    if (q.max_size() == 0) {
+        return false;
+    }
+    auto &budget = memory_budget::global();
+    if (budget.tracking()) {
+        while (!charge.try_add(budget, memory_budget::bytes_of(msg))) {
+            if (q.empty()) {
+                return false;
+            }
+            charge.remove(memory_budget::bytes_of(q.front()));
+            q.pop_front();
+        }
+    }
+    if (q.full()) {
+        charge.remove(memory_budget::bytes_of(q.front()));
+    }
+    q.push_back(log_msg_buffer{msg});
+    return true;
+}
+
+inline void pop_charged(circular_q<log_msg_buffer> &q, memory_charge &charge) {
+    charge.remove(memory_budget::bytes_of(q.front()));
+    q.pop_front();
+}
+
+}  // namespace details
+}  // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+    #include "memory_budget-inl.h"
+#endif
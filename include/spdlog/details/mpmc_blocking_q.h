@@ -5,14 +5,22 @@
 
 // multi producer-multi consumer blocking queue.
 // enqueue(..) - will block until room found to put the new message.
+// enqueue_for(..) - will block until room found or timeout have passed, then discard.
 // enqueue_nowait(..) - will return immediately with false if no room left in
 // the queue.
 // dequeue_for(..) - will block until the queue is not empty or timeout have
 // passed.
+// dequeue_bulk(..) - will block until the queue is not empty and pop up to n items.
+// dequeue_bulk_for(..) - same, but will return 0 if the queue is still empty after timeout.
+// try_dequeue_bulk(..) - will pop up to n items without blocking.
+//
+// The counters and the statistics can be read without taking the lock.
 
 #include <spdlog/details/circular_q.h>
+#include <spdlog/details/queue_stats.h>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -29,36 +37,66 @@ public:
 #ifndef __MINGW32__
     // try to enqueue and block if no room left
     void enqueue(T &&item) {
+        bool notify = false;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+            wait_for_room_(lock);
             q_.push_back(std::move(item));
+            notify = pushed_();
+        }
+        if (notify) {
+            push_cv_.notify_one();
         }
-        push_cv_.notify_one();
+    }
+
+    // try to enqueue and block up to timeout if no room left. discard the new message if there
+    // is still no room. return false if discarded.
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout) {
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!wait_for_room_(lock, timeout)) {
+                ++discard_counter_;
+                return false;
+            }
+            q_.push_back(std::move(item));
+            notify = pushed_();
+        }
+        if (notify) {
+            push_cv_.notify_one();
+        }
+        return true;
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
     void enqueue_nowait(T &&item) {
+        bool notify = false;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
+            overrun_oldest_();
             q_.push_back(std::move(item));
+            notify = pushed_();
+        }
+        if (notify) {
+            push_cv_.notify_one();
         }
-        push_cv_.notify_one();
     }
 
     void enqueue_if_have_room(T &&item) {
         bool pushed = false;
+        bool notify = false;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
             if (!q_.full()) {
                 q_.push_back(std::move(item));
                 pushed = true;
+                notify = pushed_();
             }
         }
 
-        if (pushed) {
+        if (notify) {
             push_cv_.notify_one();
-        } else {
+        } else if (!pushed) {
             ++discard_counter_;
         }
     }
@@ -66,27 +104,98 @@ public:
     // dequeue with a timeout.
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration) {
+        bool notify = false;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); })) {
-                return false;
+            if (q_.empty()) {
+                waiting_consumers_++;
+                bool have_items =
+                    push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); });
+                waiting_consumers_--;
+                if (!have_items) {
+                    return false;
+                }
             }
             popped_item = std::move(q_.front());
             q_.pop_front();
+            notify = popped_();
+        }
+        if (notify) {
+            pop_cv_.notify_one();
         }
-        pop_cv_.notify_one();
         return true;
     }
 
     // blocking dequeue without a timeout.
     void dequeue(T &popped_item) {
+        bool notify = false;
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
-            push_cv_.wait(lock, [this] { return !this->q_.empty(); });
+            wait_for_items_(lock);
             popped_item = std::move(q_.front());
             q_.pop_front();
+            notify = popped_();
+        }
+        if (notify) {
+            pop_cv_.notify_one();
+        }
+    }
+
+    // blocking dequeue of up to max_items items (at least one) under a single lock.
+    // Return the number of items dequeued.
+    size_t dequeue_bulk(T *popped_items, size_t max_items) {
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            wait_for_items_(lock);
+            count = pop_bulk_(popped_items, max_items);
+            notify = popped_();
+        }
+        if (notify) {
+            notify_popped_(count);
+        }
+        return count;
+    }
+
+    // dequeue_bulk() waiting at most wait_duration.
+    // Return the number of items dequeued (0 on timeout).
+    size_t dequeue_bulk_for(T *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds wait_duration) {
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (!wait_for_items_(lock, wait_duration)) {
+                return 0;
+            }
+            count = pop_bulk_(popped_items, max_items);
+            notify = popped_();
         }
-        pop_cv_.notify_one();
+        if (notify) {
+            notify_popped_(count);
+        }
+        return count;
+    }
+
+    // non blocking dequeue of up to max_items items.
+    // Return the number of items dequeued (0 if the queue is empty).
+    size_t try_dequeue_bulk(T *popped_items, size_t max_items) {
+        if (size_hint_.load(std::memory_order_acquire) == 0) {
+            return 0;  // don't contend on the mutex while polling an empty queue
+        }
+        size_t count = 0;
+        bool notify = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            count = pop_bulk_(popped_items, max_items);
+            notify = count > 0 && popped_();
+        }
+        if (notify) {
+            notify_popped_(count);
+        }
+        return count;
     }
 
 #else
@@ -96,28 +205,45 @@ public:
     // try to enqueue and block if no room left
     void enqueue(T &&item) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+        wait_for_room_(lock);
         q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        if (pushed_()) {
+            push_cv_.notify_one();
+        }
+    }
+
+    // try to enqueue and block up to timeout if no room left. discard the new message if there
+    // is still no room. return false if discarded.
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (!wait_for_room_(lock, timeout)) {
+            ++discard_counter_;
+            return false;
+        }
+        q_.push_back(std::move(item));
+        if (pushed_()) {
+            push_cv_.notify_one();
+        }
+        return true;
     }
 
     // enqueue immediately. overrun oldest message in the queue if no room left.
     void enqueue_nowait(T &&item) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
+        overrun_oldest_();
         q_.push_back(std::move(item));
-        push_cv_.notify_one();
+        if (pushed_()) {
+            push_cv_.notify_one();
+        }
     }
 
     void enqueue_if_have_room(T &&item) {
-        bool pushed = false;
         std::unique_lock<std::mutex> lock(queue_mutex_);
         if (!q_.full()) {
             q_.push_back(std::move(item));
-            pushed = true;
-        }
-
-        if (pushed) {
-            push_cv_.notify_one();
+            if (pushed_()) {
+                push_cv_.notify_one();
+            }
         } else {
             ++discard_counter_;
         }
@@ -127,31 +253,80 @@ public:
     // Return true, if succeeded dequeue item, false otherwise
     bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        if (!push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); })) {
-            return false;
+        if (q_.empty()) {
+            waiting_consumers_++;
+            bool have_items =
+                push_cv_.wait_for(lock, wait_duration, [this] { return !this->q_.empty(); });
+            waiting_consumers_--;
+            if (!have_items) {
+                return false;
+            }
         }
         popped_item = std::move(q_.front());
         q_.pop_front();
-        pop_cv_.notify_one();
+        if (popped_()) {
+            pop_cv_.notify_one();
+        }
         return true;
     }
 
     // blocking dequeue without a timeout.
     void dequeue(T &popped_item) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        push_cv_.wait(lock, [this] { return !this->q_.empty(); });
+        wait_for_items_(lock);
         popped_item = std::move(q_.front());
         q_.pop_front();
-        pop_cv_.notify_one();
+        if (popped_()) {
+            pop_cv_.notify_one();
+        }
     }
 
-#endif
+    // blocking dequeue of up to max_items items (at least one) under a single lock.
+    // Return the number of items dequeued.
+    size_t dequeue_bulk(T *popped_items, size_t max_items) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        wait_for_items_(lock);
+        size_t count = pop_bulk_(popped_items, max_items);
+        if (popped_()) {
+            notify_popped_(count);
+        }
+        return count;
+    }
 
-    size_t overrun_counter() {
+    // dequeue_bulk() waiting at most wait_duration.
+    // Return the number of items dequeued (0 on timeout).
+    size_t dequeue_bulk_for(T *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds wait_duration) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        return q_.overrun_counter();
+        if (!wait_for_items_(lock, wait_duration)) {
+            return 0;
+        }
+        size_t count = pop_bulk_(popped_items, max_items);
+        if (popped_()) {
+            notify_popped_(count);
+        }
+        return count;
     }
 
+    // non blocking dequeue of up to max_items items.
+    // Return the number of items dequeued (0 if the queue is empty).
+    size_t try_dequeue_bulk(T *popped_items, size_t max_items) {
+        if (size_hint_.load(std::memory_order_acquire) == 0) {
+            return 0;  // don't contend on the mutex while polling an empty queue
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        size_t count = pop_bulk_(popped_items, max_items);
+        if (count > 0 && popped_()) {
+            notify_popped_(count);
+        }
+        return count;
+    }
+
+#endif
+
+    size_t overrun_counter() { return overrun_counter_.load(std::memory_order_relaxed); }
+
     size_t discard_counter() { return discard_counter_.load(std::memory_order_relaxed); }
 
     size_t size() {
@@ -159,19 +334,111 @@ public:
         return q_.size();
     }
 
-    void reset_overrun_counter() {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        q_.reset_overrun_counter();
-    }
+    void reset_overrun_counter() { overrun_counter_.store(0, std::memory_order_relaxed); }
 
     void reset_discard_counter() { discard_counter_.store(0, std::memory_order_relaxed); }
 
+    queue_stats &stats() { return stats_; }
+
 private:
+    // The waiting threads are counted under the mutex, so the other side signals the condition
+    // variable only when someone actually waits on it. A consumer that is awake (or polling with
+    // try_dequeue_bulk()) costs the producers no notify call.
+
+    void wait_for_room_(std::unique_lock<std::mutex> &lock) {
+        if (q_.full()) {
+            auto start = queue_stats::clock::now();
+            waiting_producers_++;
+            pop_cv_.wait(lock, [this] { return !this->q_.full(); });
+            waiting_producers_--;
+            stats_.add_blocked_since(start);
+        }
+    }
+
+    // return false if there is still no room after timeout
+    bool wait_for_room_(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds timeout) {
+        if (q_.full()) {
+            auto start = queue_stats::clock::now();
+            waiting_producers_++;
+            bool room = pop_cv_.wait_for(lock, timeout, [this] { return !this->q_.full(); });
+            waiting_producers_--;
+            stats_.add_blocked_since(start);
+            return room;
+        }
+        return true;
+    }
+
+    // drop the oldest item if the queue is full. must be called with the mutex held.
+    // the item is released here rather than left in its slot until overwritten.
+    void overrun_oldest_() {
+        if (q_.full()) {
+            q_.front() = T();
+            q_.pop_front();
+            overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void wait_for_items_(std::unique_lock<std::mutex> &lock) {
+        if (q_.empty()) {
+            waiting_consumers_++;
+            push_cv_.wait(lock, [this] { return !this->q_.empty(); });
+            waiting_consumers_--;
+        }
+    }
+
+    // return false if the queue is still empty after timeout
+    bool wait_for_items_(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds timeout) {
+        if (q_.empty()) {
+            waiting_consumers_++;
+            bool have_items =
+                push_cv_.wait_for(lock, timeout, [this] { return !this->q_.empty(); });
+            waiting_consumers_--;
+            return have_items;
+        }
+        return true;
+    }
+
+    size_t pop_bulk_(T *popped_items, size_t max_items) {
+        size_t count = 0;
+        while (count < max_items && !q_.empty()) {
+            popped_items[count++] = std::move(q_.front());
+            q_.pop_front();
+        }
+        return count;
+    }
+
+    // must be called with the mutex held. return true if a consumer should be notified.
+    bool pushed_() {
+        size_hint_.store(q_.size(), std::memory_order_release);
+        stats_.update_high_water_mark(q_.size());
+        return waiting_consumers_ > 0;
+    }
+
+    // must be called with the mutex held. return true if the producers should be notified.
+    bool popped_() {
+        size_hint_.store(q_.size(), std::memory_order_release);
+        return waiting_producers_ > 0;
+    }
+
+    // wake up as many blocked producers as there are new free slots
+    void notify_popped_(size_t count) {
+        if (count == 1) {
+            pop_cv_.notify_one();
+        } else {
+            pop_cv_.notify_all();
+        }
+    }
+
     std::mutex queue_mutex_;
     std::condition_variable push_cv_;
     std::condition_variable pop_cv_;
     spdlog::details::circular_q<T> q_;
+    std::atomic<size_t> overrun_counter_{0};
     std::atomic<size_t> discard_counter_{0};
+    queue_stats stats_;
+    size_t waiting_consumers_ = 0;      // guarded by queue_mutex_
+    size_t waiting_producers_ = 0;      // guarded by queue_mutex_
+    std::atomic<size_t> size_hint_{0};  // q_.size() as of the last push or pop
 };
 }  // namespace details
 }  // namespace spdlog
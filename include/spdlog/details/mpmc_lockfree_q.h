@@ -0,0 +1,356 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-multi consumer lock-free bounded queue.
+// Based on Dmitry Vyukov's bounded MPMC queue: every slot carries a sequence number
+// which tells producers and consumers whether the slot is free or holds an item.
+// Producers and consumers never take a lock on the fast path. A mutex/cv pair is used only
+// to park threads that have nothing to do (empty queue for consumers, full queue for
+// producers under the block policy), and is touched by the other side only if someone is
+// actually parked.
+//
+// Has the same interface as mpmc_blocking_queue:
+// enqueue_for(..) - will block until room found or timeout have passed, then discard.
+// enqueue(..) - will block until room found to put the new message.
+// enqueue_nowait(..) - will overrun the oldest message if no room left in the queue.
+// enqueue_if_have_room(..) - will discard the new message if no room left in the queue.
+// dequeue_for(..) - will block until the queue is not empty or timeout have passed.
+// dequeue(..) - will block until the queue is not empty.
+// dequeue_bulk(..) - will block until the queue is not empty and pop up to n items.
+// dequeue_bulk_for(..) - same, but will return 0 if the queue is still empty after timeout.
+// try_dequeue_bulk(..) - will pop up to n items without blocking.
+//
+// The capacity is rounded up to the next power of two.
+
+#include <spdlog/common.h>
+#include <spdlog/details/queue_stats.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+template <typename T>
+class mpmc_lockfree_queue {
+public:
+    using item_type = T;
+
+    explicit mpmc_lockfree_queue(size_t max_items) {
+        if (max_items == 0) {
+            return;  // disabled queue - nothing can be pushed
+        }
+        size_t capacity = 2;
+        while (capacity < max_items) {
+            capacity <<= 1;
+        }
+        mask_ = capacity - 1;
+        cells_.reset(new cell[capacity]);
+        for (size_t i = 0; i < capacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpmc_lockfree_queue(const mpmc_lockfree_queue &) = delete;
+    mpmc_lockfree_queue &operator=(const mpmc_lockfree_queue &) = delete;
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item) {
+        if (!cells_) {
+            return;
+        }
+        if (try_enqueue_(item)) {
+            notify_consumers_();
+            return;
+        }
+        auto start = queue_stats::clock::now();
+        if (try_enqueue_spin_(item)) {
+            stats_.add_blocked_since(start);
+            notify_consumers_();
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_producers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!try_enqueue_(item)) {
+                pop_cv_.wait(lock);
+            }
+            parked_producers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        stats_.add_blocked_since(start);
+        notify_consumers_();
+    }
+
+    // try to enqueue and block up to timeout if no room left. discard the new message if there
+    // is still no room. return false if discarded.
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout) {
+        if (cells_ && try_enqueue_(item)) {
+            notify_consumers_();
+            return true;
+        }
+        auto start = queue_stats::clock::now();
+        bool pushed = cells_ && try_enqueue_spin_(item);
+        if (!pushed && cells_) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_producers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            pushed = pop_cv_.wait_until(lock, start + timeout, [&] { return try_enqueue_(item); });
+            parked_producers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        stats_.add_blocked_since(start);
+        if (pushed) {
+            notify_consumers_();
+        } else {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return pushed;
+    }
+
+    // enqueue immediately. overrun oldest message in the queue if no room left.
+    void enqueue_nowait(T &&item) {
+        if (!cells_) {
+            overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        while (!try_enqueue_(item)) {
+            T oldest;
+            if (try_dequeue_(oldest)) {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        notify_consumers_();
+    }
+
+    void enqueue_if_have_room(T &&item) {
+        if (cells_ && try_enqueue_(item)) {
+            notify_consumers_();
+        } else {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // dequeue with a timeout.
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration) {
+        if (!cells_) {
+            std::this_thread::sleep_for(wait_duration);
+            return false;
+        }
+        if (!try_dequeue_spin_(popped_item)) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_consumers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool dequeued =
+                push_cv_.wait_for(lock, wait_duration, [&] { return try_dequeue_(popped_item); });
+            parked_consumers_.fetch_sub(1, std::memory_order_relaxed);
+            if (!dequeued) {
+                return false;
+            }
+        }
+        notify_producers_();
+        return true;
+    }
+
+    // blocking dequeue without a timeout.
+    void dequeue(T &popped_item) {
+        if (!try_dequeue_spin_(popped_item)) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_consumers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            push_cv_.wait(lock, [&] { return try_dequeue_(popped_item); });
+            parked_consumers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_producers_();
+    }
+
+    // blocking dequeue of up to max_items items (at least one).
+    // Return the number of items dequeued.
+    size_t dequeue_bulk(T *popped_items, size_t max_items) {
+        dequeue(popped_items[0]);
+        return dequeue_rest_(popped_items, max_items);
+    }
+
+    // dequeue_bulk() waiting at most wait_duration.
+    // Return the number of items dequeued (0 on timeout).
+    size_t dequeue_bulk_for(T *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds wait_duration) {
+        if (!dequeue_for(popped_items[0], wait_duration)) {
+            return 0;
+        }
+        return dequeue_rest_(popped_items, max_items);
+    }
+
+    // non blocking dequeue of up to max_items items.
+    // Return the number of items dequeued (0 if the queue is empty).
+    size_t try_dequeue_bulk(T *popped_items, size_t max_items) {
+        size_t count = 0;
+        while (count < max_items && try_dequeue_(popped_items[count])) {
+            count++;
+        }
+        if (count > 0) {
+            notify_producers_(count > 1);
+            stats_.update_high_water_mark(size() + count);
+        }
+        return count;
+    }
+
+    size_t overrun_counter() { return overrun_counter_.load(std::memory_order_relaxed); }
+
+    size_t discard_counter() { return discard_counter_.load(std::memory_order_relaxed); }
+
+    // approximate number of items in the queue (exact when there is no concurrent activity)
+    size_t size() {
+        auto tail = enqueue_pos_.value.load(std::memory_order_acquire);
+        auto head = dequeue_pos_.value.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    void reset_overrun_counter() { overrun_counter_.store(0, std::memory_order_relaxed); }
+
+    void reset_discard_counter() { discard_counter_.store(0, std::memory_order_relaxed); }
+
+    queue_stats &stats() { return stats_; }
+
+private:
+    static constexpr size_t cache_line_size = 64;
+    static constexpr int spin_count = 64;
+
+    struct cell {
+        std::atomic<size_t> sequence{0};
+        T data;
+    };
+
+    bool try_enqueue_(T &item) {
+        auto pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+        for (;;) {
+            cell &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1,
+                                                         std::memory_order_relaxed)) {
+                    c.data = std::move(item);
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_dequeue_(T &popped_item) {
+        if (!cells_) {
+            return false;
+        }
+        auto pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+        for (;;) {
+            cell &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.value.compare_exchange_weak(pos, pos + 1,
+                                                         std::memory_order_relaxed)) {
+                    popped_item = std::move(c.data);
+                    c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // take the rest of a bulk after its first item
+    size_t dequeue_rest_(T *popped_items, size_t max_items) {
+        size_t count = 1;
+        while (count < max_items && try_dequeue_(popped_items[count])) {
+            count++;
+        }
+        if (count > 1) {
+            notify_producers_(true);
+        }
+        stats_.update_high_water_mark(size() + count);
+        return count;
+    }
+
+    bool try_enqueue_spin_(T &item) {
+        for (int i = 0; i < spin_count; i++) {
+            if (try_enqueue_(item)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    bool try_dequeue_spin_(T &popped_item) {
+        for (int i = 0; i < spin_count; i++) {
+            if (try_dequeue_(popped_item)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    // The seq_cst fence pairs with the seq_cst increment of the parked counter done by the
+    // waiting side, so either we see the waiter, or the waiter sees our update before it sleeps.
+    // Taking the mutex before notifying closes the window between the waiter's predicate check
+    // and its wait.
+    void notify_consumers_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_consumers_.load(std::memory_order_relaxed) > 0) {
+            { std::lock_guard<std::mutex> lock(park_mutex_); }
+            push_cv_.notify_one();
+        }
+    }
+
+    void notify_producers_(bool all = false) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_producers_.load(std::memory_order_relaxed) > 0) {
+            { std::lock_guard<std::mutex> lock(park_mutex_); }
+            if (all) {
+                pop_cv_.notify_all();
+            } else {
+                pop_cv_.notify_one();
+            }
+        }
+    }
+
+    std::unique_ptr<cell[]> cells_;
+    size_t mask_ = 0;
+
+    // keep the producer and consumer positions on separate cache lines
+    struct padded_pos {
+        char pad_before[cache_line_size];
+        std::atomic<size_t> value{0};
+        char pad_after[cache_line_size - sizeof(std::atomic<size_t>)];
+    };
+    padded_pos enqueue_pos_;
+    padded_pos dequeue_pos_;
+
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<size_t> discard_counter_{0};
+    queue_stats stats_;
+
+    std::mutex park_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    std::atomic<int> parked_consumers_{0};
+    std::atomic<int> parked_producers_{0};
+};
+}  // namespace details
+}  // namespace spdlog
@@ -41,10 +41,13 @@
 #else  // unix
 
     #include <fcntl.h>
+    #include <pthread.h>  // for the thread settings
+    #include <sched.h>
     #include <unistd.h>
 
     #ifdef __linux__
-        #include <sys/syscall.h>  //Use gettid() syscall under linux to get thread id
+        #include <sys/resource.h>  // for setpriority
+        #include <sys/syscall.h>   //Use gettid() syscall under linux to get thread id
 
     #elif defined(_AIX)
         #include <pthread.h>  // for pthread_getthrds_np
@@ -580,6 +583,90 @@ SPDLOG_INLINE bool fsync(FILE *fp) {
 #endif
 }
 
+SPDLOG_INLINE bool set_thread_affinity(const std::vector<size_t> &cpus) {
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (auto cpu : cpus) {
+        if (cpu >= sizeof(DWORD_PTR) * 8) {
+            return false;
+        }
+        mask |= DWORD_PTR(1) << cpu;
+    }
+    return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+#elif defined(__linux__) && !defined(__ANDROID__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            errno = EINVAL;
+            return false;
+        }
+        CPU_SET(cpu, &cpu_set);
+    }
+    int rv = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (rv != 0) {
+        errno = rv;
+    }
+    return rv == 0;
+#else
+    (void)(cpus);
+    return false;
+#endif
+}
+
+SPDLOG_INLINE bool set_thread_realtime(int priority) {
+#ifdef _WIN32
+    (void)(priority);
+    return ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    sched_param param{};
+    param.sched_priority = priority;
+    int rv = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+    if (rv != 0) {
+        errno = rv;
+    }
+    return rv == 0;
+#endif
+}
+
+SPDLOG_INLINE bool set_thread_nice(int nice) {
+#ifdef _WIN32
+    int priority = THREAD_PRIORITY_NORMAL;
+    if (nice <= -10) {
+        priority = THREAD_PRIORITY_HIGHEST;
+    } else if (nice < 0) {
+        priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    } else if (nice >= 10) {
+        priority = THREAD_PRIORITY_LOWEST;
+    } else if (nice > 0) {
+        priority = THREAD_PRIORITY_BELOW_NORMAL;
+    }
+    return ::SetThreadPriority(::GetCurrentThread(), priority) != 0;
+#elif defined(__linux__)
+    // on linux the nice value is per thread
+    return ::setpriority(PRIO_PROCESS, static_cast<id_t>(_thread_id()), nice) == 0;
+#else
+    (void)(nice);
+    return false;
+#endif
+}
+
+SPDLOG_INLINE bool set_thread_name(const std::string &name) {
+#if defined(__linux__) && defined(__GLIBC__)
+    // the name is limited to 16 chars including the terminating null
+    int rv = ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+    if (rv != 0) {
+        errno = rv;
+    }
+    return rv == 0;
+#elif defined(__APPLE__)
+    return ::pthread_setname_np(name.c_str()) == 0;
+#else
+    (void)(name);
+    return false;
+#endif
+}
+
 }  // namespace os
 }  // namespace details
 }  // namespace spdlog
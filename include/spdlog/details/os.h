@@ -5,6 +5,7 @@
 
 #include <ctime>  // std::time_t
 #include <spdlog/common.h>
+#include <vector>
 
 namespace spdlog {
 namespace details {
@@ -114,6 +115,21 @@ SPDLOG_API std::string getenv(const char *field);
 // Return true on success.
 SPDLOG_API bool fsync(FILE *fp);
 
+// Settings of the calling thread.
+// Return true on success, false on failure (errno is set) or if not supported by the platform.
+
+// Restrict the thread to the given cpus.
+SPDLOG_API bool set_thread_affinity(const std::vector<size_t> &cpus);
+
+// Run the thread under the SCHED_FIFO real time policy with the given priority.
+SPDLOG_API bool set_thread_realtime(int priority);
+
+// Set the nice value of the thread (linux) or the closest thread priority (windows).
+SPDLOG_API bool set_thread_nice(int nice);
+
+// Set the thread name as shown by debuggers and tools like top (truncated to 15 chars on linux).
+SPDLOG_API bool set_thread_name(const std::string &name);
+
 }  // namespace os
 }  // namespace details
 }  // namespace spdlog
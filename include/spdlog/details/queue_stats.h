@@ -0,0 +1,54 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Statistics kept by the async queues (see thread_pool::stats()).
+// Updated and read without taking the queue lock:
+// high water mark - max number of items seen in the queue.
+// blocked time - total time producers waited for room in the queue (block policy).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace spdlog {
+namespace details {
+
+class queue_stats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // called with the current size of the queue. costs a single load unless it's a new max.
+    void update_high_water_mark(size_t size) {
+        auto current = high_water_mark_.load(std::memory_order_relaxed);
+        while (size > current &&
+               !high_water_mark_.compare_exchange_weak(current, size, std::memory_order_relaxed)) {
+        }
+    }
+
+    size_t high_water_mark() const { return high_water_mark_.load(std::memory_order_relaxed); }
+
+    // add the time from start (when the producer found no room) until now
+    void add_blocked_since(clock::time_point start) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        blocked_ns_.fetch_add(static_cast<std::uint64_t>(ns.count()), std::memory_order_relaxed);
+    }
+
+    std::chrono::nanoseconds blocked_time() const {
+        return std::chrono::nanoseconds(
+            static_cast<std::int64_t>(blocked_ns_.load(std::memory_order_relaxed)));
+    }
+
+    void reset() {
+        high_water_mark_.store(0, std::memory_order_relaxed);
+        blocked_ns_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> high_water_mark_{0};
+    std::atomic<std::uint64_t> blocked_ns_{0};
+};
+
+}  // namespace details
+}  // namespace spdlog
@@ -8,6 +8,7 @@
 #endif
 
 #include <spdlog/common.h>
+#include <spdlog/details/memory_budget.h>
 #include <spdlog/details/periodic_worker.h>
 #include <spdlog/logger.h>
 #include <spdlog/pattern_formatter.h>
@@ -246,6 +247,12 @@ SPDLOG_INLINE void registry::set_automatic_registration(bool automatic_registrat
     automatic_registration_ = automatic_registration;
 }
 
+SPDLOG_INLINE void registry::set_memory_limit(size_t max_bytes) {
+    memory_budget::global().set_limit(max_bytes);
+}
+
+SPDLOG_INLINE size_t registry::memory_usage() { return memory_budget::global().usage(); }
+
 SPDLOG_INLINE void registry::set_levels(log_levels levels, level::level_enum *global_level) {
     std::lock_guard<std::mutex> lock(logger_map_mutex_);
     log_levels_ = std::move(levels);
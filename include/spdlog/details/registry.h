@@ -98,6 +98,11 @@ public:
 
     void set_automatic_registration(bool automatic_registration);
 
+    // process wide limit of the memory held by stored messages (see details::memory_budget)
+    void set_memory_limit(size_t max_bytes);
+
+    size_t memory_usage();
+
     // set levels for all existing/future loggers. global_level can be null if should not set.
     void set_levels(log_levels levels, level::level_enum *global_level);
 
@@ -0,0 +1,473 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-multi consumer queue built from per producer thread lanes.
+// Each producer thread lazily registers (through thread local storage) its own bounded
+// single producer ring, so producers never share a cache line with each other.
+// Consumers merge the lanes by taking the oldest head item (by its "time" member), so the
+// output is globally ordered up to the small window of items that producers are still pushing.
+//
+// Has the same interface as mpmc_blocking_queue:
+// enqueue_for(..) - will block until room found or timeout have passed, then discard.
+// enqueue(..) - will block until room found in the caller's lane to put the new message.
+// enqueue_nowait(..) - will overrun the oldest message of the caller's lane if no room left.
+// enqueue_if_have_room(..) - will discard the new message if no room left in the caller's lane.
+// dequeue_for(..) - will block until the queue is not empty or timeout have passed.
+// dequeue(..) - will block until the queue is not empty.
+// dequeue_bulk(..) - will block until the queue is not empty and pop up to n items.
+// dequeue_bulk_for(..) - same, but will return 0 if the queue is still empty after timeout.
+// try_dequeue_bulk(..) - will pop up to n items without blocking.
+//
+// max_items is the capacity of each lane. Lanes are allocated on the first push of each thread
+// and released once their thread has exited and they have been drained, or with the queue.
+// T must have a "time" member (std::chrono::time_point) which is used to merge the lanes.
+
+#include <spdlog/common.h>
+#include <spdlog/details/queue_stats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+template <typename T>
+class spsc_lanes_queue {
+public:
+    using item_type = T;
+
+    explicit spsc_lanes_queue(size_t max_items)
+        : id_(next_queue_id_()),
+          lane_capacity_(max_items) {}
+
+    ~spsc_lanes_queue() {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        // the producer threads may still hold the lanes - free their items now
+        for (auto &l : lanes_) {
+            l->detached.store(true, std::memory_order_relaxed);
+            l->cells.reset();
+        }
+    }
+
+    spsc_lanes_queue(const spsc_lanes_queue &) = delete;
+    spsc_lanes_queue &operator=(const spsc_lanes_queue &) = delete;
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item) {
+        lane *l = local_lane_();
+        if (l == nullptr) {
+            return;
+        }
+        if (l->try_push(item)) {
+            notify_consumers_();
+            return;
+        }
+        auto start = queue_stats::clock::now();
+        for (int i = 0; i < spin_count; i++) {
+            std::this_thread::yield();
+            if (l->try_push(item)) {
+                stats_.add_blocked_since(start);
+                notify_consumers_();
+                return;
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_producers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!l->try_push(item)) {
+                pop_cv_.wait(lock);
+            }
+            parked_producers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        stats_.add_blocked_since(start);
+        notify_consumers_();
+    }
+
+    // try to enqueue and block up to timeout if no room left in the caller's lane. discard the
+    // new message if there is still no room. return false if discarded.
+    bool enqueue_for(T &&item, std::chrono::milliseconds timeout) {
+        lane *l = local_lane_();
+        if (l != nullptr && l->try_push(item)) {
+            notify_consumers_();
+            return true;
+        }
+        auto start = queue_stats::clock::now();
+        bool pushed = false;
+        for (int i = 0; l != nullptr && i < spin_count && !pushed; i++) {
+            std::this_thread::yield();
+            pushed = l->try_push(item);
+        }
+        if (!pushed && l != nullptr) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_producers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            pushed = pop_cv_.wait_until(lock, start + timeout, [&] { return l->try_push(item); });
+            parked_producers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        stats_.add_blocked_since(start);
+        if (pushed) {
+            notify_consumers_();
+        } else {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return pushed;
+    }
+
+    // enqueue immediately. overrun oldest message in the caller's lane if no room left.
+    void enqueue_nowait(T &&item) {
+        lane *l = local_lane_();
+        if (l == nullptr) {
+            overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        while (!l->try_push(item)) {
+            T oldest;
+            if (l->try_pop(oldest)) {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        notify_consumers_();
+    }
+
+    void enqueue_if_have_room(T &&item) {
+        lane *l = local_lane_();
+        if (l != nullptr && l->try_push(item)) {
+            notify_consumers_();
+        } else {
+            discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // dequeue with a timeout.
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration) {
+        return dequeue_bulk_for(&popped_item, 1, wait_duration) == 1;
+    }
+
+    // blocking dequeue without a timeout.
+    void dequeue(T &popped_item) { dequeue_bulk(&popped_item, 1); }
+
+    // blocking dequeue of up to max_items items (at least one).
+    // Return the number of items dequeued.
+    size_t dequeue_bulk(T *popped_items, size_t max_items) {
+        size_t count = try_pop_bulk_spin_(popped_items, max_items);
+        if (count == 0) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_consumers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            push_cv_.wait(lock,
+                          [&] { return (count = try_pop_bulk_(popped_items, max_items)) > 0; });
+            parked_consumers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_producers_();
+        return count;
+    }
+
+    // dequeue_bulk() waiting at most wait_duration.
+    // Return the number of items dequeued (0 on timeout).
+    size_t dequeue_bulk_for(T *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds wait_duration) {
+        size_t count = try_pop_bulk_spin_(popped_items, max_items);
+        if (count == 0) {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_consumers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            push_cv_.wait_for(lock, wait_duration, [&] {
+                return (count = try_pop_bulk_(popped_items, max_items)) > 0;
+            });
+            parked_consumers_.fetch_sub(1, std::memory_order_relaxed);
+            if (count == 0) {
+                return 0;
+            }
+        }
+        notify_producers_();
+        return count;
+    }
+
+    // non blocking dequeue of up to max_items items.
+    // Return the number of items dequeued (0 if the queue is empty).
+    size_t try_dequeue_bulk(T *popped_items, size_t max_items) {
+        size_t count = try_pop_bulk_(popped_items, max_items);
+        if (count > 0) {
+            notify_producers_();
+        }
+        return count;
+    }
+
+    size_t overrun_counter() { return overrun_counter_.load(std::memory_order_relaxed); }
+
+    size_t discard_counter() { return discard_counter_.load(std::memory_order_relaxed); }
+
+    // approximate number of items in all lanes (exact when there is no concurrent activity)
+    size_t size() {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        size_t total = 0;
+        for (auto &l : lanes_) {
+            total += l->size();
+        }
+        return total;
+    }
+
+    // number of registered producer lanes
+    size_t lanes_count() {
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        return lanes_.size();
+    }
+
+    void reset_overrun_counter() { overrun_counter_.store(0, std::memory_order_relaxed); }
+
+    void reset_discard_counter() { discard_counter_.store(0, std::memory_order_relaxed); }
+
+    queue_stats &stats() { return stats_; }
+
+private:
+    static constexpr int spin_count = 64;
+
+    // bounded ring owned by a single producer thread.
+    // The head is advanced with a CAS since the producer may also pop its oldest item (overrun).
+    // Slot sequence numbers tell whether a slot is free or holds a published item.
+    struct lane {
+        struct cell {
+            std::atomic<size_t> sequence{0};
+            std::atomic<std::int64_t> stamp{0};
+            T data;
+        };
+
+        explicit lane(size_t lane_capacity)
+            : cells(new cell[lane_capacity]),
+              capacity(lane_capacity) {
+            for (size_t i = 0; i < capacity; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // called by the owner thread only
+        bool try_push(T &item) {
+            cell &c = cells[tail % capacity];
+            if (c.sequence.load(std::memory_order_acquire) != tail) {
+                return false;  // full
+            }
+            c.stamp.store(item.time.time_since_epoch().count(), std::memory_order_relaxed);
+            c.data = std::move(item);
+            c.sequence.store(tail + 1, std::memory_order_release);
+            tail++;
+            published.store(tail, std::memory_order_release);
+            return true;
+        }
+
+        // stamp of the oldest item. return false if the lane is empty.
+        bool peek(std::int64_t &stamp) {
+            auto pos = head.load(std::memory_order_acquire);
+            cell &c = cells[pos % capacity];
+            if (c.sequence.load(std::memory_order_acquire) != pos + 1) {
+                return false;
+            }
+            stamp = c.stamp.load(std::memory_order_relaxed);
+            return true;
+        }
+
+        bool try_pop(T &popped_item) {
+            auto pos = head.load(std::memory_order_relaxed);
+            for (;;) {
+                cell &c = cells[pos % capacity];
+                if (c.sequence.load(std::memory_order_acquire) != pos + 1) {
+                    return false;  // empty
+                }
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    popped_item = std::move(c.data);
+                    c.sequence.store(pos + capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+
+        size_t size() const {
+            auto t = published.load(std::memory_order_acquire);
+            auto h = head.load(std::memory_order_acquire);
+            return t > h ? t - h : 0;
+        }
+
+        std::unique_ptr<cell[]> cells;
+        const size_t capacity;
+        size_t tail = 0;  // owner thread only
+        std::atomic<size_t> published{0};
+        std::atomic<size_t> head{0};
+        std::atomic<bool> detached{false};  // the queue was destroyed and freed the cells
+    };
+
+    using lane_ptr = std::shared_ptr<lane>;
+
+    static size_t next_queue_id_() {
+        static std::atomic<size_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // return the calling thread's lane in this queue. register a new one on first use.
+    lane *local_lane_() {
+        if (lane_capacity_ == 0) {
+            return nullptr;
+        }
+        // (queue id, lane) pairs of the queues this thread has pushed to
+        thread_local std::vector<std::pair<size_t, lane_ptr>> local_lanes;
+        for (auto &entry : local_lanes) {
+            if (entry.first == id_) {
+                return entry.second.get();
+            }
+        }
+        // slow path - forget lanes of destroyed queues and register a new lane
+        for (auto it = local_lanes.begin(); it != local_lanes.end();) {
+            if (it->second->detached.load(std::memory_order_relaxed)) {
+                it = local_lanes.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto new_lane = std::make_shared<lane>(lane_capacity_);
+        {
+            std::lock_guard<std::mutex> lock(lanes_mutex_);
+            lanes_.push_back(new_lane);
+            lanes_version_.fetch_add(1, std::memory_order_release);
+        }
+        local_lanes.emplace_back(id_, new_lane);
+        return new_lane.get();
+    }
+
+    // pop up to max_items items, oldest first, merging the lanes by their head items.
+    // the lanes are scanned once per call - after that only the lane an item was taken from
+    // is peeked again. the high water mark is updated from the same scan.
+    size_t try_pop_bulk_(T *popped_items, size_t max_items) {
+        std::lock_guard<std::mutex> lock(consumer_mutex_);
+        refresh_consumer_lanes_();
+        heads_.clear();
+        size_t queued = 0;
+        for (auto &l : consumer_lanes_) {
+            std::int64_t stamp = 0;
+            if (l->peek(stamp)) {
+                heads_.push_back(lane_head{stamp, l.get()});
+                queued += l->size();
+            } else if (l.use_count() == 2) {
+                // held only by lanes_ and consumer_lanes_ - its thread has exited
+                release_lanes_ = true;
+            }
+        }
+        // min heap by stamp
+        auto later = [](const lane_head &a, const lane_head &b) { return a.stamp > b.stamp; };
+        std::make_heap(heads_.begin(), heads_.end(), later);
+        size_t count = 0;
+        while (count < max_items && !heads_.empty()) {
+            std::pop_heap(heads_.begin(), heads_.end(), later);
+            auto &oldest = heads_.back();
+            // could fail only if the owner overran its oldest item meanwhile - peek again
+            if (oldest.l->try_pop(popped_items[count])) {
+                count++;
+            }
+            if (oldest.l->peek(oldest.stamp)) {
+                std::push_heap(heads_.begin(), heads_.end(), later);
+            } else {
+                heads_.pop_back();
+            }
+        }
+        if (count > 0) {
+            stats_.update_high_water_mark(queued);
+        }
+        if (release_lanes_) {
+            refresh_consumer_lanes_();
+        }
+        return count;
+    }
+
+    size_t try_pop_bulk_spin_(T *popped_items, size_t max_items) {
+        for (int i = 0; i < spin_count; i++) {
+            size_t count = try_pop_bulk_(popped_items, max_items);
+            if (count > 0) {
+                return count;
+            }
+            std::this_thread::yield();
+        }
+        return 0;
+    }
+
+    // take a fresh copy of the lanes list if producers registered new lanes, or if the last
+    // scan found drained lanes whose thread has exited. those are released here.
+    // must be called with consumer_mutex_ held.
+    void refresh_consumer_lanes_() {
+        auto version = lanes_version_.load(std::memory_order_acquire);
+        if (version == consumer_lanes_version_ && !release_lanes_) {
+            return;
+        }
+        release_lanes_ = false;
+        std::lock_guard<std::mutex> lock(lanes_mutex_);
+        // drop the consumer's copies first, so a lane no thread holds is left with a count of 1
+        consumer_lanes_.clear();
+        for (auto it = lanes_.begin(); it != lanes_.end();) {
+            if (it->use_count() == 1 && (*it)->size() == 0) {
+                it = lanes_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        consumer_lanes_ = lanes_;
+        consumer_lanes_version_ = lanes_version_.load(std::memory_order_relaxed);
+    }
+
+    // see mpmc_lockfree_queue::notify_consumers_()
+    void notify_consumers_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_consumers_.load(std::memory_order_relaxed) > 0) {
+            { std::lock_guard<std::mutex> lock(park_mutex_); }
+            push_cv_.notify_one();
+        }
+    }
+
+    // all parked producers are woken up since they wait on different lanes
+    void notify_producers_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_producers_.load(std::memory_order_relaxed) > 0) {
+            { std::lock_guard<std::mutex> lock(park_mutex_); }
+            pop_cv_.notify_all();
+        }
+    }
+
+    const size_t id_;
+    const size_t lane_capacity_;
+
+    // all registered lanes. written by producers on registration.
+    std::mutex lanes_mutex_;
+    std::vector<lane_ptr> lanes_;
+    std::atomic<size_t> lanes_version_{0};
+
+    // consumer side copy of lanes_
+    std::mutex consumer_mutex_;
+    std::vector<lane_ptr> consumer_lanes_;
+    struct lane_head {
+        std::int64_t stamp;
+        lane *l;
+    };
+    std::vector<lane_head> heads_;  // merge heap of try_pop_bulk_()
+    size_t consumer_lanes_version_ = 0;
+    bool release_lanes_ = false;  // the last scan found a drained lane of an exited thread
+
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<size_t> discard_counter_{0};
+    queue_stats stats_;
+
+    std::mutex park_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    std::atomic<int> parked_consumers_{0};
+    std::atomic<int> parked_producers_{0};
+};
+}  // namespace details
+}  // namespace spdlog
@@ -7,31 +7,101 @@
     #include <spdlog/details/thread_pool.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <string>
 #include <spdlog/common.h>
 
 namespace spdlog {
 namespace details {
 
-SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items,
-                                       size_t threads_n,
-                                       std::function<void()> on_thread_start,
-                                       std::function<void()> on_thread_stop)
-    : q_(q_max_items) {
-    if (threads_n == 0 || threads_n > 1000) {
+SPDLOG_INLINE void async_msg::report_drop() SPDLOG_NOEXCEPT {
+    if (worker_ptr == nullptr) {
+        return;
+    }
+    if (msg_type == async_msg_type::log) {
+        report_drop(worker_ptr);
+    } else if (msg_type == async_msg_type::flush && flush_seq != 0) {
+        worker_ptr->backend_drop_flush_(flush_seq);
+    }
+    processed();
+}
+
+SPDLOG_INLINE void async_msg::report_drop(async_logger *worker) SPDLOG_NOEXCEPT {
+    worker->backend_count_drop_();
+}
+
+SPDLOG_INLINE thread_pool::thread_pool(const thread_pool_options &options)
+    : queue_budget_(options.q_max_bytes, &memory_budget::global()),
+      priority_level_(options.priority_level),
+      max_batch_size_(options.max_batch_size > 0 ? options.max_batch_size : 1),
+      wait_strategy_(options.wait_strategy),
+      spin_count_(options.spin_count),
+      shutdown_timeout_(options.shutdown_timeout) {
+    if (options.threads_n == 0 || options.threads_n > 1000) {
         throw_spdlog_ex(
             "spdlog::thread_pool(): invalid threads_n param (valid "
             "range is 1-1000)");
     }
-    for (size_t i = 0; i < threads_n; i++) {
-        threads_.emplace_back([this, on_thread_start, on_thread_stop] {
-            on_thread_start();
-            this->thread_pool::worker_loop_();
-            on_thread_stop();
+    size_t shards_n = options.sharded ? options.threads_n : 1;
+    for (size_t i = 0; i < shards_n; i++) {
+        // numa_local_queue: created later by the pool threads
+        queues_.push_back(options.numa_local_queue ? nullptr : make_queue_(options));
+        held_controls_.push_back(details::make_unique<held_controls>());
+        if (priority_level_ != level::off) {
+            priority_lanes_.push_back(
+                details::make_unique<priority_lane>(options.priority_q_max_items));
+        }
+    }
+    worker_epochs_.reset(new worker_epoch[options.threads_n]);
+    worker_stats_.reset(new worker_stats[options.threads_n]());
+    auto startup = std::make_shared<thread_startup>();
+    for (size_t i = 0; i < options.threads_n; i++) {
+        threads_.emplace_back([this, i, options, startup] {
+            auto error = this->setup_thread_(options, i);
+            {
+                std::unique_lock<std::mutex> lock(startup->mutex);
+                if (!error.empty() && startup->error.empty()) {
+                    startup->error = error;
+                }
+                startup->ready++;
+                startup->cv.notify_all();
+                startup->cv.wait(lock, [&] { return startup->go; });
+                if (!startup->error.empty()) {
+                    return;
+                }
+            }
+            options.on_thread_start();
+            this->thread_pool::worker_loop_(i);
+            options.on_thread_stop();
         });
     }
+
+    std::unique_lock<std::mutex> lock(startup->mutex);
+    startup->cv.wait(lock, [&] { return startup->ready == threads_.size(); });
+    startup->go = true;
+    startup->cv.notify_all();
+    if (!startup->error.empty()) {
+        lock.unlock();
+        for (auto &t : threads_) {
+            t.join();
+        }
+        throw_spdlog_ex(startup->error);
+    }
 }
 
+SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items,
+                                       size_t threads_n,
+                                       std::function<void()> on_thread_start,
+                                       std::function<void()> on_thread_stop,
+                                       async_queue_type queue_type)
+    : thread_pool(make_options_(q_max_items,
+                                threads_n,
+                                std::move(on_thread_start),
+                                std::move(on_thread_stop),
+                                queue_type)) {}
+
 SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items,
                                        size_t threads_n,
                                        std::function<void()> on_thread_start)
@@ -41,91 +111,852 @@ SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items, size_t threads_n)
     : thread_pool(
           q_max_items, threads_n, [] {}, [] {}) {}
 
-// message all threads to terminate gracefully join them
+SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items,
+                                       size_t threads_n,
+                                       async_queue_type queue_type)
+    : thread_pool(
+          q_max_items, threads_n, [] {}, [] {}, queue_type) {}
+
+SPDLOG_INLINE thread_pool_options
+thread_pool::make_options_(size_t q_max_items,
+                           size_t threads_n,
+                           std::function<void()> on_thread_start,
+                           std::function<void()> on_thread_stop,
+                           async_queue_type queue_type) {
+    thread_pool_options options;
+    options.q_max_items = q_max_items;
+    options.threads_n = threads_n;
+    options.on_thread_start = std::move(on_thread_start);
+    options.on_thread_stop = std::move(on_thread_stop);
+    options.queue_type = queue_type;
+    return options;
+}
+
+SPDLOG_INLINE std::unique_ptr<async_queue> thread_pool::make_queue_(
+    const thread_pool_options &options) {
+    if (options.queue_type == async_queue_type::lock_free) {
+        return details::make_unique<async_queue_impl<lock_free_q_type>>(options.q_max_items);
+    } else if (options.queue_type == async_queue_type::per_thread) {
+#ifdef SPDLOG_NO_TLS
+        throw_spdlog_ex("spdlog::thread_pool(): per_thread queue requires thread local storage");
+#else
+        return details::make_unique<async_queue_impl<per_thread_q_type>>(
+            (std::min)(options.q_max_items, options.lane_max_items));
+#endif
+    } else if (options.queue_type == async_queue_type::byte_ring) {
+        return details::make_unique<byte_ring_async_queue>(options.q_max_items);
+    }
+    return details::make_unique<async_queue_impl<q_type>>(options.q_max_items);
+}
+
 SPDLOG_INLINE thread_pool::~thread_pool() {
     SPDLOG_TRY {
-        for (size_t i = 0; i < threads_.size(); i++) {
-            post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+        revoke_pool_handles_();
+        if (shutdown_timeout_.count() > 0) {
+            shutdown(shutdown_timeout_);
+        } else {
+            shutdown();
         }
+        // destroy what is left in the queues while their loggers are still alive
+        queues_.clear();
+        priority_lanes_.clear();
+    }
+    SPDLOG_CATCH_STD
+}
 
-        for (auto &t : threads_) {
-            t.join();
+SPDLOG_INLINE size_t thread_pool::shutdown(std::chrono::milliseconds timeout) {
+    return shutdown(std::chrono::steady_clock::now() + timeout);
+}
+
+// message all threads to terminate gracefully and join them
+SPDLOG_INLINE size_t thread_pool::shutdown(std::chrono::steady_clock::time_point deadline) {
+    using std::chrono::steady_clock;
+    std::lock_guard<std::mutex> lock(shutdown_mutex_);
+    if (stopped_.exchange(true)) {
+        return 0;
+    }
+    { std::lock_guard<std::mutex> idle_lock(idle_mutex_); }
+    idle_cv_.notify_all();
+    bool has_deadline = deadline != steady_clock::time_point::max();
+    deadline_.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        auto &q = *queues_[i % queues_.size()];
+        async_msg terminate_msg(async_msg_type::terminate);
+        if (!has_deadline) {
+            q.enqueue(std::move(terminate_msg));
+            continue;
         }
+        // a queue still full at the deadline keeps its pool threads busy until they notice the
+        // deadline, so they don't need the terminate message
+        auto now = steady_clock::now();
+        auto timeout = now < deadline
+                           ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now)
+                           : std::chrono::milliseconds::zero();
+        q.enqueue_for(std::move(terminate_msg), timeout);
     }
-    SPDLOG_CATCH_STD
+    for (auto &t : threads_) {
+        t.join();
+    }
+
+    // abandon what the pool threads have left
+    size_t abandoned = abandoned_.load(std::memory_order_relaxed);
+    std::vector<async_msg> msgs(max_batch_size_);
+    auto count_logs = [&](size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (msgs[i].msg_type == async_msg_type::log) {
+                abandoned++;
+            }
+        }
+    };
+    for (auto &q : queues_) {
+        for (size_t count; (count = q->try_dequeue_bulk(msgs.data(), msgs.size())) > 0;) {
+            count_logs(count);
+            q->release(msgs.data(), count);
+        }
+    }
+    for (auto &lane : priority_lanes_) {
+        while (lane->q.dequeue_for(msgs[0], std::chrono::milliseconds(0))) {
+            count_logs(1);
+        }
+    }
+    // the held flush requests are reported as dropped
+    for (auto &controls : held_controls_) {
+        std::vector<async_msg> held;
+        std::lock_guard<std::mutex> lock(controls->mutex);
+        held.swap(controls->msgs);
+        controls->pending.store(0, std::memory_order_relaxed);
+    }
+    return abandoned;
 }
 
-void SPDLOG_INLINE thread_pool::post_log(async_logger_ptr &&worker_ptr,
+void SPDLOG_INLINE thread_pool::post_log(async_logger *worker_ptr,
                                          const details::log_msg &msg,
-                                         async_overflow_policy overflow_policy) {
-    async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
-    post_async_msg_(std::move(async_m), overflow_policy);
+                                         async_overflow_policy overflow_policy,
+                                         deferred_format_fn format_fn) {
+    if (stopped_.load(std::memory_order_relaxed)) {
+        pool_discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        async_msg::report_drop(worker_ptr);
+        return;
+    }
+    if (msg.level >= priority_level_ && !priority_lanes_.empty()) {
+        post_priority_(worker_ptr, msg, format_fn);
+        return;
+    }
+    auto shard = shard_of(*worker_ptr);
+    auto &q = *queues_[shard];
+    memory_charge charge;
+    if (queue_budget_.tracking() &&
+        !charge_(shard, memory_budget::bytes_of(msg), overflow_policy, worker_ptr->block_timeout_,
+                 charge)) {
+        async_msg::report_drop(worker_ptr);
+        return;
+    }
+    q.post_log(worker_ptr, msg, format_fn, std::move(charge), overflow_policy,
+               worker_ptr->block_timeout_);
 }
 
-std::future<void> SPDLOG_INLINE thread_pool::post_flush(async_logger_ptr &&worker_ptr,
-                                                        async_overflow_policy overflow_policy) {
-    std::promise<void> promise;
-    std::future<void> future = promise.get_future();
-    post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush, std::move(promise)),
-                    overflow_policy);
-    return future;
+reserve_status SPDLOG_INLINE thread_pool::reserve_log(async_logger *worker_ptr,
+                                                     const details::log_msg &msg,
+                                                     size_t max_payload,
+                                                     async_overflow_policy overflow_policy,
+                                                     log_reservation &reservation) {
+    if (msg.level >= priority_level_ && !priority_lanes_.empty()) {
+        return reserve_status::unsupported;
+    }
+    auto shard = shard_of(*worker_ptr);
+    auto &q = *queues_[shard];
+    if (!q.can_reserve(msg, max_payload)) {
+        return reserve_status::unsupported;
+    }
+    if (stopped_.load(std::memory_order_relaxed)) {
+        pool_discard_counter_.fetch_add(1, std::memory_order_relaxed);
+        async_msg::report_drop(worker_ptr);
+        return reserve_status::dropped;
+    }
+    memory_charge charge;
+    if (queue_budget_.tracking() &&
+        !charge_(shard, msg.logger_name.size() + msg.mdc().data_size() + max_payload,
+                 overflow_policy, worker_ptr->block_timeout_, charge)) {
+        async_msg::report_drop(worker_ptr);
+        return reserve_status::dropped;
+    }
+    return q.reserve_log(worker_ptr, msg, max_payload, std::move(charge), overflow_policy,
+                         worker_ptr->block_timeout_, reservation);
 }
 
-size_t SPDLOG_INLINE thread_pool::overrun_counter() { return q_.overrun_counter(); }
+bool SPDLOG_INLINE thread_pool::charge_(size_t shard,
+                                        size_t bytes,
+                                        async_overflow_policy overflow_policy,
+                                        std::chrono::milliseconds block_timeout,
+                                        memory_charge &charge) {
+    if (charge.try_add(queue_budget_, bytes)) {
+        return true;
+    }
+    auto &q = *queues_[shard];
+    auto start = queue_stats::clock::now();
+    bool held = false;  // a control message was taken out of the queue
+    bool blocking = overflow_policy == async_overflow_policy::block ||
+                    overflow_policy == async_overflow_policy::block_with_timeout;
+    while (!charge.try_add(queue_budget_, bytes)) {
+        if (overflow_policy == async_overflow_policy::block_with_timeout &&
+            queue_stats::clock::now() - start >= block_timeout) {
+            budget_stats_.add_blocked_since(start);
+            pool_discard_counter_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (blocking) {
+            // the global budget might be released by others (e.g. other pools) without notice,
+            // so don't wait long without checking
+            std::unique_lock<std::mutex> lock(budget_mutex_);
+            budget_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            budget_cv_.wait_for(lock, std::chrono::milliseconds(1));
+            budget_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+            // drop the oldest message of the queue, which releases its charge
+            async_msg oldest;
+            if (q.try_dequeue_bulk(&oldest, 1) == 0) {
+                // a held control message must not wait for the next message to be served
+                if (held) {
+                    q.enqueue_if_have_room(async_msg(async_msg_type::wakeup));
+                }
+                pool_discard_counter_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (oldest.msg_type != async_msg_type::log) {
+                // a control message has no charge, and must not be lost (its flush waiter or
+                // the pool thread waiting for it). posting it again could block or put it
+                // behind newer messages, so hold it for the pool threads and go on with the
+                // next message.
+                async_msg control(oldest.worker_ptr, oldest.msg_type);
+                control.flush_seq = oldest.flush_seq;
+                oldest.processed();
+                oldest.record.reset();  // the byte ring space
+                auto &controls = *held_controls_[shard];
+                {
+                    std::lock_guard<std::mutex> lock(controls.mutex);
+                    controls.msgs.push_back(std::move(control));
+                    controls.pending.store(controls.msgs.size(), std::memory_order_release);
+                }
+                held = true;
+                continue;
+            }
+            budget_overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            pool_discard_counter_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    if (blocking) {
+        budget_stats_.add_blocked_since(start);
+    }
+    return true;
+}
 
-void SPDLOG_INLINE thread_pool::reset_overrun_counter() { q_.reset_overrun_counter(); }
+void SPDLOG_INLINE thread_pool::post_priority_(async_logger *worker_ptr,
+                                               const details::log_msg &msg,
+                                               deferred_format_fn format_fn) {
+    auto shard = shard_of(*worker_ptr);
+    auto &lane = *priority_lanes_[shard];
+    async_msg async_m(worker_ptr, async_msg_type::log, msg);
+    async_m.format_fn = format_fn;
+    lane.pending.fetch_add(1, std::memory_order_seq_cst);
+    lane.q.enqueue(std::move(async_m));
 
-size_t SPDLOG_INLINE thread_pool::discard_counter() { return q_.discard_counter(); }
+    // a pool thread takes the lane after each dequeue from the queue. if the queue is not
+    // empty, such a dequeue is yet to happen. otherwise the pool thread might be waiting for
+    // the queue - wake it up.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto &q = *queues_[shard];
+    if (q.size() == 0) {
+        q.post(async_msg(async_msg_type::wakeup), async_overflow_policy::block);
+    }
+}
 
-void SPDLOG_INLINE thread_pool::reset_discard_counter() { q_.reset_discard_counter(); }
+void SPDLOG_INLINE thread_pool::post_flush(async_logger *worker_ptr,
+                                           size_t flush_seq,
+                                           async_overflow_policy overflow_policy) {
+    async_msg flush_msg(worker_ptr, async_msg_type::flush);
+    flush_msg.flush_seq = flush_seq;
+    if (stopped_.load(std::memory_order_relaxed)) {
+        return;  // reported as dropped
+    }
+    queue_of_(worker_ptr).post(std::move(flush_msg), overflow_policy, worker_ptr->block_timeout_);
+}
 
-size_t SPDLOG_INLINE thread_pool::queue_size() { return q_.size(); }
+void SPDLOG_INLINE thread_pool::register_logger(async_logger_ptr logger) {
+    std::lock_guard<std::mutex> lock(loggers_mutex_);
+    auto *raw_ptr = logger.get();
+    loggers_.emplace(raw_ptr, std::move(logger));
+    raw_ptr->registered_pool_.value.store(this, std::memory_order_release);
+    if (held_loggers_.fetch_add(1, std::memory_order_relaxed) == 0) {
+        // wake up the idle pool threads before the logger's first message is posted
+        { std::lock_guard<std::mutex> idle_lock(idle_mutex_); }
+        idle_cv_.notify_all();
+    }
+}
 
-void SPDLOG_INLINE thread_pool::post_async_msg_(async_msg &&new_msg,
-                                                async_overflow_policy overflow_policy) {
-    if (overflow_policy == async_overflow_policy::block) {
-        q_.enqueue(std::move(new_msg));
-    } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
-        q_.enqueue_nowait(std::move(new_msg));
-    } else {
-        assert(overflow_policy == async_overflow_policy::discard_new);
-        q_.enqueue_if_have_room(std::move(new_msg));
+void SPDLOG_INLINE thread_pool::register_producer() {
+#ifndef SPDLOG_NO_TLS
+    auto &local_epochs = local_producer_epochs_();
+    for (auto &entry : local_epochs) {
+        if (entry.first == this && !entry.second->detached.load(std::memory_order_relaxed)) {
+            return;
+        }
     }
+    // forget the epochs of destroyed pools (one of them might have had the same address)
+    local_epochs.erase(std::remove_if(local_epochs.begin(), local_epochs.end(),
+                                      [](const producer_epochs::value_type &entry) {
+                                          return entry.second->detached.load(
+                                              std::memory_order_relaxed);
+                                      }),
+                       local_epochs.end());
+    auto epoch = std::make_shared<producer_epoch>();
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        // forget the epochs of exited threads
+        producer_epochs_.erase(std::remove_if(producer_epochs_.begin(), producer_epochs_.end(),
+                                              [](const std::shared_ptr<producer_epoch> &e) {
+                                                  return e.use_count() == 1;
+                                              }),
+                               producer_epochs_.end());
+        producer_epochs_.push_back(epoch);
+    }
+    local_epochs.emplace_back(this, std::move(epoch));
+#endif
 }
 
-void SPDLOG_INLINE thread_pool::worker_loop_() {
-    while (process_next_msg_()) {
+SPDLOG_INLINE thread_pool::producer_scope::producer_scope(const async_logger &logger) {
+#ifndef SPDLOG_NO_TLS
+    auto *pool = logger.registered_pool_.value.load(std::memory_order_acquire);
+    if (pool == nullptr) {
+        return;
     }
+    std::atomic<size_t> *epoch = nullptr;
+    for (auto &entry : local_producer_epochs_()) {
+        if (entry.first == pool) {
+            if (!entry.second->detached.load(std::memory_order_relaxed)) {
+                epoch = &entry.second->value;
+            }
+            break;
+        }
+    }
+    if (epoch == nullptr) {
+        return;
+    }
+    auto value = epoch->load(std::memory_order_relaxed);
+    if (value % 2 == 1) {
+        // nested in another scope of this thread (e.g. an arg formatted in place logs), which
+        // already keeps the pool from being destroyed
+        pool_ = pool;
+        return;
+    }
+    // the fence orders the odd epoch before reading the handle again, so either this thread sees
+    // the handle revoked, or the pool destructor sees this thread in the scope
+    epoch->store(value + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    epoch_ = epoch;
+    if (logger.registered_pool_.value.load(std::memory_order_relaxed) == pool) {
+        pool_ = pool;
+    }
+#else
+    (void)logger;
+#endif
+}
+
+SPDLOG_INLINE thread_pool::producer_scope::~producer_scope() {
+    if (epoch_ != nullptr) {
+        epoch_->store(epoch_->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+}
+
+size_t SPDLOG_INLINE thread_pool::overrun_counter() {
+    size_t total = budget_overrun_counter_.load(std::memory_order_relaxed);
+    for (auto &q : queues_) {
+        total += q->overrun_counter();
+    }
+    return total;
+}
+
+void SPDLOG_INLINE thread_pool::reset_overrun_counter() {
+    budget_overrun_counter_.store(0, std::memory_order_relaxed);
+    for (auto &q : queues_) {
+        q->reset_overrun_counter();
+    }
+}
+
+size_t SPDLOG_INLINE thread_pool::discard_counter() {
+    size_t total = pool_discard_counter_.load(std::memory_order_relaxed);
+    for (auto &q : queues_) {
+        total += q->discard_counter();
+    }
+    return total;
+}
+
+void SPDLOG_INLINE thread_pool::reset_discard_counter() {
+    pool_discard_counter_.store(0, std::memory_order_relaxed);
+    for (auto &q : queues_) {
+        q->reset_discard_counter();
+    }
+}
+
+size_t SPDLOG_INLINE thread_pool::queue_size() {
+    size_t total = 0;
+    for (size_t shard = 0; shard < queues_.size(); shard++) {
+        total += queue_size(shard);
+    }
+    return total;
 }
 
-// process next message in the queue
+size_t SPDLOG_INLINE thread_pool::shards_n() const { return queues_.size(); }
+
+size_t SPDLOG_INLINE thread_pool::queue_size(size_t shard) {
+    if (shard >= queues_.size()) {
+        throw_spdlog_ex("thread_pool::queue_size(): invalid shard " + std::to_string(shard));
+    }
+    size_t size = queues_[shard]->size();
+    if (!priority_lanes_.empty()) {
+        size += priority_lanes_[shard]->pending.load(std::memory_order_acquire);
+    }
+    return size;
+}
+
+size_t SPDLOG_INLINE thread_pool::shard_of(const async_logger &logger) const {
+    return logger.shard() % queues_.size();
+}
+
+size_t SPDLOG_INLINE thread_pool::memory_usage() const { return queue_budget_.usage(); }
+
+SPDLOG_INLINE thread_pool_stats thread_pool::stats() {
+    thread_pool_stats result;
+    result.blocked_time = budget_stats_.blocked_time();
+    for (auto &q : queues_) {
+        result.high_water_mark = (std::max)(result.high_water_mark, q->stats().high_water_mark());
+        result.blocked_time += q->stats().blocked_time();
+    }
+    for (auto &lane : priority_lanes_) {
+        result.blocked_time += lane->q.stats().blocked_time();
+    }
+    for (size_t i = 0; i < threads_.size(); i++) {
+        auto &histogram = worker_stats_[i].latency_histogram;
+        for (size_t bucket = 0; bucket < result.latency_histogram.size(); bucket++) {
+            result.latency_histogram[bucket] += histogram[bucket].load(std::memory_order_relaxed);
+        }
+    }
+    result.overrun_counter = overrun_counter();
+    result.discard_counter = discard_counter();
+    return result;
+}
+
+void SPDLOG_INLINE thread_pool::reset_stats() {
+    budget_stats_.reset();
+    for (auto &q : queues_) {
+        q->stats().reset();
+    }
+    for (auto &lane : priority_lanes_) {
+        lane->q.stats().reset();
+    }
+    for (size_t i = 0; i < threads_.size(); i++) {
+        for (auto &bucket : worker_stats_[i].latency_histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+    reset_overrun_counter();
+    reset_discard_counter();
+}
+
+SPDLOG_INLINE async_queue &thread_pool::queue_of_(const async_logger *worker_ptr) {
+    return *queues_[shard_of(*worker_ptr)];
+}
+
+SPDLOG_INLINE std::string thread_pool::setup_thread_(const thread_pool_options &options,
+                                                     size_t index) {
+    if (!options.cpu_affinity.empty() && !os::set_thread_affinity(options.cpu_affinity)) {
+        return spdlog_ex("thread_pool: failed setting the cpu affinity", errno).what();
+    }
+    if (options.realtime_priority > 0 && !os::set_thread_realtime(options.realtime_priority)) {
+        return spdlog_ex("thread_pool: failed setting the real time priority", errno).what();
+    }
+    if (options.nice != 0 && !os::set_thread_nice(options.nice)) {
+        return spdlog_ex("thread_pool: failed setting the nice value", errno).what();
+    }
+    if (!options.thread_name.empty()) {
+        auto name = options.thread_name;
+        if (options.threads_n > 1) {
+            name += std::to_string(index);
+        }
+        if (!os::set_thread_name(name)) {
+            return spdlog_ex("thread_pool: failed setting the thread name", errno).what();
+        }
+    }
+    // the first touch of the queue memory is by this thread
+    if (options.numa_local_queue && index < queues_.size()) {
+        SPDLOG_TRY { queues_[index] = make_queue_(options); }
+#ifndef SPDLOG_NO_EXCEPTIONS
+        catch (const std::exception &ex) {
+            return ex.what();
+        }
+#endif
+    }
+    return std::string();
+}
+
+void SPDLOG_INLINE thread_pool::worker_loop_(size_t index) {
+    using std::chrono::steady_clock;
+    const auto release_interval = std::chrono::milliseconds(100);
+    auto shard = index % queues_.size();
+    auto &epoch = worker_epochs_[index].value;
+    auto &stats = worker_stats_[index];
+    auto next_release = steady_clock::now() + release_interval;
+    batch_buffers buffers;
+    buffers.msgs.resize(max_batch_size_);
+    if (!priority_lanes_.empty()) {
+        buffers.priority_msgs.resize(max_batch_size_);
+    }
+    for (;;) {
+        // a thread waiting for loggers takes no messages, so its epoch stays even
+        if (held_loggers_.load(std::memory_order_relaxed) == 0) {
+            wait_for_loggers_();
+            next_release = steady_clock::now() + release_interval;
+        }
+        // the fence orders the odd epoch before taking messages from the queue, so a thread that
+        // found the queue empty will see this thread as busy (see release_unused_loggers_())
+        epoch.store(epoch.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // an idle thread wakes up for the next release, so loggers dropped while no messages
+        // are logged are still released
+        auto now = steady_clock::now();
+        auto max_wait = std::chrono::milliseconds(0);
+        if (next_release > now) {
+            max_wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_release - now) +
+                       std::chrono::milliseconds(1);
+        }
+        bool active = process_next_batch_(shard, buffers, stats, max_wait);
+        epoch.store(epoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        if (!active) {
+            break;
+        }
+        now = steady_clock::now();
+        if (now >= next_release) {
+            if (held_loggers_.load(std::memory_order_relaxed) > 0) {
+                release_unused_loggers_();
+            }
+            next_release = now + release_interval;
+        }
+    }
+}
+
+SPDLOG_INLINE bool thread_pool::deadline_passed_() const {
+    auto deadline = deadline_.load(std::memory_order_relaxed);
+    return deadline != (std::numeric_limits<std::chrono::steady_clock::rep>::max)() &&
+           std::chrono::steady_clock::now().time_since_epoch().count() >= deadline;
+}
+
+void SPDLOG_INLINE thread_pool::wait_for_loggers_() {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.wait(lock, [this] {
+        return held_loggers_.load(std::memory_order_relaxed) > 0 ||
+               stopped_.load(std::memory_order_relaxed);
+    });
+}
+
+// A logger referenced only by the pool can't get new messages. Its messages still in the pool
+// were either in the queues, or taken by some pool thread. So it can be released after the queues
+// were found empty, once every pool thread that was busy at that point has finished its batch.
+void SPDLOG_INLINE thread_pool::release_unused_loggers_() {
+    std::vector<async_logger_ptr> released;
+    {
+        std::lock_guard<std::mutex> lock(loggers_mutex_);
+        if (!draining_loggers_.empty()) {
+            bool drained = true;
+            for (size_t i = 0; i < threads_.size(); i++) {
+                auto snapshot = draining_epochs_[i];
+                if (snapshot % 2 == 1 &&
+                    worker_epochs_[i].value.load(std::memory_order_acquire) == snapshot) {
+                    drained = false;
+                    break;
+                }
+            }
+            if (drained) {
+                released.swap(draining_loggers_);
+            }
+        }
+
+        for (auto it = loggers_.begin(); it != loggers_.end();) {
+            if (it->second.use_count() == 1) {
+                it->first->registered_pool_.value.store(nullptr, std::memory_order_relaxed);
+                unused_loggers_.push_back(std::move(it->second));
+                it = loggers_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (draining_loggers_.empty() && !unused_loggers_.empty()) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (queue_size() == 0) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                draining_epochs_.resize(threads_.size());
+                for (size_t i = 0; i < threads_.size(); i++) {
+                    draining_epochs_[i] = worker_epochs_[i].value.load(std::memory_order_acquire);
+                }
+                draining_loggers_.swap(unused_loggers_);
+            }
+        }
+        held_loggers_.store(loggers_.size() + unused_loggers_.size() + draining_loggers_.size(),
+                            std::memory_order_relaxed);
+    }
+    // destroy the loggers outside the lock, their sinks might log
+}
+
+SPDLOG_INLINE thread_pool::producer_epochs &thread_pool::local_producer_epochs_() {
+#ifndef SPDLOG_NO_TLS
+    thread_local producer_epochs local_epochs;
+#else
+    static producer_epochs local_epochs;  // unused - producers always lock the weak_ptr
+#endif
+    return local_epochs;
+}
+
+// Same scheme as release_unused_loggers_(): a producer that found the handle still set was in
+// its scope, with an odd epoch, before the handle was revoked. So once every epoch that was odd
+// has changed, no producer uses the pool through a handle anymore.
+void SPDLOG_INLINE thread_pool::revoke_pool_handles_() {
+    {
+        std::lock_guard<std::mutex> lock(loggers_mutex_);
+        for (auto &entry : loggers_) {
+            entry.first->registered_pool_.value.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(producers_mutex_);
+    for (auto &epoch : producer_epochs_) {
+        auto snapshot = epoch->value.load(std::memory_order_acquire);
+        while (snapshot % 2 == 1 && epoch->value.load(std::memory_order_acquire) == snapshot) {
+            std::this_thread::yield();
+        }
+        epoch->detached.store(true, std::memory_order_relaxed);
+    }
+}
+
+// process next batch of messages in the queue
 // return true if this thread should still be active (while no terminate msg
 // was received)
-bool SPDLOG_INLINE thread_pool::process_next_msg_() {
-    async_msg incoming_async_msg;
-    q_.dequeue(incoming_async_msg);
+bool SPDLOG_INLINE thread_pool::process_next_batch_(size_t shard,
+                                                    batch_buffers &buffers,
+                                                    worker_stats &stats,
+                                                    std::chrono::milliseconds max_wait) {
+    auto &q = *queues_[shard];
+    auto *msgs = buffers.msgs.data();
+    size_t count = dequeue_bulk_(q, msgs, buffers.msgs.size(), max_wait);
+    record_latency_(msgs, count, stats);
+
+    // serve the priority lane first. it is taken after the queue, so a flush request in the
+    // batch is served after the priority messages its logger posted before it.
+    if (!priority_lanes_.empty()) {
+        auto &lane = *priority_lanes_[shard];
+        auto *priority_msgs = buffers.priority_msgs.data();
+        size_t priority_count = 0;
+        while (priority_count < buffers.priority_msgs.size() &&
+               lane.pending.load(std::memory_order_acquire) > 0 &&
+               lane.q.dequeue_for(priority_msgs[priority_count], std::chrono::milliseconds(0))) {
+            lane.pending.fetch_sub(1, std::memory_order_release);
+            priority_count++;
+        }
+        record_latency_(priority_msgs, priority_count, stats);
+        process_msgs_(priority_msgs, priority_count, buffers);
+    }
+
+    size_t terminate_count = process_msgs_(msgs, count, buffers);
+    // before reposting terminate messages, which might wait for the space
+    q.release(msgs, count);
+    // after the batch, which may hold messages posted before them
+    terminate_count += process_held_controls_(shard, buffers);
+
+    // wake up the producers waiting for the queue budget the batch has released
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (budget_waiters_.load(std::memory_order_relaxed) > 0) {
+        { std::lock_guard<std::mutex> lock(budget_mutex_); }
+        budget_cv_.notify_all();
+    }
+
+    if (deadline_passed_()) {
+        return false;
+    }
+    // each thread should get its own terminate message - pass on the extra ones
+    for (size_t i = 1; i < terminate_count; i++) {
+        q.post(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+    }
+    return terminate_count == 0;
+}
+
+size_t SPDLOG_INLINE thread_pool::process_held_controls_(size_t shard, batch_buffers &buffers) {
+    auto &controls = *held_controls_[shard];
+    if (controls.pending.load(std::memory_order_acquire) == 0) {
+        return 0;
+    }
+    std::vector<async_msg> msgs;
+    {
+        std::lock_guard<std::mutex> lock(controls.mutex);
+        msgs.swap(controls.msgs);
+        controls.pending.store(0, std::memory_order_relaxed);
+    }
+    return process_msgs_(msgs.data(), msgs.size(), buffers);
+}
 
-    switch (incoming_async_msg.msg_type) {
-        case async_msg_type::log: {
-            incoming_async_msg.worker_ptr->backend_sink_it_(incoming_async_msg);
-            return true;
+size_t SPDLOG_INLINE thread_pool::dequeue_bulk_(async_queue &q,
+                                                async_msg *msgs,
+                                                size_t max_items,
+                                                std::chrono::milliseconds max_wait) {
+    if (wait_strategy_ == async_wait_strategy::blocking) {
+        return q.dequeue_bulk_for(msgs, max_items, max_wait);
+    }
+    auto deadline = std::chrono::steady_clock::now() + max_wait;
+    for (size_t polls = 0;; polls++) {
+        size_t count = q.try_dequeue_bulk(msgs, max_items);
+        if (count > 0) {
+            return count;
         }
-        case async_msg_type::flush: {
-            incoming_async_msg.worker_ptr->backend_flush_();
-            incoming_async_msg.flush_promise.set_value();
-            return true;
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return 0;
         }
+        if (wait_strategy_ == async_wait_strategy::busy_spin || polls < spin_count_) {
+            continue;
+        }
+        if (wait_strategy_ == async_wait_strategy::spin_yield) {
+            std::this_thread::yield();
+        } else {
+            // spin_park
+            return q.dequeue_bulk_for(
+                msgs, max_items,
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) +
+                    std::chrono::milliseconds(1));
+        }
+    }
+}
 
-        case async_msg_type::terminate: {
-            return false;
+void SPDLOG_INLINE thread_pool::record_latency_(const async_msg *msgs,
+                                               size_t count,
+                                               worker_stats &stats) {
+    if (count == 0) {
+        return;
+    }
+    auto now = log_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        if (msgs[i].msg_type != async_msg_type::log) {
+            continue;
+        }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - msgs[i].time).count();
+        size_t bucket = 0;
+        while (us > 0 && bucket + 1 < thread_pool_stats::latency_buckets) {
+            us >>= 1;
+            bucket++;
+        }
+        stats.latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t SPDLOG_INLINE thread_pool::process_msgs_(async_msg *msgs,
+                                                size_t count,
+                                                batch_buffers &buffers) {
+    size_t terminate_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        auto &incoming_async_msg = msgs[i];
+        switch (incoming_async_msg.msg_type) {
+            case async_msg_type::log: {
+                // consecutive log messages of the same logger are passed together
+                size_t run_end = i + 1;
+                while (run_end < count && msgs[run_end].msg_type == async_msg_type::log &&
+                       msgs[run_end].worker_ptr == incoming_async_msg.worker_ptr) {
+                    run_end++;
+                }
+                if (deadline_passed_()) {
+                    // abandoned - reported as dropped when the message is destroyed
+                    abandoned_.fetch_add(run_end - i, std::memory_order_relaxed);
+                } else {
+                    sink_batch_(msgs + i, run_end - i, buffers);
+                }
+                i = run_end - 1;
+                break;
+            }
+            case async_msg_type::flush: {
+                if (deadline_passed_()) {
+                    break;  // the request is reported as dropped
+                }
+                // several flush requests of the same logger in a batch are served by the last one.
+                // the earlier ones keep their numbers until then, so if the deadline passes
+                // first, each of them is reported as dropped.
+                auto *worker = incoming_async_msg.worker_ptr;
+                auto same_flush = [worker](const async_msg &m) {
+                    return m.msg_type == async_msg_type::flush && m.worker_ptr == worker &&
+                           m.flush_seq != 0;
+                };
+                if (std::any_of(msgs + i + 1, msgs + count, same_flush)) {
+                    break;
+                }
+                size_t flush_seq = incoming_async_msg.flush_seq;
+                for (size_t j = 0; j < i; j++) {
+                    if (same_flush(msgs[j])) {
+                        flush_seq = std::max(flush_seq, msgs[j].flush_seq);
+                    }
+                }
+                worker->backend_complete_flush_(flush_seq);
+                for (size_t j = 0; j <= i; j++) {
+                    if (same_flush(msgs[j])) {
+                        msgs[j].flush_seq = 0;
+                    }
+                }
+                break;
+            }
+
+            case async_msg_type::terminate: {
+                terminate_count++;
+                break;
+            }
+
+            case async_msg_type::wakeup: {
+                break;
+            }
+
+            default: {
+                assert(false);
+            }
         }
+    }
+    return terminate_count;
+}
 
-        default: {
-            assert(false);
+void SPDLOG_INLINE thread_pool::sink_batch_(async_msg *msgs,
+                                            size_t count,
+                                            batch_buffers &buffers) {
+    auto *worker = msgs[0].worker_ptr;
+    auto &log_msgs = buffers.log_msgs;
+    log_msgs.clear();
+    if (buffers.payloads.size() < count) {
+        buffers.payloads.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (msgs[i].format_fn == nullptr) {
+            log_msgs.push_back(msgs[i]);
+            continue;
+        }
+        auto &payload = buffers.payloads[i];
+        payload.clear();
+        if (worker->backend_format_deferred_(msgs[i], msgs[i].format_fn, payload)) {
+            log_msgs.push_back(msgs[i]);
+            log_msgs.back().payload = string_view_t(payload.data(), payload.size());
         }
     }
+    worker->backend_sink_batch_(log_msgs.data(), log_msgs.size());
 
-    return true;
+    // release the queue budget now, not when the buffers are reused by the next batch.
+    // a flush request later in the batch will find the budget released.
+    for (size_t i = 0; i < count; i++) {
+        msgs[i].charge.reset();
+        msgs[i].processed();
+    }
 }
 
 }  // namespace details
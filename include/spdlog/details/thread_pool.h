@@ -3,15 +3,28 @@
 
 #pragma once
 
+#include <spdlog/details/byte_ring_q.h>
+#include <spdlog/details/deferred_format.h>
 #include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/details/memory_budget.h>
 #include <spdlog/details/mpmc_blocking_q.h>
+#include <spdlog/details/mpmc_lockfree_q.h>
+#include <spdlog/details/spsc_lanes_q.h>
 #include <spdlog/details/os.h>
+#include <spdlog/details/queue_stats.h>
 
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <future>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace spdlog {
@@ -21,105 +34,640 @@ namespace details {
 
 using async_logger_ptr = std::shared_ptr<spdlog::async_logger>;
 
-enum class async_msg_type { log, flush, terminate };
+// wakeup: no-op, wakes a pool thread waiting for the queue to serve the priority lane
+enum class async_msg_type { log, flush, terminate, wakeup };
 
 // Async msg to move to/from the queue
 // Movable only. should never be copied
 struct async_msg : log_msg_buffer {
     async_msg_type msg_type{async_msg_type::log};
-    async_logger_ptr worker_ptr;
-    std::promise<void> flush_promise;
+    // plain pointer - the pool keeps the logger alive (see thread_pool::register_logger())
+    async_logger *worker_ptr{nullptr};
+    // flush messages: the flush request number (see async_logger::flush_())
+    size_t flush_seq{0};
+    // if set, the payload holds the packed format string and args, to be formatted by the pool
+    deferred_format_fn format_fn{nullptr};
+    // the message bytes charged to the pool's queue budget (see thread_pool_options::q_max_bytes)
+    memory_charge charge;
+    // the byte ring record the message refers to (see byte_ring_queue)
+    ring_record record;
 
     async_msg() = default;
-    ~async_msg() = default;
+    // a message destroyed before it was processed (e.g. overrun) is reported to its logger
+    ~async_msg() { report_drop(); }
 
     // should only be moved in or out of the queue..
     async_msg(const async_msg &) = delete;
 
-// support for vs2013 move
-#if defined(_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&other)
-        : log_msg_buffer(std::move(other)),
-          msg_type(other.msg_type),
-          worker_ptr(std::move(other.worker_ptr)) {}
-
-    async_msg &operator=(async_msg &&other) {
-        *static_cast<log_msg_buffer *>(this) = std::move(other);
-        msg_type = other.msg_type;
-        worker_ptr = std::move(other.worker_ptr);
+    // the moved from message is left without a logger, so it's not reported as dropped
+    async_msg(async_msg &&other) SPDLOG_NOEXCEPT : log_msg_buffer(std::move(other)),
+                                                   msg_type(other.msg_type),
+                                                   worker_ptr(other.worker_ptr),
+                                                   flush_seq(other.flush_seq),
+                                                   format_fn(other.format_fn),
+                                                   charge(std::move(other.charge)),
+                                                   record(std::move(other.record)) {
+        other.worker_ptr = nullptr;
+        other.flush_seq = 0;
+    }
+
+    async_msg &operator=(async_msg &&other) SPDLOG_NOEXCEPT {
+        if (this != &other) {
+            report_drop();
+            *static_cast<log_msg_buffer *>(this) = std::move(other);
+            msg_type = other.msg_type;
+            worker_ptr = other.worker_ptr;
+            flush_seq = other.flush_seq;
+            format_fn = other.format_fn;
+            charge = std::move(other.charge);
+            record = std::move(other.record);
+            other.worker_ptr = nullptr;
+            other.flush_seq = 0;
+        }
         return *this;
     }
-#else  // (_MSC_VER) && _MSC_VER <= 1800
-    async_msg(async_msg &&) = default;
-    async_msg &operator=(async_msg &&) = default;
-#endif
 
     // construct from log_msg with given type
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type, const details::log_msg &m)
+    async_msg(async_logger *worker, async_msg_type the_type, const details::log_msg &m)
         : log_msg_buffer{m},
           msg_type{the_type},
-          worker_ptr{std::move(worker)},
-          flush_promise{} {}
-
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type)
-        : log_msg_buffer{},
-          msg_type{the_type},
-          worker_ptr{std::move(worker)},
-          flush_promise{} {}
+          worker_ptr{worker} {}
 
-    async_msg(async_logger_ptr &&worker,
-              async_msg_type the_type,
-              std::promise<void> &&promise)
+    // control messages are stamped too, so the per thread queue merges them in order
+    async_msg(async_logger *worker, async_msg_type the_type)
         : log_msg_buffer{},
           msg_type{the_type},
-          worker_ptr{std::move(worker)},
-          flush_promise{std::move(promise)} {}
+          worker_ptr{worker} {
+        time = log_clock::now();
+    }
 
     explicit async_msg(async_msg_type the_type)
         : async_msg{nullptr, the_type} {}
+
+    // the message was processed - it's not to be reported as dropped
+    void processed() SPDLOG_NOEXCEPT {
+        worker_ptr = nullptr;
+        flush_seq = 0;
+    }
+
+    // tell the logger its message was dropped (log messages are counted, and the waiter of a
+    // flush request is woken up)
+    void report_drop() SPDLOG_NOEXCEPT;
+
+    // for queues that drop a log message before an async_msg was built for it
+    static void report_drop(async_logger *worker) SPDLOG_NOEXCEPT;
+};
+
+class log_reservation;
+
+enum class reserve_status {
+    reserved,
+    dropped,     // dropped by the overflow policy (and reported to the logger)
+    unsupported  // the queue can't reserve such a record - post the message as usual
+};
+
+// Interface of the queue between the async loggers and the pool threads.
+// Lets the thread pool select the queue implementation at construction time.
+class async_queue {
+public:
+    virtual ~async_queue() = default;
+    virtual void enqueue(async_msg &&item) = 0;
+    virtual bool enqueue_for(async_msg &&item, std::chrono::milliseconds timeout) = 0;
+    virtual void enqueue_nowait(async_msg &&item) = 0;
+    virtual void enqueue_if_have_room(async_msg &&item) = 0;
+    virtual void dequeue(async_msg &popped_item) = 0;
+    virtual size_t dequeue_bulk(async_msg *popped_items, size_t max_items) = 0;
+    virtual size_t dequeue_bulk_for(async_msg *popped_items,
+                                    size_t max_items,
+                                    std::chrono::milliseconds timeout) = 0;
+    virtual size_t try_dequeue_bulk(async_msg *popped_items, size_t max_items) = 0;
+    // release the queue storage the processed messages refer to
+    virtual void release(async_msg * /*items*/, size_t /*count*/) {}
+    virtual size_t overrun_counter() = 0;
+    virtual void reset_overrun_counter() = 0;
+    virtual size_t discard_counter() = 0;
+    virtual void reset_discard_counter() = 0;
+    virtual size_t size() = 0;
+    virtual queue_stats &stats() = 0;
+
+    // queues that can store a log message without building an async_msg override this
+    virtual void post_log(async_logger *worker_ptr,
+                          const log_msg &msg,
+                          deferred_format_fn format_fn,
+                          memory_charge &&charge,
+                          async_overflow_policy overflow_policy,
+                          std::chrono::milliseconds block_timeout) {
+        async_msg async_m(worker_ptr, async_msg_type::log, msg);
+        async_m.format_fn = format_fn;
+        async_m.charge = std::move(charge);
+        post(std::move(async_m), overflow_policy, block_timeout);
+    }
+
+    // queues that can reserve a log record for its payload to be written in place override
+    // these (see log_reservation)
+    virtual reserve_status reserve_log(async_logger * /*worker_ptr*/,
+                                       const log_msg & /*msg*/,
+                                       size_t /*max_payload*/,
+                                       memory_charge && /*charge*/,
+                                       async_overflow_policy /*overflow_policy*/,
+                                       std::chrono::milliseconds /*block_timeout*/,
+                                       log_reservation & /*reservation*/) {
+        return reserve_status::unsupported;
+    }
+    virtual bool can_reserve(const log_msg & /*msg*/, size_t /*max_payload*/) const {
+        return false;
+    }
+    virtual void commit_log(size_t /*pos*/, size_t /*payload_size*/) {}
+    virtual void cancel_log(size_t /*pos*/) {}
+
+    // block_timeout applies to async_overflow_policy::block_with_timeout
+    void post(async_msg &&new_msg,
+              async_overflow_policy overflow_policy,
+              std::chrono::milliseconds block_timeout = std::chrono::milliseconds::zero()) {
+        if (overflow_policy == async_overflow_policy::block) {
+            enqueue(std::move(new_msg));
+        } else if (overflow_policy == async_overflow_policy::block_with_timeout) {
+            enqueue_for(std::move(new_msg), block_timeout);
+        } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+            enqueue_nowait(std::move(new_msg));
+        } else {
+            assert(overflow_policy == async_overflow_policy::discard_new);
+            enqueue_if_have_room(std::move(new_msg));
+        }
+    }
+};
+
+template <typename Q>
+class async_queue_impl : public async_queue {
+public:
+    explicit async_queue_impl(size_t max_items)
+        : q_(max_items) {}
+    void enqueue(async_msg &&item) override { q_.enqueue(std::move(item)); }
+    bool enqueue_for(async_msg &&item, std::chrono::milliseconds timeout) override {
+        return q_.enqueue_for(std::move(item), timeout);
+    }
+    void enqueue_nowait(async_msg &&item) override { q_.enqueue_nowait(std::move(item)); }
+    void enqueue_if_have_room(async_msg &&item) override {
+        q_.enqueue_if_have_room(std::move(item));
+    }
+    void dequeue(async_msg &popped_item) override { q_.dequeue(popped_item); }
+    size_t dequeue_bulk(async_msg *popped_items, size_t max_items) override {
+        return q_.dequeue_bulk(popped_items, max_items);
+    }
+    size_t dequeue_bulk_for(async_msg *popped_items,
+                            size_t max_items,
+                            std::chrono::milliseconds timeout) override {
+        return q_.dequeue_bulk_for(popped_items, max_items, timeout);
+    }
+    size_t try_dequeue_bulk(async_msg *popped_items, size_t max_items) override {
+        return q_.try_dequeue_bulk(popped_items, max_items);
+    }
+    size_t overrun_counter() override { return q_.overrun_counter(); }
+    void reset_overrun_counter() override { q_.reset_overrun_counter(); }
+    size_t discard_counter() override { return q_.discard_counter(); }
+    void reset_discard_counter() override { q_.reset_discard_counter(); }
+    size_t size() override { return q_.size(); }
+    queue_stats &stats() override { return q_.stats(); }
+
+protected:
+    Q q_;
+};
+
+// a log record reserved in the queue by thread_pool::reserve_log(). the payload is written in
+// place to data() (up to capacity() bytes) and published by commit(). a reservation destroyed
+// without being committed is cancelled - the record is skipped by the pool threads.
+// the records posted after it are not processed until then, so commit soon.
+class log_reservation {
+public:
+    log_reservation() = default;
+    ~log_reservation() {
+        if (queue_ != nullptr) {
+            queue_->cancel_log(pos_);
+        }
+    }
+
+    log_reservation(const log_reservation &) = delete;
+    log_reservation &operator=(const log_reservation &) = delete;
+
+    char *data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+
+    void commit(size_t payload_size) {
+        assert(queue_ != nullptr && payload_size <= capacity_);
+        queue_->commit_log(pos_, payload_size);
+        queue_ = nullptr;
+    }
+
+private:
+    friend class byte_ring_async_queue;
+
+    async_queue *queue_ = nullptr;
+    size_t pos_ = 0;
+    char *data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// packs log messages straight into the byte ring
+class byte_ring_async_queue final : public async_queue_impl<byte_ring_queue<async_msg>> {
+public:
+    explicit byte_ring_async_queue(size_t max_bytes)
+        : async_queue_impl(max_bytes) {}
+
+    void post_log(async_logger *worker_ptr,
+                  const log_msg &msg,
+                  deferred_format_fn format_fn,
+                  memory_charge &&charge,
+                  async_overflow_policy overflow_policy,
+                  std::chrono::milliseconds block_timeout) override {
+        bool stored = false;
+        if (overflow_policy == async_overflow_policy::block) {
+            stored = q_.enqueue_log(worker_ptr, msg, format_fn, std::move(charge));
+        } else if (overflow_policy == async_overflow_policy::block_with_timeout) {
+            stored =
+                q_.enqueue_log_for(worker_ptr, msg, format_fn, block_timeout, std::move(charge));
+        } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+            stored = q_.enqueue_log_nowait(worker_ptr, msg, format_fn, std::move(charge));
+        } else {
+            assert(overflow_policy == async_overflow_policy::discard_new);
+            stored = q_.enqueue_log_if_have_room(worker_ptr, msg, format_fn, std::move(charge));
+        }
+        if (!stored) {
+            async_msg::report_drop(worker_ptr);
+        }
+    }
+
+    reserve_status reserve_log(async_logger *worker_ptr,
+                               const log_msg &msg,
+                               size_t max_payload,
+                               memory_charge &&charge,
+                               async_overflow_policy overflow_policy,
+                               std::chrono::milliseconds block_timeout,
+                               log_reservation &reservation) override {
+        using push_mode = byte_ring_queue<async_msg>::push_mode;
+        push_mode mode = push_mode::discard;
+        if (overflow_policy == async_overflow_policy::block) {
+            mode = push_mode::block;
+        } else if (overflow_policy == async_overflow_policy::block_with_timeout) {
+            mode = push_mode::block_for;
+        } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+            mode = push_mode::overrun;
+        }
+        size_t pos = 0;
+        char *data = q_.reserve_log(worker_ptr, msg, max_payload, std::move(charge), mode,
+                                    block_timeout, pos);
+        if (data == nullptr) {
+            async_msg::report_drop(worker_ptr);
+            return reserve_status::dropped;
+        }
+        reservation.queue_ = this;
+        reservation.pos_ = pos;
+        reservation.data_ = data;
+        reservation.capacity_ = max_payload;
+        return reserve_status::reserved;
+    }
+
+    bool can_reserve(const log_msg &msg, size_t max_payload) const override {
+        return q_.fits(msg, max_payload);
+    }
+
+    void release(async_msg *items, size_t count) override { q_.release(items, count); }
+
+    void commit_log(size_t pos, size_t payload_size) override { q_.commit(pos, payload_size); }
+
+    void cancel_log(size_t pos) override { q_.cancel(pos); }
+};
+
+// thread pool settings.
+// the defaults are the same as of thread_pool(q_max_items, threads_n).
+struct thread_pool_options {
+    size_t q_max_items = 8192;  // in bytes with async_queue_type::byte_ring
+    // limit of the total bytes (logger names and payloads) of the queued messages, over all the
+    // shards. the overflow policy applies when it is hit. 0 means no limit.
+    // the queued messages are also charged to the global limit (see spdlog::set_memory_limit()).
+    size_t q_max_bytes = 0;
+    size_t threads_n = 1;
+    std::function<void()> on_thread_start = [] {};
+    std::function<void()> on_thread_stop = [] {};
+    async_queue_type queue_type = async_queue_type::mutex;
+    // capacity of each producer thread's lane with async_queue_type::per_thread, capped by
+    // q_max_items. the lane is allocated on the thread's first log call, so keep it small when
+    // many threads log.
+    size_t lane_max_items = 1024;
+    // max number of messages a pool thread takes from the queue on each wakeup.
+    // consecutive messages of the same logger in a batch are passed to its sinks together.
+    size_t max_batch_size = 64;
+    // give each pool thread its own queue (shard) of q_max_items, and serve each logger by the
+    // thread of its shard (see async_logger::set_shard()). with threads_n > 1 this keeps the
+    // messages of each logger in order, and loggers of different shards don't contend.
+    bool sharded = false;
+    // messages at or above this level go to a separate small priority lane (one per shard),
+    // which the pool threads serve before the queue. the priority lane always blocks when full,
+    // so the overflow policy drops only messages below this level. off disables the lane.
+    level::level_enum priority_level = level::off;
+    size_t priority_q_max_items = 256;
+    // how the pool threads wait for messages, and how many times the spinning strategies poll
+    // the empty queue before they park or start yielding.
+    async_wait_strategy wait_strategy = async_wait_strategy::blocking;
+    size_t spin_count = 10000;
+
+    // settings each pool thread applies to itself when it starts. the constructor throws
+    // spdlog_ex if any of them fails (e.g. missing privileges) or isn't supported by the platform.
+    // cpus the pool threads may run on. empty means no restriction.
+    std::vector<size_t> cpu_affinity;
+    // > 0: run the pool threads under the SCHED_FIFO real time policy with this priority
+    int realtime_priority = 0;
+    // nice value of the pool threads. 0 leaves it unchanged.
+    int nice = 0;
+    // name of the pool threads. the thread index is appended when threads_n > 1.
+    std::string thread_name;
+    // create each shard's queue on the (pinned) pool thread serving it, so the OS places its
+    // memory on that thread's NUMA node when it's first touched.
+    bool numa_local_queue = false;
+
+    // how long the destructor lets the pool threads drain the queues (see shutdown()).
+    // 0 means no limit.
+    std::chrono::milliseconds shutdown_timeout{0};
+};
+
+// snapshot of the thread pool statistics (see thread_pool::stats())
+struct thread_pool_stats {
+    static constexpr size_t latency_buckets = 24;
+
+    // max number of messages seen in a queue (of any shard)
+    size_t high_water_mark = 0;
+    // time from the log call until a pool thread took the message from the queue.
+    // latency_histogram[0] counts the messages taken within 1us, latency_histogram[i] those
+    // taken within [2^(i-1), 2^i) us, and the last bucket all the slower ones.
+    std::array<size_t, latency_buckets> latency_histogram{};
+    // total time producers were blocked on a full queue (or queue budget) under the block policy
+    std::chrono::nanoseconds blocked_time{0};
+    size_t overrun_counter = 0;
+    size_t discard_counter = 0;
 };
 
 class SPDLOG_API thread_pool {
 public:
     using item_type = async_msg;
     using q_type = details::mpmc_blocking_queue<item_type>;
+    using lock_free_q_type = details::mpmc_lockfree_queue<item_type>;
+    using per_thread_q_type = details::spsc_lanes_queue<item_type>;
 
+    explicit thread_pool(const thread_pool_options &options);
     thread_pool(size_t q_max_items,
                 size_t threads_n,
                 std::function<void()> on_thread_start,
-                std::function<void()> on_thread_stop);
+                std::function<void()> on_thread_stop,
+                async_queue_type queue_type = async_queue_type::mutex);
     thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start);
     thread_pool(size_t q_max_items, size_t threads_n);
+    thread_pool(size_t q_max_items, size_t threads_n, async_queue_type queue_type);
 
-    // message all threads to terminate gracefully and join them
+    // shutdown() within options.shutdown_timeout (if not already done)
     ~thread_pool();
 
     thread_pool(const thread_pool &) = delete;
     thread_pool &operator=(thread_pool &&) = delete;
 
-    void post_log(async_logger_ptr &&worker_ptr,
+    void post_log(async_logger *worker_ptr,
                   const details::log_msg &msg,
-                  async_overflow_policy overflow_policy);
-    std::future<void> post_flush(async_logger_ptr &&worker_ptr,
-                                 async_overflow_policy overflow_policy);
+                  async_overflow_policy overflow_policy,
+                  deferred_format_fn format_fn = nullptr);
+    // reserve a log record of the logger for up to max_payload bytes of payload, to be written
+    // in place (see log_reservation). msg holds the rest of the message (its payload is
+    // ignored). unsupported by the priority lanes and by the queues other than byte_ring.
+    reserve_status reserve_log(async_logger *worker_ptr,
+                               const details::log_msg &msg,
+                               size_t max_payload,
+                               async_overflow_policy overflow_policy,
+                               log_reservation &reservation);
+    // post flush request number flush_seq of the logger
+    void post_flush(async_logger *worker_ptr,
+                    size_t flush_seq,
+                    async_overflow_policy overflow_policy);
+
+    // messages refer to their logger by a plain pointer, so posting a message doesn't touch the
+    // logger's reference count. instead, a logger registers once with the pool, which keeps it
+    // alive. loggers not referenced anywhere else are released by the pool threads once the
+    // queues were found empty and every pool thread has finished the batch it was working on.
+    void register_logger(async_logger_ptr logger);
+    // register the calling thread as a producer of the pool (see producer_scope)
+    void register_producer();
+
+    // a registered logger holds a plain pointer to its pool (its pool handle), so producers post
+    // without locking the logger's weak_ptr to the pool, whose reference count all the producers
+    // would share. while a producer uses the handle, its own epoch is odd. the pool destructor
+    // revokes the handles, then waits for the producers that were using them, like the pool
+    // threads wait for each other before releasing loggers.
+    class producer_scope {
+    public:
+        // enter the scope if the logger has a pool handle and the calling thread is a
+        // registered producer of the pool. otherwise pool() is null and the caller should
+        // lock the weak_ptr instead.
+        explicit producer_scope(const async_logger &logger);
+        ~producer_scope();
+        producer_scope(const producer_scope &) = delete;
+        producer_scope &operator=(const producer_scope &) = delete;
+
+        thread_pool *pool() const { return pool_; }
+
+    private:
+        thread_pool *pool_ = nullptr;
+        std::atomic<size_t> *epoch_ = nullptr;
+    };
+    // the counters and the queue size are summed over all the shards
     size_t overrun_counter();
     void reset_overrun_counter();
     size_t discard_counter();
     void reset_discard_counter();
     size_t queue_size();
 
+    // number of queues: threads_n if sharded, 1 otherwise
+    size_t shards_n() const;
+    // number of messages in the given shard's queue
+    size_t queue_size(size_t shard);
+    // the shard serving the logger
+    size_t shard_of(const async_logger &logger) const;
+
+    // bytes of the queued messages. tracked only while q_max_bytes or the global limit is set.
+    size_t memory_usage() const;
+
+    // stop the pool. the messages posted from now on are dropped, and the pool threads process
+    // the queued messages until they are done or the deadline has passed. then they exit and the
+    // messages left are abandoned (reported to their loggers as dropped).
+    // a sink call in progress at the deadline isn't interrupted.
+    // return the number of abandoned log messages.
+    size_t shutdown(std::chrono::steady_clock::time_point deadline =
+                        std::chrono::steady_clock::time_point::max());
+    size_t shutdown(std::chrono::milliseconds timeout);
+
+    // statistics collected since the pool was created or reset_stats() was called.
+    // taken without locking the queues. messages dropped per logger: async_logger::drop_counter().
+    thread_pool_stats stats();
+    void reset_stats();
+
 private:
-    q_type q_;
+    // per thread buffers, reused by all batches
+    struct batch_buffers {
+        std::vector<async_msg> msgs;
+        std::vector<async_msg> priority_msgs;
+        std::vector<log_msg> log_msgs;
+        std::vector<memory_buf_t> payloads;  // deferred messages formatted by the pool
+    };
+
+    // high priority messages of a shard.
+    // pending is raised before a message is pushed, so it is never behind the queue.
+    struct priority_lane {
+        explicit priority_lane(size_t max_items)
+            : q(max_items) {}
+        mpmc_blocking_queue<async_msg> q;
+        std::atomic<size_t> pending{0};
+    };
+
+    // control messages (flush requests, terminate, wakeup) a budget overrun took out of a
+    // shard's queue to get to the log messages behind them (see charge_()).
+    // the pool threads serve them after their next batch.
+    struct held_controls {
+        std::mutex mutex;
+        std::vector<async_msg> msgs;
+        std::atomic<size_t> pending{0};
+    };
+
+    // the constructor waits until all the pool threads have applied their settings
+    struct thread_startup {
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t ready = 0;
+        bool go = false;
+        std::string error;  // of the first thread that failed
+    };
+
+    // odd while the thread is taking or processing a batch, even between batches
+    struct worker_epoch {
+        std::atomic<size_t> value{0};
+        char pad[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    // odd while the producer thread is in a producer_scope of the pool, even otherwise.
+    // held by the pool and by the thread (in thread local storage).
+    struct producer_epoch {
+        std::atomic<size_t> value{0};
+        std::atomic<bool> detached{false};  // the pool was destroyed
+        char pad[64 - sizeof(std::atomic<size_t>) - sizeof(std::atomic<bool>)];
+    };
+    using producer_epochs =
+        std::vector<std::pair<const thread_pool *, std::shared_ptr<producer_epoch>>>;
+
+    // written only by its pool thread
+    struct worker_stats {
+        std::atomic<size_t> latency_histogram[thread_pool_stats::latency_buckets] = {};
+        char pad[64];
+    };
+
+    memory_budget queue_budget_;                        // must outlive the queued messages
+    std::vector<std::unique_ptr<async_queue>> queues_;  // one per shard
+    std::vector<std::unique_ptr<priority_lane>> priority_lanes_;  // one per shard, if enabled
+    std::vector<std::unique_ptr<held_controls>> held_controls_;   // one per shard
+    level::level_enum priority_level_;
+    size_t max_batch_size_;
+    async_wait_strategy wait_strategy_;
+    size_t spin_count_;
 
+    // producers waiting for the queue budget under the block policy
+    std::mutex budget_mutex_;
+    std::condition_variable budget_cv_;
+    std::atomic<size_t> budget_waiters_{0};
+    // messages dropped by the pool itself: by the overflow policy because of the queue budget,
+    // or posted after shutdown()
+    std::atomic<size_t> budget_overrun_counter_{0};
+    std::atomic<size_t> pool_discard_counter_{0};
+    queue_stats budget_stats_;  // time blocked on the queue budget
+
+    std::chrono::milliseconds shutdown_timeout_;
+    std::mutex shutdown_mutex_;
+    std::atomic<bool> stopped_{false};
+    // steady clock ticks of the shutdown deadline, max if there is none
+    std::atomic<std::chrono::steady_clock::rep> deadline_{
+        (std::numeric_limits<std::chrono::steady_clock::rep>::max)()};
+    std::atomic<size_t> abandoned_{0};  // log messages skipped by the pool threads
+
+    std::unique_ptr<worker_epoch[]> worker_epochs_;
+    std::unique_ptr<worker_stats[]> worker_stats_;
     std::vector<std::thread> threads_;
 
-    void post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy);
-    void worker_loop_();
+    std::mutex loggers_mutex_;
+    std::unordered_map<async_logger *, async_logger_ptr> loggers_;
+    std::vector<async_logger_ptr> unused_loggers_;    // waiting for the queues to be empty
+    std::vector<async_logger_ptr> draining_loggers_;  // waiting for the pool threads
+    std::vector<size_t> draining_epochs_;
+    // loggers held by the pool (in any of the above). while there are some, idle pool threads
+    // wake up periodically to release them. while there are none nothing can be queued, so the
+    // pool threads wait on idle_cv_ for the next registration instead.
+    std::atomic<size_t> held_loggers_{0};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+
+    std::mutex producers_mutex_;
+    std::vector<std::shared_ptr<producer_epoch>> producer_epochs_;  // of the registered producers
+
+    static std::unique_ptr<async_queue> make_queue_(const thread_pool_options &options);
+    async_queue &queue_of_(const async_logger *worker_ptr);
+    // charge bytes to the budget of the shard's queue. when it's exhausted apply the overflow
+    // policy. return false if the new message should be dropped.
+    bool charge_(size_t shard,
+                 size_t bytes,
+                 async_overflow_policy overflow_policy,
+                 std::chrono::milliseconds block_timeout,
+                 memory_charge &charge);
+    void post_priority_(async_logger *worker_ptr,
+                        const details::log_msg &msg,
+                        deferred_format_fn format_fn);
+    // apply the thread settings to the calling pool thread and create its queue if it should.
+    // return an error message on failure.
+    std::string setup_thread_(const thread_pool_options &options, size_t index);
+    void worker_loop_(size_t index);
+    bool deadline_passed_() const;
+
+    // release the registered loggers no longer referenced outside the pool
+    void release_unused_loggers_();
+    // wait until the pool holds some logger or is stopped
+    void wait_for_loggers_();
+
+    // the (pool, epoch) pairs of the pools the calling thread is a registered producer of
+    static producer_epochs &local_producer_epochs_();
+    // revoke the pool handles of the loggers and wait for the producers still using them
+    void revoke_pool_handles_();
 
-    // process next message in the queue
+    // process next batch of messages in the queue
     // return true if this thread should still be active (while no terminate msg
-    // was received)
-    bool process_next_msg_();
+    // was received). a thread waits at most max_wait for messages.
+    bool process_next_batch_(size_t shard,
+                             batch_buffers &buffers,
+                             worker_stats &stats,
+                             std::chrono::milliseconds max_wait);
+
+    // take up to max_items messages from the queue, waiting according to the wait strategy.
+    // return 0 if the queue is still empty after max_wait.
+    size_t dequeue_bulk_(async_queue &q,
+                         async_msg *msgs,
+                         size_t max_items,
+                         std::chrono::milliseconds max_wait);
+
+    // add the queue latency of the log messages to the histogram of the pool thread
+    static void record_latency_(const async_msg *msgs, size_t count, worker_stats &stats);
+
+    // process the dequeued messages. return the number of terminate messages among them.
+    size_t process_msgs_(async_msg *msgs, size_t count, batch_buffers &buffers);
+    // process the held control messages of the shard. return the number of terminate messages.
+    size_t process_held_controls_(size_t shard, batch_buffers &buffers);
+
+    static thread_pool_options make_options_(size_t q_max_items,
+                                             size_t threads_n,
+                                             std::function<void()> on_thread_start,
+                                             std::function<void()> on_thread_stop,
+                                             async_queue_type queue_type);
+
+    // pass msgs (consecutive log messages of the same logger) to the logger in one call
+    void sink_batch_(async_msg *msgs, size_t count, batch_buffers &buffers);
 };
 
 }  // namespace details
@@ -0,0 +1,263 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Structured key/value fields of a log message.
+// Pass them with the format arguments:
+//   logger->info("request done", spdlog::kv("latency_us", 123), spdlog::kv("path", path));
+//
+// The fields are kept typed and unformatted in the log_msg (and copied by log_msg_buffer, e.g.
+// through the async queue), to be serialized only by the sinks that use them - e.g. the %k
+// pattern flag writes "latency_us:123 path:/index". Formatted by a "{}" in the format string,
+// a field writes the same "key:value".
+//
+// The key and string values are not copied when logging synchronously, so they only need to
+// outlive the log call.
+
+#include <spdlog/common.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+namespace spdlog {
+
+enum class field_type : unsigned char { signed_int, unsigned_int, floating, boolean, string };
+
+class field {
+public:
+    field()
+        : field(string_view_t(), int64_t(0)) {}
+
+    field(string_view_t key, int64_t value)
+        : key_ptr_(key.data()),
+          key_size_(key.size()),
+          type_(field_type::signed_int) {
+        value_.signed_int = value;
+    }
+
+    field(string_view_t key, uint64_t value)
+        : key_ptr_(key.data()),
+          key_size_(key.size()),
+          type_(field_type::unsigned_int) {
+        value_.unsigned_int = value;
+    }
+
+    field(string_view_t key, double value)
+        : key_ptr_(key.data()),
+          key_size_(key.size()),
+          type_(field_type::floating) {
+        value_.floating = value;
+    }
+
+    field(string_view_t key, bool value)
+        : key_ptr_(key.data()),
+          key_size_(key.size()),
+          type_(field_type::boolean) {
+        value_.boolean = value;
+    }
+
+    field(string_view_t key, string_view_t value)
+        : key_ptr_(key.data()),
+          key_size_(key.size()),
+          type_(field_type::string) {
+        value_.string.data = value.data();
+        value_.string.size = value.size();
+    }
+
+    string_view_t key() const { return string_view_t(key_ptr_, key_size_); }
+    field_type type() const { return type_; }
+
+    int64_t signed_int() const { return value_.signed_int; }
+    uint64_t unsigned_int() const { return value_.unsigned_int; }
+    double floating() const { return value_.floating; }
+    bool boolean() const { return value_.boolean; }
+    string_view_t string() const { return string_view_t(value_.string.data, value_.string.size); }
+
+    // point the key and the string value to new copies of them (see log_msg_buffer)
+    void rebind(const char *key, const char *string_value) {
+        key_ptr_ = key;
+        if (type_ == field_type::string) {
+            value_.string.data = string_value;
+        }
+    }
+
+    // bytes of the key and the string value
+    size_t data_size() const {
+        return key_size_ + (type_ == field_type::string ? value_.string.size : 0);
+    }
+
+private:
+    struct string_ref {
+        const char *data;
+        size_t size;
+    };
+
+    const char *key_ptr_;
+    size_t key_size_;
+    field_type type_;
+    union {
+        int64_t signed_int;
+        uint64_t unsigned_int;
+        double floating;
+        bool boolean;
+        string_ref string;
+    } value_;
+};
+
+// the fields of a log_msg
+class field_list {
+public:
+    field_list() = default;
+    field_list(const field *data, size_t size)
+        : data_(data),
+          size_(size) {}
+
+    const field *begin() const { return data_; }
+    const field *end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const field &operator[](size_t i) const { return data_[i]; }
+
+private:
+    const field *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+template <typename T,
+          typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type =
+              0>
+field kv(string_view_t key, T value) {
+    return field(key, static_cast<int64_t>(value));
+}
+
+template <typename T,
+          typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                      !std::is_same<T, bool>::value,
+                                  int>::type = 0>
+field kv(string_view_t key, T value) {
+    return field(key, static_cast<uint64_t>(value));
+}
+
+template <typename T, typename std::enable_if<std::is_same<T, bool>::value, int>::type = 0>
+field kv(string_view_t key, T value) {
+    return field(key, static_cast<bool>(value));
+}
+
+template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+field kv(string_view_t key, T value) {
+    return field(key, static_cast<double>(value));
+}
+
+inline field kv(string_view_t key, string_view_t value) { return field(key, value); }
+
+namespace details {
+
+// append "value" of the field to dest
+inline void append_field_value(const field &f, memory_buf_t &dest) {
+    switch (f.type()) {
+        case field_type::signed_int:
+            fmt_lib::format_to(std::back_inserter(dest), SPDLOG_FMT_STRING("{}"), f.signed_int());
+            break;
+        case field_type::unsigned_int:
+            fmt_lib::format_to(std::back_inserter(dest), SPDLOG_FMT_STRING("{}"), f.unsigned_int());
+            break;
+        case field_type::floating:
+            fmt_lib::format_to(std::back_inserter(dest), SPDLOG_FMT_STRING("{}"), f.floating());
+            break;
+        case field_type::boolean: {
+            string_view_t text = f.boolean() ? "true" : "false";
+            dest.append(text.data(), text.data() + text.size());
+            break;
+        }
+        case field_type::string: {
+            auto text = f.string();
+            dest.append(text.data(), text.data() + text.size());
+            break;
+        }
+    }
+}
+
+// append "key:value" of the field to dest
+inline void append_field(const field &f, memory_buf_t &dest) {
+    auto key = f.key();
+    dest.append(key.data(), key.data() + key.size());
+    dest.push_back(':');
+    append_field_value(f, dest);
+}
+
+template <typename T>
+struct is_field : std::is_same<typename std::decay<T>::type, field> {};
+
+template <typename... Args>
+struct count_fields;
+
+template <>
+struct count_fields<> : std::integral_constant<size_t, 0> {};
+
+template <typename T, typename... Rest>
+struct count_fields<T, Rest...>
+    : std::integral_constant<size_t, (is_field<T>::value ? 1 : 0) + count_fields<Rest...>::value> {
+};
+
+// the fields among the arguments of a log call, in order
+template <size_t N>
+class field_array {
+public:
+    template <typename... Args>
+    explicit field_array(const Args &...args) {
+        size_t n = 0;
+        // braced init lists are evaluated left to right
+        int expand[] = {(add_(n, args), 0)...};
+        (void)expand;
+    }
+
+    field_list list() const { return field_list(fields_, N); }
+
+private:
+    field fields_[N];
+
+    void add_(size_t &n, const field &f) { fields_[n++] = f; }
+
+    template <typename T>
+    void add_(size_t &, const T &) {}
+};
+
+template <>
+class field_array<0> {
+public:
+    template <typename... Args>
+    explicit field_array(const Args &...) {}
+
+    field_list list() const { return field_list(); }
+};
+
+}  // namespace details
+}  // namespace spdlog
+
+namespace
+#ifdef SPDLOG_USE_STD_FORMAT
+    std
+#else
+    fmt
+#endif
+{
+
+template <>
+struct formatter<spdlog::field, char> {
+    template <typename ParseContext>
+    SPDLOG_CONSTEXPR_FUNC auto parse(ParseContext &ctx) -> decltype(ctx.begin()) {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const spdlog::field &f, FormatContext &ctx) const -> decltype(ctx.out()) {
+        spdlog::memory_buf_t buf;
+        spdlog::details::append_field(f, buf);
+        return std::copy(buf.data(), buf.data() + buf.size(), ctx.out());
+    }
+};
+
+}  // namespace std / fmt
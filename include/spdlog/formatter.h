@@ -6,6 +6,8 @@
 #include <spdlog/details/log_msg.h>
 #include <spdlog/fmt/fmt.h>
 
+#include <cstdint>
+
 namespace spdlog {
 
 class formatter {
@@ -13,5 +15,8 @@ public:
     virtual ~formatter() = default;
     virtual void format(const details::log_msg &msg, memory_buf_t &dest) = 0;
     virtual std::unique_ptr<formatter> clone() const = 0;
+    // formatters with the same non zero fingerprint format every message the same way
+    // (see details::format_cache). 0 - unknown.
+    virtual uint64_t fingerprint() const { return 0; }
 };
 }  // namespace spdlog
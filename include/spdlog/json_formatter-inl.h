@@ -0,0 +1,165 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+    #include <spdlog/json_formatter.h>
+#endif
+
+#include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/json_escape.h>
+#include <spdlog/details/os.h>
+
+#include <cmath>
+#include <iterator>
+
+namespace spdlog {
+
+SPDLOG_INLINE json_formatter::json_formatter(pattern_time_type time_type, std::string eol)
+    : time_type_(time_type),
+      eol_(std::move(eol)) {}
+
+SPDLOG_INLINE std::unique_ptr<formatter> json_formatter::clone() const {
+    return details::make_unique<json_formatter>(time_type_, eol_);
+}
+
+SPDLOG_INLINE void json_formatter::format(const details::log_msg &msg, memory_buf_t &dest) {
+    using details::fmt_helper::append_int;
+    using details::fmt_helper::append_string_view;
+    namespace json = details::json;
+
+    format_time_(msg, dest);
+
+    append_string_view(",\"level\":\"", dest);
+    append_string_view(level::to_string_view(msg.level), dest);
+
+    append_string_view("\",\"logger\":", dest);
+    json::append_string(msg.logger_name, dest);
+
+    append_string_view(",\"thread\":", dest);
+    append_int(msg.thread_id, dest);
+
+    if (!msg.source.empty()) {
+        format_source_(msg.source, dest);
+    }
+    auto mdc = msg.mdc();
+    if (!mdc.empty()) {
+        format_mdc_(mdc, dest);
+    }
+    if (!msg.fields.empty()) {
+        format_fields_(msg.fields, dest);
+    }
+
+    append_string_view(",\"message\":", dest);
+    json::append_string(msg.payload, dest);
+    dest.push_back('}');
+    append_string_view(eol_, dest);
+}
+
+// the date and time are formatted once per second, the microseconds per message
+SPDLOG_INLINE void json_formatter::format_time_(const details::log_msg &msg, memory_buf_t &dest) {
+    using details::fmt_helper::append_string_view;
+    using details::fmt_helper::pad2;
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+    if (secs != cache_timestamp_ || cached_datetime_.size() == 0) {
+        auto t = log_clock::to_time_t(msg.time);
+        std::tm tm_time = time_type_ == pattern_time_type::local ? details::os::localtime(t)
+                                                                 : details::os::gmtime(t);
+        cached_datetime_.clear();
+        append_string_view("{\"time\":\"", cached_datetime_);
+        details::fmt_helper::append_int(tm_time.tm_year + 1900, cached_datetime_);
+        cached_datetime_.push_back('-');
+        pad2(tm_time.tm_mon + 1, cached_datetime_);
+        cached_datetime_.push_back('-');
+        pad2(tm_time.tm_mday, cached_datetime_);
+        cached_datetime_.push_back('T');
+        pad2(tm_time.tm_hour, cached_datetime_);
+        cached_datetime_.push_back(':');
+        pad2(tm_time.tm_min, cached_datetime_);
+        cached_datetime_.push_back(':');
+        pad2(tm_time.tm_sec, cached_datetime_);
+        cached_datetime_.push_back('.');
+
+        cached_offset_.clear();
+        if (time_type_ == pattern_time_type::local) {
+            auto total_minutes = details::os::utc_minutes_offset(tm_time);
+            cached_offset_.push_back(total_minutes < 0 ? '-' : '+');
+            total_minutes = total_minutes < 0 ? -total_minutes : total_minutes;
+            pad2(total_minutes / 60, cached_offset_);
+            cached_offset_.push_back(':');
+            pad2(total_minutes % 60, cached_offset_);
+        } else {
+            cached_offset_.push_back('Z');
+        }
+        cached_offset_.push_back('"');
+        cache_timestamp_ = secs;
+    }
+    dest.append(cached_datetime_.data(), cached_datetime_.data() + cached_datetime_.size());
+    auto micros = details::fmt_helper::time_fraction<std::chrono::microseconds>(msg.time);
+    details::fmt_helper::pad6(static_cast<uint32_t>(micros.count()), dest);
+    dest.append(cached_offset_.data(), cached_offset_.data() + cached_offset_.size());
+}
+
+SPDLOG_INLINE void json_formatter::format_source_(const source_loc &source, memory_buf_t &dest) {
+    using details::fmt_helper::append_string_view;
+    append_string_view(",\"source\":{\"file\":", dest);
+    details::json::append_string(source.filename, dest);
+    append_string_view(",\"line\":", dest);
+    details::fmt_helper::append_int(source.line, dest);
+    if (source.funcname != nullptr) {
+        append_string_view(",\"function\":", dest);
+        details::json::append_string(source.funcname, dest);
+    }
+    dest.push_back('}');
+}
+
+SPDLOG_INLINE void json_formatter::format_mdc_(const details::mdc_view &mdc, memory_buf_t &dest) {
+    details::fmt_helper::append_string_view(",\"mdc\":{", dest);
+    for (size_t i = 0; i < mdc.size(); i++) {
+        if (i > 0) {
+            dest.push_back(',');
+        }
+        details::json::append_string(mdc.key(i), dest);
+        dest.push_back(':');
+        details::json::append_string(mdc.value(i), dest);
+    }
+    dest.push_back('}');
+}
+
+SPDLOG_INLINE void json_formatter::format_fields_(field_list fields, memory_buf_t &dest) {
+    using details::fmt_helper::append_string_view;
+    append_string_view(",\"fields\":{", dest);
+    for (auto &f : fields) {
+        if (&f != fields.begin()) {
+            dest.push_back(',');
+        }
+        details::json::append_string(f.key(), dest);
+        dest.push_back(':');
+        switch (f.type()) {
+            case field_type::signed_int:
+                details::fmt_helper::append_int(f.signed_int(), dest);
+                break;
+            case field_type::unsigned_int:
+                details::fmt_helper::append_int(f.unsigned_int(), dest);
+                break;
+            case field_type::floating:
+                // JSON has no infinity or NaN
+                if (std::isfinite(f.floating())) {
+                    details::append_field_value(f, dest);
+                } else {
+                    append_string_view("null", dest);
+                }
+                break;
+            case field_type::boolean:
+                append_string_view(f.boolean() ? "true" : "false", dest);
+                break;
+            case field_type::string:
+                details::json::append_string(f.string(), dest);
+                break;
+        }
+    }
+    dest.push_back('}');
+}
+
+}  // namespace spdlog
@@ -0,0 +1,58 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Formatter of one JSON object per message (JSON Lines), e.g.
+// {"time":"2023-11-14T22:13:20.123456+01:00","level":"info","logger":"app","thread":1234,
+//  "source":{"file":"main.cpp","line":12,"function":"main"},"mdc":{"user":"bob"},
+//  "fields":{"latency_us":123},"message":"request done"}
+// (in a single line). "source", "mdc" and "fields" are written only if not empty.
+// Strings are escaped (see details/json_escape.h), so any payload gives valid JSON. Invalid UTF-8
+// in the text is replaced by U+FFFD.
+//
+// Usage:
+//   sink->set_formatter(spdlog::details::make_unique<spdlog::json_formatter>());
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+#include <spdlog/formatter.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace spdlog {
+
+class SPDLOG_API json_formatter final : public formatter {
+public:
+    explicit json_formatter(pattern_time_type time_type = pattern_time_type::local,
+                            std::string eol = spdlog::details::os::default_eol);
+
+    json_formatter(const json_formatter &other) = delete;
+    json_formatter &operator=(const json_formatter &other) = delete;
+
+    std::unique_ptr<formatter> clone() const override;
+    void format(const details::log_msg &msg, memory_buf_t &dest) override;
+
+private:
+    pattern_time_type time_type_;
+    std::string eol_;
+
+    // {"time":"YYYY-MM-DDTHH:MM:SS of the last second formatted, and its utc offset
+    std::chrono::seconds cache_timestamp_{0};
+    memory_buf_t cached_datetime_;
+    memory_buf_t cached_offset_;
+
+    void format_time_(const details::log_msg &msg, memory_buf_t &dest);
+    static void format_source_(const source_loc &source, memory_buf_t &dest);
+    static void format_mdc_(const details::mdc_view &mdc, memory_buf_t &dest);
+    static void format_fields_(field_list fields, memory_buf_t &dest);
+};
+
+}  // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+    #include "json_formatter-inl.h"
+#endif
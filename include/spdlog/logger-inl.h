@@ -8,6 +8,7 @@
 #endif
 
 #include <spdlog/details/backtracer.h>
+#include <spdlog/details/format_cache.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/sink.h>
 
@@ -22,7 +23,9 @@ SPDLOG_INLINE logger::logger(const logger &other)
       level_(other.level_.load(std::memory_order_relaxed)),
       flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
       custom_err_handler_(other.custom_err_handler_),
-      tracer_(other.tracer_) {}
+      tracer_(other.tracer_),
+      deferred_formatting_(other.deferred_formatting_.load(std::memory_order_relaxed)),
+      in_place_formatting_(other.in_place_formatting_.load(std::memory_order_relaxed)) {}
 
 SPDLOG_INLINE logger::logger(logger &&other) SPDLOG_NOEXCEPT
     : name_(std::move(other.name_)),
@@ -30,7 +33,9 @@ SPDLOG_INLINE logger::logger(logger &&other) SPDLOG_NOEXCEPT
       level_(other.level_.load(std::memory_order_relaxed)),
       flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
       custom_err_handler_(std::move(other.custom_err_handler_)),
-      tracer_(std::move(other.tracer_))
+      tracer_(std::move(other.tracer_)),
+      deferred_formatting_(other.deferred_formatting_.load(std::memory_order_relaxed)),
+      in_place_formatting_(other.in_place_formatting_.load(std::memory_order_relaxed))
 
 {}
 
@@ -42,6 +47,8 @@ SPDLOG_INLINE logger &logger::operator=(logger other) SPDLOG_NOEXCEPT {
 SPDLOG_INLINE void logger::swap(spdlog::logger &other) SPDLOG_NOEXCEPT {
     name_.swap(other.name_);
     sinks_.swap(other.sinks_);
+    sinks_fingerprint_.invalidate();
+    other.sinks_fingerprint_.invalidate();
 
     // swap level_
     auto other_level = other.level_.load();
@@ -55,6 +62,16 @@ SPDLOG_INLINE void logger::swap(spdlog::logger &other) SPDLOG_NOEXCEPT {
 
     custom_err_handler_.swap(other.custom_err_handler_);
     std::swap(tracer_, other.tracer_);
+
+    // swap deferred_formatting_
+    auto other_deferred = other.deferred_formatting_.load();
+    auto my_deferred = deferred_formatting_.exchange(other_deferred);
+    other.deferred_formatting_.store(my_deferred);
+
+    // swap in_place_formatting_
+    auto other_in_place = other.in_place_formatting_.load();
+    auto my_in_place = in_place_formatting_.exchange(other_in_place);
+    other.in_place_formatting_.store(my_in_place);
 }
 
 SPDLOG_INLINE void swap(logger &a, logger &b) { a.swap(b); }
@@ -106,7 +123,11 @@ SPDLOG_INLINE level::level_enum logger::flush_level() const {
 // sinks
 SPDLOG_INLINE const std::vector<sink_ptr> &logger::sinks() const { return sinks_; }
 
-SPDLOG_INLINE std::vector<sink_ptr> &logger::sinks() { return sinks_; }
+// the caller may change the sinks - find their shared fingerprint again
+SPDLOG_INLINE std::vector<sink_ptr> &logger::sinks() {
+    sinks_fingerprint_.invalidate();
+    return sinks_;
+}
 
 // error handler
 SPDLOG_INLINE void logger::set_error_handler(err_handler handler) {
@@ -133,6 +154,10 @@ SPDLOG_INLINE void logger::log_it_(const spdlog::details::log_msg &log_msg,
 }
 
 SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg) {
+    // sinks with the same pattern format the message once
+    auto fingerprint = sinks_fingerprint_.get(sinks_);
+    details::format_cache cache(&msg, fingerprint != 0 ? 1 : 0, fingerprint);
+    details::format_cache::scope cache_scope(cache);
     for (auto &sink : sinks_) {
         if (sink->should_log(msg.level)) {
             SPDLOG_TRY { sink->log(msg); }
@@ -145,6 +170,21 @@ SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg) {
     }
 }
 
+SPDLOG_INLINE void logger::sink_deferred_(const details::log_msg &msg,
+                                          details::deferred_format_fn format_fn) {
+    memory_buf_t formatted;
+    format_fn(msg.payload, formatted);
+    details::log_msg formatted_msg(msg);
+    formatted_msg.payload = string_view_t(formatted.data(), formatted.size());
+    sink_it_(formatted_msg);
+}
+
+SPDLOG_INLINE bool logger::sink_in_place_(const details::log_msg &,
+                                          string_view_t,
+                                          fmt_lib::format_args) {
+    return false;
+}
+
 SPDLOG_INLINE void logger::flush_() {
     for (auto &sink : sinks_) {
         SPDLOG_TRY { sink->flush(); }
@@ -16,6 +16,8 @@
 
 #include <spdlog/common.h>
 #include <spdlog/details/backtracer.h>
+#include <spdlog/details/deferred_format.h>
+#include <spdlog/details/format_cache.h>
 #include <spdlog/details/log_msg.h>
 
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
@@ -307,10 +309,16 @@ public:
 protected:
     std::string name_;
     std::vector<sink_ptr> sinks_;
+    // sinks with this fingerprint share their output (see details::format_cache)
+    details::sinks_fingerprint sinks_fingerprint_;
     spdlog::level_t level_{level::info};
     spdlog::level_t flush_level_{level::off};
     err_handler custom_err_handler_{nullptr};
     details::backtracer tracer_;
+    // pass the unformatted args to sink_deferred_() when possible (see async_logger)
+    std::atomic<bool> deferred_formatting_{false};
+    // format the messages straight into sink_in_place_() when possible (see async_logger)
+    std::atomic<bool> in_place_formatting_{false};
 
     // common implementation for after templated public api has been resolved
     template <typename... Args>
@@ -322,6 +330,18 @@ protected:
         }
         SPDLOG_TRY {
             memory_buf_t buf;
+            if (!traceback_enabled && deferred_formatting_.load(std::memory_order_relaxed) &&
+                log_deferred_(details::is_deferrable<Args...>{}, buf, loc, lvl, fmt, args...)) {
+                return;
+            }
+            using fields_count = details::count_fields<Args...>;
+            if (!traceback_enabled && fields_count::value == 0 &&
+                in_place_formatting_.load(std::memory_order_relaxed)) {
+                details::log_msg log_msg(loc, name_, lvl, string_view_t());
+                if (sink_in_place_(log_msg, fmt, fmt_lib::make_format_args(args...))) {
+                    return;
+                }
+            }
 #ifdef SPDLOG_USE_STD_FORMAT
             fmt_lib::vformat_to(std::back_inserter(buf), fmt, fmt_lib::make_format_args(args...));
 #else
@@ -329,6 +349,8 @@ protected:
 #endif
 
             details::log_msg log_msg(loc, name_, lvl, string_view_t(buf.data(), buf.size()));
+            details::field_array<fields_count::value> fields(args...);
+            log_msg.fields = fields.list();
             log_it_(log_msg, log_enabled, traceback_enabled);
         }
         SPDLOG_LOGGER_CATCH(loc)
@@ -357,10 +379,45 @@ protected:
     }
 #endif  // SPDLOG_WCHAR_TO_UTF8_SUPPORT
 
+    // pack the format string and args instead of formatting them, and pass to sink_deferred_()
+    template <typename... Args>
+    bool log_deferred_(std::true_type,
+                       memory_buf_t &buf,
+                       source_loc loc,
+                       level::level_enum lvl,
+                       string_view_t fmt,
+                       const Args &...args) {
+        details::pack_deferred_args(buf, fmt, args...);
+        details::log_msg log_msg(loc, name_, lvl, string_view_t(buf.data(), buf.size()));
+        sink_deferred_(log_msg,
+                       &details::format_deferred_args<typename std::decay<Args>::type...>);
+        return true;
+    }
+
+    // some of the args cannot be packed - format on the calling thread
+    template <typename... Args>
+    bool log_deferred_(std::false_type,
+                       memory_buf_t &,
+                       source_loc,
+                       level::level_enum,
+                       string_view_t,
+                       const Args &...) {
+        return false;
+    }
+
     // log the given message (if the given log level is high enough),
     // and save backtrace (if backtrace is enabled).
     void log_it_(const details::log_msg &log_msg, bool log_enabled, bool traceback_enabled);
     virtual void sink_it_(const details::log_msg &msg);
+    // msg payload holds the packed format string and args (see details::pack_deferred_args()).
+    // the default implementation formats it right away and calls sink_it_().
+    virtual void sink_deferred_(const details::log_msg &msg, details::deferred_format_fn format_fn);
+    // format the message straight into its destination (e.g. a slot in the async queue) instead
+    // of a temporary buffer. msg has an empty payload.
+    // return false if not possible - the message is then formatted and sunk as usual.
+    virtual bool sink_in_place_(const details::log_msg &msg,
+                                string_view_t fmt,
+                                fmt_lib::format_args args);
     virtual void flush_();
     void dump_backtrace_();
     bool should_flush_(const details::log_msg &msg);
@@ -1,31 +1,282 @@
+#pragma once
+
+// Mapped Diagnostic Context (MDC): key/value pairs of the current thread, printed by the %&
+// pattern flag (and by json_formatter) with each message the thread logs.
+//   spdlog::mdc::put("user", "bob");
+//   spdlog::info("logged in");  // [2024-04-26 02:08:05.040] [info] [user:bob] logged in
+//
+// The pairs are kept sorted by key, pre-rendered as "key_1:value_1 key_2:value_2" in one flat
+// buffer (stored inline while small), which put/remove/clear update in place - formatting a
+// message copies the rendered text and allocates nothing.
+// Messages copied for later (async loggers, backtrace) take a snapshot of the MDC of the logging
+// thread with them (see log_msg::mdc()).
+
 #include <spdlog/common.h>
+
+#include <cstring>
 #include <map>
+#include <string>
 
 namespace spdlog {
+namespace details {
 
-class SPDLOG_API mdc {
+// a key/value pair of an MDC: "key:value" at key_offset of the rendered text
+struct mdc_entry {
+    size_t key_offset;
+    size_t key_size;
+    size_t value_size;
+};
+
+// An MDC: the rendered text and its entries. The entries are stored as raw bytes, so they can
+// be copied anywhere (e.g. in a queue record) without alignment.
+class mdc_view {
 public:
-    static void put(const std::string &key, const std::string &value) {
-        get_context()[key] = value;
+    mdc_view() = default;
+    mdc_view(const char *entries, size_t size, string_view_t text)
+        : entries_(entries),
+          size_(size),
+          text_(text.data()),
+          text_size_(text.size()),
+          valid_(true) {}
+
+    // false if default constructed (e.g. no MDC was captured with a message)
+    bool valid() const { return valid_; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // "key_1:value_1 key_2:value_2"
+    string_view_t text() const { return string_view_t(text_, text_size_); }
+
+    mdc_entry entry(size_t i) const {
+        mdc_entry e;
+        std::memcpy(&e, entries_ + i * sizeof(mdc_entry), sizeof(e));
+        return e;
+    }
+
+    string_view_t key(size_t i) const {
+        auto e = entry(i);
+        return string_view_t(text_ + e.key_offset, e.key_size);
+    }
+
+    string_view_t value(size_t i) const {
+        auto e = entry(i);
+        return string_view_t(text_ + e.key_offset + e.key_size + 1, e.value_size);
+    }
+
+    const char *entries_data() const { return entries_; }
+    size_t entries_size() const { return size_ * sizeof(mdc_entry); }
+
+    // bytes needed to copy the view
+    size_t data_size() const { return entries_size() + text_size_; }
+
+    // point the view to copies of its entries and text
+    void rebind(const char *entries, const char *text) {
+        entries_ = entries;
+        text_ = text;
+    }
+
+private:
+    const char *entries_ = nullptr;
+    size_t size_ = 0;
+    const char *text_ = nullptr;
+    size_t text_size_ = 0;
+    bool valid_ = false;
+};
+
+// the MDC of a thread
+class mdc_context {
+public:
+    void put(string_view_t key, string_view_t value) {
+        size_t i = lower_bound_(key);
+        if (i < size() && key_(i) == key) {
+            auto e = entry_(i);
+            size_t value_offset = e.key_offset + e.key_size + 1;
+            replace_(value_offset, e.value_size, value);
+            shift_(i + 1, value.size() - e.value_size);
+            e.value_size = value.size();
+            set_entry_(i, e);
+            return;
+        }
+
+        // "key:value " before entry i, or " key:value" at the end
+        size_t item_size = key.size() + 1 + value.size();
+        mdc_entry e{0, key.size(), value.size()};
+        char *p;
+        if (i < size()) {
+            e.key_offset = entry_(i).key_offset;
+            p = insert_(e.key_offset, item_size + 1);
+            p[item_size] = ' ';
+            shift_(i, item_size + 1);
+        } else {
+            bool separator = size() > 0;
+            e.key_offset = text_.size() + (separator ? 1 : 0);
+            p = insert_(text_.size(), item_size + (separator ? 1 : 0));
+            if (separator) {
+                *p++ = ' ';
+            }
+        }
+        copy_(p, key);
+        p[key.size()] = ':';
+        copy_(p + key.size() + 1, value);
+
+        size_t entries_size = entries_.size();
+        entries_.resize(entries_size + sizeof(mdc_entry));
+        char *entries = &entries_[0];
+        std::memmove(entries + (i + 1) * sizeof(mdc_entry), entries + i * sizeof(mdc_entry),
+                     entries_size - i * sizeof(mdc_entry));
+        set_entry_(i, e);
+    }
+
+    // return false if there's no such key
+    bool get(string_view_t key, string_view_t &value) const {
+        size_t i = lower_bound_(key);
+        if (i < size() && key_(i) == key) {
+            value = view().value(i);
+            return true;
+        }
+        return false;
+    }
+
+    void remove(string_view_t key) {
+        size_t i = lower_bound_(key);
+        if (i == size() || key_(i) != key) {
+            return;
+        }
+        if (size() == 1) {
+            clear();
+            return;
+        }
+        auto e = entry_(i);
+        size_t item_size = e.key_size + 1 + e.value_size;
+        if (i + 1 < size()) {
+            erase_(text_, e.key_offset, item_size + 1);  // with the separator after it
+            shift_(i + 1, 0 - (item_size + 1));
+        } else {
+            erase_(text_, e.key_offset - 1, item_size + 1);  // with the separator before it
+        }
+        erase_(entries_, i * sizeof(mdc_entry), sizeof(mdc_entry));
     }
 
+    void clear() {
+        text_.clear();
+        entries_.clear();
+    }
+
+    size_t size() const { return entries_.size() / sizeof(mdc_entry); }
+    bool empty() const { return entries_.size() == 0; }
+
+    mdc_view view() const {
+        return mdc_view(entries_.data(), size(), string_view_t(text_.data(), text_.size()));
+    }
+
+private:
+    memory_buf_t text_;     // the rendered pairs
+    memory_buf_t entries_;  // mdc_entry's, sorted by key
+
+    mdc_entry entry_(size_t i) const { return view().entry(i); }
+
+    void set_entry_(size_t i, const mdc_entry &e) {
+        std::memcpy(&entries_[i * sizeof(mdc_entry)], &e, sizeof(e));
+    }
+
+    string_view_t key_(size_t i) const { return view().key(i); }
+
+    size_t lower_bound_(string_view_t key) const {
+        size_t first = 0;
+        size_t count = size();
+        while (count > 0) {
+            size_t step = count / 2;
+            if (key_(first + step) < key) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+    // add delta (modulo size_t) to the offsets of the entries from i on
+    void shift_(size_t i, size_t delta) {
+        for (; i < size(); i++) {
+            auto e = entry_(i);
+            e.key_offset += delta;
+            set_entry_(i, e);
+        }
+    }
+
+    // open a gap of n bytes at pos of the text, return it
+    char *insert_(size_t pos, size_t n) {
+        size_t old_size = text_.size();
+        text_.resize(old_size + n);
+        char *data = &text_[0];
+        std::memmove(data + pos + n, data + pos, old_size - pos);
+        return data + pos;
+    }
+
+    static void erase_(memory_buf_t &buf, size_t pos, size_t n) {
+        char *data = &buf[0];
+        std::memmove(data + pos, data + pos + n, buf.size() - pos - n);
+        buf.resize(buf.size() - n);
+    }
+
+    void replace_(size_t pos, size_t old_n, string_view_t s) {
+        if (s.size() > old_n) {
+            insert_(pos + old_n, s.size() - old_n);
+        } else if (s.size() < old_n) {
+            erase_(text_, pos + s.size(), old_n - s.size());
+        }
+        copy_(&text_[0] + pos, s);
+    }
+
+    static void copy_(char *dest, string_view_t s) {
+        if (s.size() > 0) {
+            std::memcpy(dest, s.data(), s.size());
+        }
+    }
+};
+
+}  // namespace details
+
+class SPDLOG_API mdc {
+public:
+    static void put(const std::string &key, const std::string &value) { context().put(key, value); }
+
     static std::string get(const std::string &key) {
-        auto &context = get_context();
-        auto it = context.find(key);
-        if (it != context.end()) {
-            return it->second;
+        string_view_t value;
+        if (context().get(key, value)) {
+            return std::string(value.data(), value.size());
         }
         return "";
     }
 
-    static void remove(const std::string &key) { get_context().erase(key); }
+    static void remove(const std::string &key) { context().remove(key); }
 
-    static void clear() { get_context().clear(); }
+    static void clear() { context().clear(); }
+
+    // the MDC of the current thread, valid until it's changed
+    static details::mdc_view view() { return context().view(); }
+
+    // a copy of the MDC of the current thread as a map, rebuilt on each call and valid until the
+    // next one. kept for compatibility - it's read only, change the MDC with put/remove/clear.
+    static const std::map<std::string, std::string> &get_context() {
+        static thread_local std::map<std::string, std::string> snapshot;
+        snapshot.clear();
+        auto current = view();
+        for (size_t i = 0; i < current.size(); i++) {
+            auto key = current.key(i);
+            auto value = current.value(i);
+            snapshot.emplace(std::string(key.data(), key.size()),
+                             std::string(value.data(), value.size()));
+        }
+        return snapshot;
+    }
 
-    static std::map<std::string, std::string> &get_context() {
-        static thread_local std::map<std::string, std::string> context;
+    static details::mdc_context &context() {
+        static thread_local details::mdc_context context;
         return context;
     }
 };
 
-}  // namespace spdlog
\ No newline at end of file
+}  // namespace spdlog
@@ -8,6 +8,7 @@
 #endif
 
 #include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/format_cache.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/os.h>
 #include <spdlog/mdc.h>
@@ -16,6 +17,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cassert>
 #include <cctype>
 #include <chrono>
 #include <cstring>
@@ -868,28 +870,59 @@ private:
     memory_buf_t cached_datetime_;
 };
 
+// Structured key/value fields of the message (see field.h).
+// Example: [logger-name] [info] [latency_us:123 path:/index] request done
+template <typename ScopedPadder>
+class fields_formatter final : public flag_formatter {
+public:
+    explicit fields_formatter(padding_info padinfo)
+        : flag_formatter(padinfo) {}
+
+    void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        if (!padinfo_.enabled()) {
+            append_fields(msg.fields, dest);
+            return;
+        }
+        memory_buf_t formatted;
+        append_fields(msg.fields, formatted);
+        ScopedPadder p(formatted.size(), padinfo_, dest);
+        dest.append(formatted.data(), formatted.data() + formatted.size());
+    }
+
+private:
+    static void append_fields(field_list fields, memory_buf_t &dest) {
+        for (auto &f : fields) {
+            if (&f != fields.begin()) {
+                dest.push_back(' ');
+            }
+            append_field(f, dest);
+        }
+    }
+};
+
 // Class for formatting Mapped Diagnostic Context (MDC) in log messages.
 // Example: [logger-name] [info] [mdc_key_1:mdc_value_1 mdc_key_2:mdc_value_2] some message
+// The MDC keeps its pairs rendered like this, so unless padded it's copied as is.
 template <typename ScopedPadder>
 class mdc_formatter : public flag_formatter {
 public:
     explicit mdc_formatter(padding_info padinfo)
         : flag_formatter(padinfo) {}
 
-    void format(const details::log_msg &, const std::tm &, memory_buf_t &dest) override {
-        auto mdc_map = mdc::get_context();
-        if (mdc_map.empty()) {
+    void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        auto mdc = msg.mdc();
+        if (!padinfo_.enabled()) {
+            fmt_helper::append_string_view(mdc.text(), dest);
+        } else if (mdc.empty()) {
             ScopedPadder p(0, padinfo_, dest);
-            return;
         } else {
-            auto last_element = --mdc_map.end();
-            for (auto it = mdc_map.begin(); it != mdc_map.end(); ++it) {
-                auto &pair = *it;
-                const auto &key = pair.first;
-                const auto &value = pair.second;
+            // each pair is padded
+            for (size_t i = 0; i < mdc.size(); i++) {
+                auto key = mdc.key(i);
+                auto value = mdc.value(i);
+                bool last = i + 1 == mdc.size();
                 size_t content_size = key.size() + value.size() + 1;  // 1 for ':'
-
-                if (it != last_element) {
+                if (!last) {
                     content_size++;  // 1 for ' '
                 }
 
@@ -897,7 +930,7 @@ public:
                 fmt_helper::append_string_view(key, dest);
                 fmt_helper::append_string_view(":", dest);
                 fmt_helper::append_string_view(value, dest);
-                if (it != last_element) {
+                if (!last) {
                     fmt_helper::append_string_view(" ", dest);
                 }
             }
@@ -905,31 +938,109 @@ public:
     }
 };
 
+// ops whose output only changes once per second
+static bool is_per_second_op(const pattern_op &op) {
+    switch (op.code) {
+        case pattern_op_code::weekday:
+        case pattern_op_code::weekday_full:
+        case pattern_op_code::month:
+        case pattern_op_code::month_full:
+        case pattern_op_code::datetime:
+        case pattern_op_code::year_short:
+        case pattern_op_code::year:
+        case pattern_op_code::date:
+        case pattern_op_code::month_num:
+        case pattern_op_code::day:
+        case pattern_op_code::hour24:
+        case pattern_op_code::hour12:
+        case pattern_op_code::minute:
+        case pattern_op_code::second:
+        case pattern_op_code::epoch:
+        case pattern_op_code::ampm:
+        case pattern_op_code::time12:
+        case pattern_op_code::time24_short:
+        case pattern_op_code::time24:
+            return true;
+        case pattern_op_code::object:
+            return op.flag == 'z';  // the timezone offset
+        default:
+            return false;
+    }
+}
+
+// fixed width fractions, which can be patched into a cached run
+static bool is_fraction_op(const pattern_op &op) {
+    return (op.code == pattern_op_code::millis || op.code == pattern_op_code::micros ||
+            op.code == pattern_op_code::nanos) &&
+           !op.padinfo.enabled();
+}
+
+SPDLOG_INLINE void pattern_program::add_time_runs() {
+    std::vector<pattern_op> grouped;
+    grouped.reserve(ops.size());
+    size_t i = 0;
+    while (i < ops.size()) {
+        // find the longest run of literals, fractions and per second ops starting at i
+        size_t end = i;
+        size_t per_second_n = 0;
+        while (end < ops.size() && (ops[end].code == pattern_op_code::literal ||
+                                    is_fraction_op(ops[end]) || is_per_second_op(ops[end]))) {
+            per_second_n += is_per_second_op(ops[end]) ? 1 : 0;
+            end++;
+        }
+        // worth caching only if it saves formatting more than a single op
+        if (per_second_n > 0 && end - i > 1) {
+            grouped.push_back(
+                pattern_op{pattern_op_code::time_run, 0, padding_info{}, time_runs_n++, end - i});
+        } else if (end == i) {
+            end++;
+        }
+        grouped.insert(grouped.end(), ops.begin() + static_cast<std::ptrdiff_t>(i),
+                       ops.begin() + static_cast<std::ptrdiff_t>(end));
+        i = end;
+    }
+    ops = std::move(grouped);
+}
+
 }  // namespace details
 
 SPDLOG_INLINE pattern_formatter::pattern_formatter(std::string pattern,
                                                    pattern_time_type time_type,
                                                    std::string eol,
                                                    custom_flags custom_user_flags)
-    : pattern_(std::move(pattern)),
-      eol_(std::move(eol)),
+    : eol_(std::move(eol)),
       pattern_time_type_(time_type),
       need_localtime_(false),
       last_log_secs_(0),
       custom_handlers_(std::move(custom_user_flags)) {
     std::memset(&cached_tm_, 0, sizeof(cached_tm_));
-    compile_pattern_(pattern_);
+    compile_pattern_(std::move(pattern));
 }
 
 // use by default full formatter for if pattern is not given
 SPDLOG_INLINE pattern_formatter::pattern_formatter(pattern_time_type time_type, std::string eol)
-    : pattern_("%+"),
-      eol_(std::move(eol)),
+    : eol_(std::move(eol)),
       pattern_time_type_(time_type),
       need_localtime_(true),
       last_log_secs_(0) {
     std::memset(&cached_tm_, 0, sizeof(cached_tm_));
-    formatters_.push_back(details::make_unique<details::full_formatter>(details::padding_info{}));
+    compile_pattern_("%+");
+}
+
+SPDLOG_INLINE pattern_formatter::pattern_formatter(
+    std::shared_ptr<const details::pattern_program> program,
+    pattern_time_type time_type,
+    std::string eol,
+    custom_flags custom_user_flags)
+    : program_(std::move(program)),
+      eol_(std::move(eol)),
+      pattern_time_type_(time_type),
+      need_localtime_(program_->need_localtime),
+      last_log_secs_(0),
+      custom_handlers_(std::move(custom_user_flags)) {
+    std::memset(&cached_tm_, 0, sizeof(cached_tm_));
+    make_objects_();
+    update_fingerprint_();
 }
 
 SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const {
@@ -937,8 +1048,9 @@ SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const {
     for (auto &it : custom_handlers_) {
         cloned_custom_formatters[it.first] = it.second->clone();
     }
-    auto cloned = details::make_unique<pattern_formatter>(pattern_, pattern_time_type_, eol_,
-                                                          std::move(cloned_custom_formatters));
+    // the clone shares the compiled program
+    std::unique_ptr<pattern_formatter> cloned(new pattern_formatter(
+        program_, pattern_time_type_, eol_, std::move(cloned_custom_formatters)));
     cloned->need_localtime(need_localtime_);
 #if defined(__GNUC__) && __GNUC__ < 5
     return std::move(cloned);
@@ -948,6 +1060,13 @@ SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const {
 }
 
 SPDLOG_INLINE void pattern_formatter::format(const details::log_msg &msg, memory_buf_t &dest) {
+    // reuse the output of another formatter with the same fingerprint, if it's in the cache
+    details::format_cache *cache = fingerprint_ != 0 ? details::format_cache::current() : nullptr;
+    if (cache != nullptr && cache->append_to(msg, fingerprint_, format_key_, dest)) {
+        return;
+    }
+    auto start = dest.size();
+
     if (need_localtime_) {
         const auto secs =
             std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
@@ -957,20 +1076,215 @@ SPDLOG_INLINE void pattern_formatter::format(const details::log_msg &msg, memory
         }
     }
 
-    for (auto &f : formatters_) {
-        f->format(msg, cached_tm_, dest);
+    const auto &ops = program_->ops;
+    for (size_t i = 0; i < ops.size(); i++) {
+        const auto &op = ops[i];
+        if (op.code == details::pattern_op_code::time_run) {
+            format_time_run_(&op, msg, dest);
+            i += op.size;
+        } else if (op.padinfo.enabled()) {
+            format_op_<details::scoped_padder>(op, msg, dest);
+        } else {
+            format_op_<details::null_scoped_padder>(op, msg, dest);
+        }
     }
     // write eol
     details::fmt_helper::append_string_view(eol_, dest);
+
+    if (cache != nullptr) {
+        cache->store(msg, fingerprint_, format_key_, dest, start, program_->has_color_range);
+    }
+}
+
+// render the ops of the run only when the second changes. in between, copy the cached text and
+// write the current fractions over the cached ones.
+SPDLOG_INLINE void pattern_formatter::format_time_run_(const details::pattern_op *run,
+                                                       const details::log_msg &msg,
+                                                       memory_buf_t &dest) {
+    using namespace details;
+    auto &cache = time_caches_[run->pos];
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+    if (secs != cache.secs || cache.text.size() == 0) {
+        cache.text.clear();
+        cache.fractions.clear();
+        for (auto op = run + 1; op != run + 1 + run->size; ++op) {
+            if (is_fraction_op(*op)) {
+                cache.fractions.push_back(time_run_cache::fraction{cache.text.size(), op->code});
+            }
+            if (op->padinfo.enabled()) {
+                format_op_<scoped_padder>(*op, msg, cache.text);
+            } else {
+                format_op_<null_scoped_padder>(*op, msg, cache.text);
+            }
+        }
+        cache.secs = secs;
+    }
+
+    auto start = dest.size();
+    dest.append(cache.text.data(), cache.text.data() + cache.text.size());
+    for (auto &fraction : cache.fractions) {
+        uint32_t value;
+        unsigned int digits;
+        if (fraction.code == pattern_op_code::millis) {
+            value = static_cast<uint32_t>(
+                fmt_helper::time_fraction<std::chrono::milliseconds>(msg.time).count());
+            digits = 3;
+        } else if (fraction.code == pattern_op_code::micros) {
+            value = static_cast<uint32_t>(
+                fmt_helper::time_fraction<std::chrono::microseconds>(msg.time).count());
+            digits = 6;
+        } else {
+            value = static_cast<uint32_t>(
+                fmt_helper::time_fraction<std::chrono::nanoseconds>(msg.time).count());
+            digits = 9;
+        }
+        fmt_helper::write_padded(value, digits, dest.data() + start + fraction.offset);
+    }
+}
+
+// the formatters of the flags are constructed on the stack. their type is known, so the
+// compiler can call (and inline) their format() without virtual dispatch.
+template <typename Padder>
+SPDLOG_INLINE void pattern_formatter::format_op_(const details::pattern_op &op,
+                                                 const details::log_msg &msg,
+                                                 memory_buf_t &dest) {
+    using namespace details;
+    const auto &tm_time = cached_tm_;
+    const auto &padinfo = op.padinfo;
+    switch (op.code) {
+        case pattern_op_code::literal: {
+            const char *literals = program_->literals.data();
+            dest.append(literals + op.pos, literals + op.pos + op.size);
+            break;
+        }
+        case pattern_op_code::object:
+            objects_[op.pos]->format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::name:
+            name_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::level:
+            level_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::short_level:
+            short_level_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::thread_id:
+            t_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::payload:
+            v_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::weekday:
+            a_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::weekday_full:
+            A_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::month:
+            b_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::month_full:
+            B_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::datetime:
+            c_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::year_short:
+            C_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::year:
+            Y_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::date:
+            D_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::month_num:
+            m_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::day:
+            d_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::hour24:
+            H_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::hour12:
+            I_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::minute:
+            M_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::second:
+            S_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::millis:
+            e_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::micros:
+            f_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::nanos:
+            F_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::epoch:
+            E_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::ampm:
+            p_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::time12:
+            r_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::time24_short:
+            R_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::time24:
+            T_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::pid:
+            pid_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::color_start:
+            color_start_formatter(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::color_stop:
+            color_stop_formatter(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::source_location:
+            source_location_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::short_filename:
+            short_filename_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::source_filename:
+            source_filename_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::source_linenum:
+            source_linenum_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::source_funcname:
+            source_funcname_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::mdc:
+            mdc_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::fields:
+            fields_formatter<Padder>(padinfo).format(msg, tm_time, dest);
+            break;
+        case pattern_op_code::time_run:
+            break;  // handled by format()
+    }
 }
 
 SPDLOG_INLINE void pattern_formatter::set_pattern(std::string pattern) {
-    pattern_ = std::move(pattern);
     need_localtime_ = false;
-    compile_pattern_(pattern_);
+    compile_pattern_(std::move(pattern));
 }
 
-SPDLOG_INLINE void pattern_formatter::need_localtime(bool need) { need_localtime_ = need; }
+SPDLOG_INLINE void pattern_formatter::need_localtime(bool need) {
+    need_localtime_ = need;
+    update_fingerprint_();
+}
 
 SPDLOG_INLINE std::tm pattern_formatter::get_time_(const details::log_msg &msg) {
     if (pattern_time_type_ == pattern_time_type::local) {
@@ -979,251 +1293,247 @@ SPDLOG_INLINE std::tm pattern_formatter::get_time_(const details::log_msg &msg)
     return details::os::gmtime(log_clock::to_time_t(msg.time));
 }
 
-template <typename Padder>
-SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_info padding) {
+SPDLOG_INLINE void pattern_formatter::handle_flag_(details::pattern_program &program,
+                                                   char flag,
+                                                   details::padding_info padding) {
+    using details::pattern_op_code;
+    auto add_op = [&](pattern_op_code code) { program.add_op(code, flag, padding); };
+    auto add_time_op = [&](pattern_op_code code) {
+        add_op(code);
+        program.need_localtime = true;
+    };
+
     // process custom flags
-    auto it = custom_handlers_.find(flag);
-    if (it != custom_handlers_.end()) {
-        auto custom_handler = it->second->clone();
-        custom_handler->set_padding_info(padding);
-        formatters_.push_back(std::move(custom_handler));
+    if (custom_handlers_.find(flag) != custom_handlers_.end()) {
+        add_op(pattern_op_code::object);
         return;
     }
 
     // process built-in flags
     switch (flag) {
         case ('+'):  // default formatter
-            formatters_.push_back(details::make_unique<details::full_formatter>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::object);
             break;
 
         case 'n':  // logger name
-            formatters_.push_back(details::make_unique<details::name_formatter<Padder>>(padding));
+            add_op(pattern_op_code::name);
             break;
 
         case 'l':  // level
-            formatters_.push_back(details::make_unique<details::level_formatter<Padder>>(padding));
+            add_op(pattern_op_code::level);
             break;
 
         case 'L':  // short level
-            formatters_.push_back(
-                details::make_unique<details::short_level_formatter<Padder>>(padding));
+            add_op(pattern_op_code::short_level);
             break;
 
         case ('t'):  // thread id
-            formatters_.push_back(details::make_unique<details::t_formatter<Padder>>(padding));
+            add_op(pattern_op_code::thread_id);
             break;
 
         case ('v'):  // the message text
-            formatters_.push_back(details::make_unique<details::v_formatter<Padder>>(padding));
+            add_op(pattern_op_code::payload);
             break;
 
         case ('a'):  // weekday
-            formatters_.push_back(details::make_unique<details::a_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::weekday);
             break;
 
         case ('A'):  // short weekday
-            formatters_.push_back(details::make_unique<details::A_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::weekday_full);
             break;
 
         case ('b'):
         case ('h'):  // month
-            formatters_.push_back(details::make_unique<details::b_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::month);
             break;
 
         case ('B'):  // short month
-            formatters_.push_back(details::make_unique<details::B_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::month_full);
             break;
 
         case ('c'):  // datetime
-            formatters_.push_back(details::make_unique<details::c_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::datetime);
             break;
 
         case ('C'):  // year 2 digits
-            formatters_.push_back(details::make_unique<details::C_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::year_short);
             break;
 
         case ('Y'):  // year 4 digits
-            formatters_.push_back(details::make_unique<details::Y_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::year);
             break;
 
         case ('D'):
         case ('x'):  // datetime MM/DD/YY
-            formatters_.push_back(details::make_unique<details::D_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::date);
             break;
 
         case ('m'):  // month 1-12
-            formatters_.push_back(details::make_unique<details::m_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::month_num);
             break;
 
         case ('d'):  // day of month 1-31
-            formatters_.push_back(details::make_unique<details::d_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::day);
             break;
 
         case ('H'):  // hours 24
-            formatters_.push_back(details::make_unique<details::H_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::hour24);
             break;
 
         case ('I'):  // hours 12
-            formatters_.push_back(details::make_unique<details::I_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::hour12);
             break;
 
         case ('M'):  // minutes
-            formatters_.push_back(details::make_unique<details::M_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::minute);
             break;
 
         case ('S'):  // seconds
-            formatters_.push_back(details::make_unique<details::S_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::second);
             break;
 
         case ('e'):  // milliseconds
-            formatters_.push_back(details::make_unique<details::e_formatter<Padder>>(padding));
+            add_op(pattern_op_code::millis);
             break;
 
         case ('f'):  // microseconds
-            formatters_.push_back(details::make_unique<details::f_formatter<Padder>>(padding));
+            add_op(pattern_op_code::micros);
             break;
 
         case ('F'):  // nanoseconds
-            formatters_.push_back(details::make_unique<details::F_formatter<Padder>>(padding));
+            add_op(pattern_op_code::nanos);
             break;
 
         case ('E'):  // seconds since epoch
-            formatters_.push_back(details::make_unique<details::E_formatter<Padder>>(padding));
+            add_op(pattern_op_code::epoch);
             break;
 
         case ('p'):  // am/pm
-            formatters_.push_back(details::make_unique<details::p_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::ampm);
             break;
 
         case ('r'):  // 12 hour clock 02:55:02 pm
-            formatters_.push_back(details::make_unique<details::r_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::time12);
             break;
 
         case ('R'):  // 24-hour HH:MM time
-            formatters_.push_back(details::make_unique<details::R_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::time24_short);
             break;
 
         case ('T'):
         case ('X'):  // ISO 8601 time format (HH:MM:SS)
-            formatters_.push_back(details::make_unique<details::T_formatter<Padder>>(padding));
-            need_localtime_ = true;
+            add_time_op(pattern_op_code::time24);
             break;
 
-        case ('z'):  // timezone
-            formatters_.push_back(details::make_unique<details::z_formatter<Padder>>(padding));
-            need_localtime_ = true;
+        case ('z'):  // timezone (caches the offset)
+            add_time_op(pattern_op_code::object);
             break;
 
         case ('P'):  // pid
-            formatters_.push_back(details::make_unique<details::pid_formatter<Padder>>(padding));
+            add_op(pattern_op_code::pid);
             break;
 
         case ('^'):  // color range start
-            formatters_.push_back(details::make_unique<details::color_start_formatter>(padding));
+            add_op(pattern_op_code::color_start);
             break;
 
         case ('$'):  // color range end
-            formatters_.push_back(details::make_unique<details::color_stop_formatter>(padding));
+            add_op(pattern_op_code::color_stop);
             break;
 
         case ('@'):  // source location (filename:filenumber)
-            formatters_.push_back(
-                details::make_unique<details::source_location_formatter<Padder>>(padding));
+            add_op(pattern_op_code::source_location);
             break;
 
         case ('s'):  // short source filename - without directory name
-            formatters_.push_back(
-                details::make_unique<details::short_filename_formatter<Padder>>(padding));
+            add_op(pattern_op_code::short_filename);
             break;
 
         case ('g'):  // full source filename
-            formatters_.push_back(
-                details::make_unique<details::source_filename_formatter<Padder>>(padding));
+            add_op(pattern_op_code::source_filename);
             break;
 
         case ('#'):  // source line number
-            formatters_.push_back(
-                details::make_unique<details::source_linenum_formatter<Padder>>(padding));
+            add_op(pattern_op_code::source_linenum);
             break;
 
         case ('!'):  // source funcname
-            formatters_.push_back(
-                details::make_unique<details::source_funcname_formatter<Padder>>(padding));
+            add_op(pattern_op_code::source_funcname);
             break;
 
         case ('%'):  // % char
-            formatters_.push_back(details::make_unique<details::ch_formatter>('%'));
+            program.add_literal('%');
             break;
 
         case ('u'):  // elapsed time since last log message in nanos
-            formatters_.push_back(
-                details::make_unique<details::elapsed_formatter<Padder, std::chrono::nanoseconds>>(
-                    padding));
-            break;
-
         case ('i'):  // elapsed time since last log message in micros
-            formatters_.push_back(
-                details::make_unique<details::elapsed_formatter<Padder, std::chrono::microseconds>>(
-                    padding));
-            break;
-
         case ('o'):  // elapsed time since last log message in millis
-            formatters_.push_back(
-                details::make_unique<details::elapsed_formatter<Padder, std::chrono::milliseconds>>(
-                    padding));
-            break;
-
         case ('O'):  // elapsed time since last log message in seconds
-            formatters_.push_back(
-                details::make_unique<details::elapsed_formatter<Padder, std::chrono::seconds>>(
-                    padding));
+            add_op(pattern_op_code::object);
             break;
 
         case ('&'):
-            formatters_.push_back(details::make_unique<details::mdc_formatter<Padder>>(padding));
+            add_op(pattern_op_code::mdc);
             break;
 
-        default:  // Unknown flag appears as is
-            auto unknown_flag = details::make_unique<details::aggregate_formatter>();
+        case ('k'):  // structured key/value fields of the message
+            add_op(pattern_op_code::fields);
+            break;
 
+        default:  // Unknown flag appears as is
             if (!padding.truncate_) {
-                unknown_flag->add_ch('%');
-                unknown_flag->add_ch(flag);
-                formatters_.push_back((std::move(unknown_flag)));
+                program.add_literal('%');
+                program.add_literal(flag);
             }
             // fix issue #1617 (prev char was '!' and should have been treated as funcname flag
             // instead of truncating flag) spdlog::set_pattern("[%10!] %v") => "[      main] some
             // message" spdlog::set_pattern("[%3!!] %v") => "[mai] some message"
             else {
                 padding.truncate_ = false;
-                formatters_.push_back(
-                    details::make_unique<details::source_funcname_formatter<Padder>>(padding));
-                unknown_flag->add_ch(flag);
-                formatters_.push_back((std::move(unknown_flag)));
+                add_op(pattern_op_code::source_funcname);
+                program.add_literal(flag);
             }
 
             break;
     }
 }
 
+template <typename Padder>
+SPDLOG_INLINE std::unique_ptr<details::flag_formatter> pattern_formatter::make_object_(
+    char flag, details::padding_info padding) {
+    auto it = custom_handlers_.find(flag);
+    if (it != custom_handlers_.end()) {
+        auto custom_handler = it->second->clone();
+        custom_handler->set_padding_info(padding);
+#if defined(__GNUC__) && __GNUC__ < 5
+        return std::move(custom_handler);
+#else
+        return custom_handler;
+#endif
+    }
+
+    switch (flag) {
+        case ('+'):
+            return details::make_unique<details::full_formatter>(padding);
+        case ('z'):
+            return details::make_unique<details::z_formatter<Padder>>(padding);
+        case ('u'):
+            return details::make_unique<
+                details::elapsed_formatter<Padder, std::chrono::nanoseconds>>(padding);
+        case ('i'):
+            return details::make_unique<
+                details::elapsed_formatter<Padder, std::chrono::microseconds>>(padding);
+        case ('o'):
+            return details::make_unique<
+                details::elapsed_formatter<Padder, std::chrono::milliseconds>>(padding);
+        default:
+            assert(flag == 'O');
+            return details::make_unique<details::elapsed_formatter<Padder, std::chrono::seconds>>(
+                padding);
+    }
+}
+
 // Extract given pad spec (e.g. %8X, %=8X, %-8!X, %8!X, %=8!X, %-8!X, %+8!X)
 // Advance the given it pass the end of the padding spec found (if any)
 // Return padding.
@@ -1272,39 +1582,76 @@ SPDLOG_INLINE details::padding_info pattern_formatter::handle_padspec_(
     return details::padding_info{std::min<size_t>(width, max_width), side, truncate};
 }
 
-SPDLOG_INLINE void pattern_formatter::compile_pattern_(const std::string &pattern) {
-    auto end = pattern.end();
-    std::unique_ptr<details::aggregate_formatter> user_chars;
-    formatters_.clear();
-    for (auto it = pattern.begin(); it != end; ++it) {
+SPDLOG_INLINE void pattern_formatter::compile_pattern_(std::string pattern) {
+    auto program = std::make_shared<details::pattern_program>();
+    program->pattern = std::move(pattern);
+    auto end = program->pattern.cend();
+    for (auto it = program->pattern.cbegin(); it != end; ++it) {
         if (*it == '%') {
-            if (user_chars)  // append user chars found so far
-            {
-                formatters_.push_back(std::move(user_chars));
-            }
-
             auto padding = handle_padspec_(++it, end);
 
             if (it != end) {
-                if (padding.enabled()) {
-                    handle_flag_<details::scoped_padder>(*it, padding);
-                } else {
-                    handle_flag_<details::null_scoped_padder>(*it, padding);
-                }
+                handle_flag_(*program, *it, padding);
             } else {
                 break;
             }
         } else  // chars not following the % sign should be displayed as is
         {
-            if (!user_chars) {
-                user_chars = details::make_unique<details::aggregate_formatter>();
-            }
-            user_chars->add_ch(*it);
+            program->add_literal(*it);
         }
     }
-    if (user_chars)  // append raw chars found so far
-    {
-        formatters_.push_back(std::move(user_chars));
+    program->add_literal_op();
+    program->add_time_runs();
+    for (auto &op : program->ops) {
+        // the other objects (%i, %u, %o, %O and custom flags) have per formatter state
+        if (op.code == details::pattern_op_code::object && op.flag != '+' && op.flag != 'z') {
+            program->shareable = false;
+        }
+        if (op.code == details::pattern_op_code::color_start ||
+            op.code == details::pattern_op_code::color_stop ||
+            (op.code == details::pattern_op_code::object && op.flag == '+')) {
+            program->has_color_range = true;
+        }
+    }
+
+    need_localtime_ = need_localtime_ || program->need_localtime;
+    program_ = std::move(program);
+    make_objects_();
+    update_fingerprint_();
+}
+
+// the key of everything the output depends on besides the message, and its FNV-1a hash
+// (see format_cache)
+SPDLOG_INLINE void pattern_formatter::update_fingerprint_() {
+    fingerprint_ = 0;
+    format_key_.clear();
+    // with need_localtime(false) the time flags show the time of this formatter's last update
+    if (!program_->shareable || (program_->need_localtime && !need_localtime_)) {
+        return;
+    }
+    format_key_.append(program_->pattern.c_str(), program_->pattern.size() + 1);
+    format_key_.append(eol_.c_str(), eol_.size() + 1);
+    format_key_.push_back(static_cast<char>(pattern_time_type_));
+    uint64_t hash = 14695981039346656037ULL;
+    for (char ch : format_key_) {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+    }
+    fingerprint_ = hash != 0 ? hash : 1;
+}
+
+SPDLOG_INLINE void pattern_formatter::make_objects_() {
+    objects_.clear();
+    for (auto &op : program_->ops) {
+        if (op.code != details::pattern_op_code::object) {
+            continue;
+        }
+        if (op.padinfo.enabled()) {
+            objects_.push_back(make_object_<details::scoped_padder>(op.flag, op.padinfo));
+        } else {
+            objects_.push_back(make_object_<details::null_scoped_padder>(op.flag, op.padinfo));
+        }
     }
+    time_caches_.clear();
+    time_caches_.resize(program_->time_runs_n);
 }
 }  // namespace spdlog
@@ -51,6 +51,107 @@ protected:
     padding_info padinfo_;
 };
 
+// a pattern compiled to a flat program of ops (see pattern_formatter::compile_pattern_()).
+// flags whose formatter keeps state (e.g. %z, %i) and custom flags are formatted by flag_formatter
+// objects owned by each pattern_formatter (object ops). the other ops hold all they need.
+enum class pattern_op_code : unsigned char {
+    literal,   // text [pos, pos + size) of the program's literals
+    object,    // objects_[pos] of the pattern_formatter
+    time_run,  // the next size ops, rendered once per second into time_caches_[pos]
+    name,
+    level,
+    short_level,
+    thread_id,
+    payload,
+    weekday,
+    weekday_full,
+    month,
+    month_full,
+    datetime,
+    year_short,
+    year,
+    date,
+    month_num,
+    day,
+    hour24,
+    hour12,
+    minute,
+    second,
+    millis,
+    micros,
+    nanos,
+    epoch,
+    ampm,
+    time12,
+    time24_short,
+    time24,
+    pid,
+    color_start,
+    color_stop,
+    source_location,
+    short_filename,
+    source_filename,
+    source_linenum,
+    source_funcname,
+    mdc,
+    fields
+};
+
+struct pattern_op {
+    pattern_op_code code;
+    char flag;  // the flag of object ops, which each formatter instantiates its objects from
+    padding_info padinfo;
+    size_t pos;
+    size_t size;
+};
+
+// immutable once compiled. shared by the clones of a pattern_formatter.
+struct pattern_program {
+    std::string pattern;
+    std::string literals;
+    std::vector<pattern_op> ops;
+    size_t objects_n = 0;    // number of object ops
+    size_t time_runs_n = 0;  // number of time_run ops
+    bool need_localtime = false;
+    bool shareable = true;  // the output only depends on the message (see format_cache)
+    bool has_color_range = false;
+
+    // used while compiling
+    void add_literal(char ch) { literals.push_back(ch); }
+
+    void add_op(pattern_op_code code, char flag, padding_info padinfo) {
+        add_literal_op();
+        size_t pos = code == pattern_op_code::object ? objects_n++ : 0;
+        ops.push_back(pattern_op{code, flag, padinfo, pos, 0});
+    }
+
+    // emit a single op for the literals added since the last op
+    void add_literal_op() {
+        if (literals.size() > literals_emitted) {
+            ops.push_back(pattern_op{pattern_op_code::literal, 0, padding_info{}, literals_emitted,
+                                     literals.size() - literals_emitted});
+            literals_emitted = literals.size();
+        }
+    }
+
+    // group each run of date/time ops (and the literals between them) under a time_run op
+    void add_time_runs();
+
+private:
+    size_t literals_emitted = 0;
+};
+
+// the last rendering of a time_run. the sub-second fractions are patched in place per message.
+struct time_run_cache {
+    struct fraction {
+        size_t offset;  // in text
+        pattern_op_code code;
+    };
+    memory_buf_t text;
+    std::vector<fraction> fractions;
+    std::chrono::seconds secs{0};
+};
+
 }  // namespace details
 
 class SPDLOG_API custom_flag_formatter : public details::flag_formatter {
@@ -80,6 +181,7 @@ public:
 
     std::unique_ptr<formatter> clone() const override;
     void format(const details::log_msg &msg, memory_buf_t &dest) override;
+    uint64_t fingerprint() const override { return fingerprint_; }
 
     template <typename T, typename... Args>
     pattern_formatter &add_flag(char flag, Args &&...args) {
@@ -90,18 +192,32 @@ public:
     void need_localtime(bool need = true);
 
 private:
-    std::string pattern_;
+    pattern_formatter(std::shared_ptr<const details::pattern_program> program,
+                      pattern_time_type time_type,
+                      std::string eol,
+                      custom_flags custom_user_flags);
+
+    std::shared_ptr<const details::pattern_program> program_;
     std::string eol_;
     pattern_time_type pattern_time_type_;
     bool need_localtime_;
     std::tm cached_tm_;
     std::chrono::seconds last_log_secs_;
-    std::vector<std::unique_ptr<details::flag_formatter>> formatters_;
+    std::vector<std::unique_ptr<details::flag_formatter>> objects_;  // of the object ops
+    std::vector<details::time_run_cache> time_caches_;                // of the time_run ops
     custom_flags custom_handlers_;
+    uint64_t fingerprint_ = 0;  // of the output, to share it with other formatters. 0 - not shared
+    std::string format_key_;    // pattern, eol and time type - what fingerprint_ hashes
 
     std::tm get_time_(const details::log_msg &msg);
+    void handle_flag_(details::pattern_program &program, char flag, details::padding_info padding);
+    template <typename Padder>
+    std::unique_ptr<details::flag_formatter> make_object_(char flag, details::padding_info padding);
     template <typename Padder>
-    void handle_flag_(char flag, details::padding_info padding);
+    void format_op_(const details::pattern_op &op, const details::log_msg &msg, memory_buf_t &dest);
+    void format_time_run_(const details::pattern_op *run,
+                          const details::log_msg &msg,
+                          memory_buf_t &dest);
 
     // Extract given pad spec (e.g. %8X)
     // Advance the given it pass the end of the padding spec found (if any)
@@ -109,7 +225,10 @@ private:
     static details::padding_info handle_padspec_(std::string::const_iterator &it,
                                                  std::string::const_iterator end);
 
-    void compile_pattern_(const std::string &pattern);
+    void compile_pattern_(std::string pattern);
+    // create the objects of the program's object ops and the caches of its time_run ops
+    void make_objects_();
+    void update_fingerprint_();
 };
 }  // namespace spdlog
 
@@ -20,6 +20,7 @@ SPDLOG_INLINE ansicolor_sink<ConsoleMutex>::ansicolor_sink(FILE *target_file, co
       formatter_(details::make_unique<spdlog::pattern_formatter>())
 
 {
+    format_fingerprint_.store(formatter_->fingerprint(), std::memory_order_relaxed);
     set_color_mode(mode);
     colors_.at(level::trace) = to_string_(white);
     colors_.at(level::debug) = to_string_(cyan);
@@ -72,6 +73,7 @@ template <typename ConsoleMutex>
 SPDLOG_INLINE void ansicolor_sink<ConsoleMutex>::set_pattern(const std::string &pattern) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::unique_ptr<spdlog::formatter>(new pattern_formatter(pattern));
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 template <typename ConsoleMutex>
@@ -79,6 +81,7 @@ SPDLOG_INLINE void ansicolor_sink<ConsoleMutex>::set_formatter(
     std::unique_ptr<spdlog::formatter> sink_formatter) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::move(sink_formatter);
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 template <typename ConsoleMutex>
@@ -15,12 +15,18 @@
 
 template <typename Mutex>
 SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::base_sink()
-    : formatter_{details::make_unique<spdlog::pattern_formatter>()} {}
+    : formatter_{details::make_unique<spdlog::pattern_formatter>()} {
+    format_fingerprint_.store(formatter_->fingerprint(), std::memory_order_relaxed);
+}
 
 template <typename Mutex>
 SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::base_sink(
     std::unique_ptr<spdlog::formatter> formatter)
-    : formatter_{std::move(formatter)} {}
+    : formatter_{std::move(formatter)} {
+    if (formatter_) {
+        format_fingerprint_.store(formatter_->fingerprint(), std::memory_order_relaxed);
+    }
+}
 
 template <typename Mutex>
 void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::log(const details::log_msg &msg) {
@@ -28,6 +34,13 @@ void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::log(const details::log_msg &
     sink_it_(msg);
 }
 
+template <typename Mutex>
+void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::log_batch(const details::log_msg *msgs,
+                                                              size_t count) {
+    std::lock_guard<Mutex> lock(mutex_);
+    sink_batch_(msgs, count);
+}
+
 template <typename Mutex>
 void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::flush() {
     std::lock_guard<Mutex> lock(mutex_);
@@ -47,6 +60,16 @@ spdlog::sinks::base_sink<Mutex>::set_formatter(std::unique_ptr<spdlog::formatter
     set_formatter_(std::move(sink_formatter));
 }
 
+template <typename Mutex>
+void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::sink_batch_(const details::log_msg *msgs,
+                                                                size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (this->should_log(msgs[i].level)) {
+            sink_it_(msgs[i]);
+        }
+    }
+}
+
 template <typename Mutex>
 void SPDLOG_INLINE spdlog::sinks::base_sink<Mutex>::set_pattern_(const std::string &pattern) {
     set_formatter_(details::make_unique<spdlog::pattern_formatter>(pattern));
@@ -56,4 +79,5 @@ template <typename Mutex>
 void SPDLOG_INLINE
 spdlog::sinks::base_sink<Mutex>::set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter) {
     formatter_ = std::move(sink_formatter);
+    update_format_fingerprint_(formatter_->fingerprint());
 }
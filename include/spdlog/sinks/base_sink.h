@@ -4,7 +4,8 @@
 #pragma once
 //
 // base sink templated over a mutex (either dummy or real)
-// concrete implementation should override the sink_it_() and flush_()  methods.
+// concrete implementation should override the sink_it_() and flush_()  methods,
+// and optionally sink_batch_() to handle a range of messages at once.
 // locking is taken care of in this class - no locking needed by the
 // implementers..
 //
@@ -29,6 +30,7 @@ public:
     base_sink &operator=(base_sink &&) = delete;
 
     void log(const details::log_msg &msg) final;
+    void log_batch(const details::log_msg *msgs, size_t count) final;
     void flush() final;
     void set_pattern(const std::string &pattern) final;
     void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) final;
@@ -39,6 +41,9 @@ protected:
     Mutex mutex_;
 
     virtual void sink_it_(const details::log_msg &msg) = 0;
+    // called with the mutex held. implementers should skip messages for which
+    // should_log() is false. the default implementation calls sink_it_() for each message.
+    virtual void sink_batch_(const details::log_msg *msgs, size_t count);
     virtual void flush_() = 0;
     virtual void set_pattern_(const std::string &pattern);
     virtual void set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter);
@@ -33,6 +33,21 @@ SPDLOG_INLINE void basic_file_sink<Mutex>::sink_it_(const details::log_msg &msg)
     file_helper_.write(formatted);
 }
 
+// format the whole batch into one buffer and write it at once
+template <typename Mutex>
+SPDLOG_INLINE void basic_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs,
+                                                       size_t count) {
+    memory_buf_t formatted;
+    for (size_t i = 0; i < count; i++) {
+        if (this->should_log(msgs[i].level)) {
+            base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+        }
+    }
+    if (formatted.size() > 0) {
+        file_helper_.write(formatted);
+    }
+}
+
 template <typename Mutex>
 SPDLOG_INLINE void basic_file_sink<Mutex>::flush_() {
     file_helper_.flush();
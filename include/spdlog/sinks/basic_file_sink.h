@@ -26,6 +26,7 @@ public:
 
 protected:
     void sink_it_(const details::log_msg &msg) override;
+    void sink_batch_(const details::log_msg *msgs, size_t count) override;
     void flush_() override;
 
 private:
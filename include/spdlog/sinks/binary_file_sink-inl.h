@@ -0,0 +1,78 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+    #include <spdlog/sinks/binary_file_sink.h>
+#endif
+
+#include <spdlog/common.h>
+
+namespace spdlog {
+namespace sinks {
+
+// every opening of the file starts a new session (the file may be appended to)
+template <typename Mutex>
+SPDLOG_INLINE binary_file_sink<Mutex>::binary_file_sink(const filename_t &filename,
+                                                        bool truncate,
+                                                        const file_event_handlers &event_handlers)
+    : file_helper_{event_handlers} {
+    this->format_fingerprint_.store(0, std::memory_order_relaxed);  // the formatter is not used
+    file_helper_.open(filename, truncate);
+    encoder_.begin_session(buffer_);
+    write_buffer_();
+}
+
+template <typename Mutex>
+SPDLOG_INLINE const filename_t &binary_file_sink<Mutex>::filename() const {
+    return file_helper_.filename();
+}
+
+template <typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::sink_it_(const details::log_msg &msg) {
+    begin_buffer_();
+    encoder_.encode(msg, buffer_);
+    write_buffer_();
+}
+
+template <typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs,
+                                                        size_t count) {
+    begin_buffer_();
+    size_t empty_size = buffer_.size();
+    for (size_t i = 0; i < count; i++) {
+        if (this->should_log(msgs[i].level)) {
+            encoder_.encode(msgs[i], buffer_);
+        }
+    }
+    if (buffer_.size() > empty_size) {
+        write_buffer_();
+    }
+}
+
+// after a failed write, the string frames the encoder counts as written may be missing from the
+// file - restart the dictionary with a new session
+template <typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::begin_buffer_() {
+    buffer_.clear();
+    if (!in_session_) {
+        encoder_.begin_session(buffer_);
+    }
+}
+
+// throws on failure, leaving in_session_ false
+template <typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::write_buffer_() {
+    in_session_ = false;
+    file_helper_.write(buffer_);
+    in_session_ = true;
+}
+
+template <typename Mutex>
+SPDLOG_INLINE void binary_file_sink<Mutex>::flush_() {
+    file_helper_.flush();
+}
+
+}  // namespace sinks
+}  // namespace spdlog
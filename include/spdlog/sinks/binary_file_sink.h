@@ -0,0 +1,78 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/details/binary_format.h>
+#include <spdlog/details/file_helper.h>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/details/synchronous_factory.h>
+#include <spdlog/sinks/base_sink.h>
+
+#include <mutex>
+#include <string>
+
+namespace spdlog {
+namespace sinks {
+/*
+ * File sink writing the messages unformatted, in the compact binary format of
+ * details/binary_format.h: raw time, level, thread id, logger name, source location, fields
+ * and payload. The formatter is not used - the file is turned back to text, with any pattern,
+ * by the spdlog-decode tool (or details::binary_reader).
+ * The strings dictionary of the encoder lives as long as the sink (or until a failed write),
+ * so it grows without bound if the logger names or field keys are made up at run time.
+ */
+template <typename Mutex>
+class binary_file_sink final : public base_sink<Mutex> {
+public:
+    explicit binary_file_sink(const filename_t &filename,
+                              bool truncate = false,
+                              const file_event_handlers &event_handlers = {});
+    const filename_t &filename() const;
+
+protected:
+    void sink_it_(const details::log_msg &msg) override;
+    void sink_batch_(const details::log_msg *msgs, size_t count) override;
+    void flush_() override;
+
+private:
+    details::file_helper file_helper_;
+    details::binary_encoder encoder_;
+    memory_buf_t buffer_;
+    bool in_session_ = false;  // false after a failed write
+
+    void begin_buffer_();
+    void write_buffer_();
+};
+
+using binary_file_sink_mt = binary_file_sink<std::mutex>;
+using binary_file_sink_st = binary_file_sink<details::null_mutex>;
+
+}  // namespace sinks
+
+//
+// factory functions
+//
+template <typename Factory = spdlog::synchronous_factory>
+inline std::shared_ptr<logger> binary_logger_mt(const std::string &logger_name,
+                                                const filename_t &filename,
+                                                bool truncate = false,
+                                                const file_event_handlers &event_handlers = {}) {
+    return Factory::template create<sinks::binary_file_sink_mt>(logger_name, filename, truncate,
+                                                                event_handlers);
+}
+
+template <typename Factory = spdlog::synchronous_factory>
+inline std::shared_ptr<logger> binary_logger_st(const std::string &logger_name,
+                                                const filename_t &filename,
+                                                bool truncate = false,
+                                                const file_event_handlers &event_handlers = {}) {
+    return Factory::template create<sinks::binary_file_sink_st>(logger_name, filename, truncate,
+                                                                event_handlers);
+}
+
+}  // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+    #include "binary_file_sink-inl.h"
+#endif
@@ -119,6 +119,41 @@ protected:
         }
     }
 
+    // collect the formatted messages and write them at once.
+    // on rotation, what was collected so far is written to the previous file.
+    void sink_batch_(const details::log_msg *msgs, size_t count) override {
+        memory_buf_t formatted;
+        bool rotated = false;
+        for (size_t i = 0; i < count; i++) {
+            if (!this->should_log(msgs[i].level)) {
+                continue;
+            }
+            auto time = msgs[i].time;
+            if (time >= rotation_tp_) {
+                if (formatted.size() > 0) {
+                    file_helper_.write(formatted);
+                    formatted.clear();
+                }
+                if (rotated && max_files_ > 0) {
+                    delete_old_();
+                }
+                auto filename = FileNameCalc::calc_filename(base_filename_, now_tm(time));
+                file_helper_.open(filename, truncate_);
+                rotation_tp_ = next_rotation_tp_();
+                rotated = true;
+            }
+            base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+        }
+        if (formatted.size() > 0) {
+            file_helper_.write(formatted);
+        }
+
+        // Do the cleaning only at the end because it might throw on failure.
+        if (rotated && max_files_ > 0) {
+            delete_old_();
+        }
+    }
+
     void flush_() override { file_helper_.flush(); }
 
 private:
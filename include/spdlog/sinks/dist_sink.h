@@ -4,6 +4,7 @@
 #pragma once
 
 #include "base_sink.h"
+#include <spdlog/details/format_cache.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/null_mutex.h>
 #include <spdlog/pattern_formatter.h>
@@ -22,9 +23,12 @@ namespace sinks {
 template <typename Mutex>
 class dist_sink : public base_sink<Mutex> {
 public:
-    dist_sink() = default;
+    // the sub sinks format the messages - the dist_sink has no fingerprint of its own
+    dist_sink() { this->format_fingerprint_.store(0, std::memory_order_relaxed); }
     explicit dist_sink(std::vector<std::shared_ptr<sink>> sinks)
-        : sinks_(sinks) {}
+        : sinks_(sinks) {
+        this->format_fingerprint_.store(0, std::memory_order_relaxed);
+    }
 
     dist_sink(const dist_sink &) = delete;
     dist_sink &operator=(const dist_sink &) = delete;
@@ -32,22 +36,33 @@ public:
     void add_sink(std::shared_ptr<sink> sub_sink) {
         std::lock_guard<Mutex> lock(base_sink<Mutex>::mutex_);
         sinks_.push_back(sub_sink);
+        sinks_fingerprint_.invalidate();
     }
 
     void remove_sink(std::shared_ptr<sink> sub_sink) {
         std::lock_guard<Mutex> lock(base_sink<Mutex>::mutex_);
         sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sub_sink), sinks_.end());
+        sinks_fingerprint_.invalidate();
     }
 
     void set_sinks(std::vector<std::shared_ptr<sink>> sinks) {
         std::lock_guard<Mutex> lock(base_sink<Mutex>::mutex_);
         sinks_ = std::move(sinks);
+        sinks_fingerprint_.invalidate();
     }
 
-    std::vector<std::shared_ptr<sink>> &sinks() { return sinks_; }
+    // the caller may change the sub sinks - find their shared fingerprint again
+    std::vector<std::shared_ptr<sink>> &sinks() {
+        sinks_fingerprint_.invalidate();
+        return sinks_;
+    }
 
 protected:
     void sink_it_(const details::log_msg &msg) override {
+        // sub sinks with the same pattern format the message once
+        auto fingerprint = sinks_fingerprint_.get(sinks_);
+        details::format_cache cache(&msg, fingerprint != 0 ? 1 : 0, fingerprint);
+        details::format_cache::scope cache_scope(cache);
         for (auto &sub_sink : sinks_) {
             if (sub_sink->should_log(msg.level)) {
                 sub_sink->log(msg);
@@ -72,6 +87,7 @@ protected:
         }
     }
     std::vector<std::shared_ptr<sink>> sinks_;
+    details::sinks_fingerprint sinks_fingerprint_;
 };
 
 using dist_sink_mt = dist_sink<std::mutex>;
@@ -5,6 +5,7 @@
 
 #include "spdlog/details/circular_q.h"
 #include "spdlog/details/log_msg_buffer.h"
+#include "spdlog/details/memory_budget.h"
 #include "spdlog/details/null_mutex.h"
 #include "spdlog/sinks/base_sink.h"
 
@@ -51,12 +52,13 @@ public:
 
 protected:
     void sink_it_(const details::log_msg &msg) override {
-        q_.push_back(details::log_msg_buffer{msg});
+        details::push_charged(q_, charge_, msg);
     }
     void flush_() override {}
 
 private:
     details::circular_q<details::log_msg_buffer> q_;
+    details::memory_charge charge_;  // the bytes of q_ (see details::memory_budget::global())
 };
 
 using ringbuffer_sink_mt = ringbuffer_sink<std::mutex>;
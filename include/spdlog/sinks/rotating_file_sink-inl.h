@@ -89,6 +89,40 @@ SPDLOG_INLINE void rotating_file_sink<Mutex>::sink_it_(const details::log_msg &m
     current_size_ = new_size;
 }
 
+// collect the formatted messages and write them at once.
+// if the next message would exceed max size, write what was collected so far and rotate.
+template <typename Mutex>
+SPDLOG_INLINE void rotating_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs,
+                                                          size_t count) {
+    memory_buf_t batch;
+    memory_buf_t formatted;
+    for (size_t i = 0; i < count; i++) {
+        if (!this->should_log(msgs[i].level)) {
+            continue;
+        }
+        formatted.clear();
+        base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+        auto new_size = current_size_ + batch.size() + formatted.size();
+        if (new_size > max_size_) {
+            if (batch.size() > 0) {
+                file_helper_.write(batch);
+                current_size_ += batch.size();
+                batch.clear();
+            }
+            file_helper_.flush();
+            if (file_helper_.size() > 0) {
+                rotate_();
+                current_size_ = 0;
+            }
+        }
+        batch.append(formatted.data(), formatted.data() + formatted.size());
+    }
+    if (batch.size() > 0) {
+        file_helper_.write(batch);
+        current_size_ += batch.size();
+    }
+}
+
 template <typename Mutex>
 SPDLOG_INLINE void rotating_file_sink<Mutex>::flush_() {
     file_helper_.flush();
@@ -31,6 +31,7 @@ public:
 
 protected:
     void sink_it_(const details::log_msg &msg) override;
+    void sink_batch_(const details::log_msg *msgs, size_t count) override;
     void flush_() override;
 
 private:
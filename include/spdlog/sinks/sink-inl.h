@@ -9,6 +9,14 @@
 
 #include <spdlog/common.h>
 
+SPDLOG_INLINE void spdlog::sinks::sink::log_batch(const details::log_msg *msgs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (should_log(msgs[i].level)) {
+            log(msgs[i]);
+        }
+    }
+}
+
 SPDLOG_INLINE bool spdlog::sinks::sink::should_log(spdlog::level::level_enum msg_level) const {
     return msg_level >= level_.load(std::memory_order_relaxed);
 }
@@ -20,3 +28,21 @@ SPDLOG_INLINE void spdlog::sinks::sink::set_level(level::level_enum log_level) {
 SPDLOG_INLINE spdlog::level::level_enum spdlog::sinks::sink::level() const {
     return static_cast<spdlog::level::level_enum>(level_.load(std::memory_order_relaxed));
 }
+
+SPDLOG_INLINE uint64_t spdlog::sinks::sink::format_fingerprint() const {
+    return format_fingerprint_.load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE size_t spdlog::sinks::sink::format_generation() {
+    return format_generation_().load(std::memory_order_acquire);
+}
+
+SPDLOG_INLINE void spdlog::sinks::sink::update_format_fingerprint_(uint64_t fingerprint) {
+    format_fingerprint_.store(fingerprint, std::memory_order_relaxed);
+    format_generation_().fetch_add(1, std::memory_order_release);
+}
+
+SPDLOG_INLINE std::atomic<size_t> &spdlog::sinks::sink::format_generation_() {
+    static std::atomic<size_t> generation{0};
+    return generation;
+}
@@ -13,6 +13,9 @@ class SPDLOG_API sink {
 public:
     virtual ~sink() = default;
     virtual void log(const details::log_msg &msg) = 0;
+    // log a contiguous range of messages. messages below the sink level are skipped.
+    // the default implementation calls log() for each message.
+    virtual void log_batch(const details::log_msg *msgs, size_t count);
     virtual void flush() = 0;
     virtual void set_pattern(const std::string &pattern) = 0;
     virtual void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) = 0;
@@ -21,9 +24,23 @@ public:
     level::level_enum level() const;
     bool should_log(level::level_enum msg_level) const;
 
+    // fingerprint of the formatter of the sink (see formatter::fingerprint())
+    uint64_t format_fingerprint() const;
+    // changes whenever some sink replaces its formatter, so the owners of the sinks know when
+    // to compute their shared fingerprint again (see details::sinks_fingerprint)
+    static size_t format_generation();
+
 protected:
     // sink log level - default is all
     level_t level_{level::trace};
+    // set by the sinks that format with their formatter, when it's replaced
+    std::atomic<uint64_t> format_fingerprint_{0};
+
+    // store the fingerprint of a replaced formatter and start a new format generation
+    void update_format_fingerprint_(uint64_t fingerprint);
+
+private:
+    static std::atomic<size_t> &format_generation_();
 };
 
 }  // namespace sinks
@@ -33,6 +33,7 @@ SPDLOG_INLINE stdout_sink_base<ConsoleMutex>::stdout_sink_base(FILE *file)
     : mutex_(ConsoleMutex::mutex()),
       file_(file),
       formatter_(details::make_unique<spdlog::pattern_formatter>()) {
+    format_fingerprint_.store(formatter_->fingerprint(), std::memory_order_relaxed);
 #ifdef _WIN32
     // get windows handle from the FILE* object
 
@@ -82,6 +83,7 @@ template <typename ConsoleMutex>
 SPDLOG_INLINE void stdout_sink_base<ConsoleMutex>::set_pattern(const std::string &pattern) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::unique_ptr<spdlog::formatter>(new pattern_formatter(pattern));
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 template <typename ConsoleMutex>
@@ -89,6 +91,7 @@ SPDLOG_INLINE void stdout_sink_base<ConsoleMutex>::set_formatter(
     std::unique_ptr<spdlog::formatter> sink_formatter) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::move(sink_formatter);
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 // stdout sink
@@ -63,6 +63,23 @@ protected:
         client_.send(formatted.data(), formatted.size());
     }
 
+    // send the whole batch at once
+    void sink_batch_(const spdlog::details::log_msg *msgs, size_t count) override {
+        spdlog::memory_buf_t formatted;
+        for (size_t i = 0; i < count; i++) {
+            if (this->should_log(msgs[i].level)) {
+                spdlog::sinks::base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+            }
+        }
+        if (formatted.size() == 0) {
+            return;
+        }
+        if (!client_.is_connected()) {
+            client_.connect(config_.server_host, config_.server_port);
+        }
+        client_.send(formatted.data(), formatted.size());
+    }
+
     void flush_() override {}
     tcp_sink_config config_;
     details::tcp_client client_;
@@ -48,6 +48,20 @@ protected:
         client_.send(formatted.data(), formatted.size());
     }
 
+    // each message is still sent in its own datagram, but the lock is taken once
+    // and the format buffer is reused for the whole batch.
+    void sink_batch_(const spdlog::details::log_msg *msgs, size_t count) override {
+        spdlog::memory_buf_t formatted;
+        for (size_t i = 0; i < count; i++) {
+            if (!this->should_log(msgs[i].level)) {
+                continue;
+            }
+            formatted.clear();
+            spdlog::sinks::base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+            client_.send(formatted.data(), formatted.size());
+        }
+    }
+
     void flush_() override {}
     details::udp_client client_;
 };
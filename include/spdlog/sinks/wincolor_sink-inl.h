@@ -20,6 +20,7 @@ SPDLOG_INLINE wincolor_sink<ConsoleMutex>::wincolor_sink(void *out_handle, color
     : out_handle_(out_handle),
       mutex_(ConsoleMutex::mutex()),
       formatter_(details::make_unique<spdlog::pattern_formatter>()) {
+    format_fingerprint_.store(formatter_->fingerprint(), std::memory_order_relaxed);
     set_color_mode_impl(mode);
     // set level colors
     colors_[level::trace] = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;  // white
@@ -83,6 +84,7 @@ template <typename ConsoleMutex>
 void SPDLOG_INLINE wincolor_sink<ConsoleMutex>::set_pattern(const std::string &pattern) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::unique_ptr<spdlog::formatter>(new pattern_formatter(pattern));
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 template <typename ConsoleMutex>
@@ -90,6 +92,7 @@ void SPDLOG_INLINE
 wincolor_sink<ConsoleMutex>::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) {
     std::lock_guard<mutex_t> lock(mutex_);
     formatter_ = std::move(sink_formatter);
+    update_format_fingerprint_(formatter_->fingerprint());
 }
 
 template <typename ConsoleMutex>
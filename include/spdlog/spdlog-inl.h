@@ -95,6 +95,12 @@ SPDLOG_INLINE void set_default_logger(std::shared_ptr<spdlog::logger> default_lo
     details::registry::instance().set_default_logger(std::move(default_logger));
 }
 
+SPDLOG_INLINE void set_memory_limit(size_t max_bytes) {
+    details::registry::instance().set_memory_limit(max_bytes);
+}
+
+SPDLOG_INLINE size_t memory_usage() { return details::registry::instance().memory_usage(); }
+
 SPDLOG_INLINE void apply_logger_env_levels(std::shared_ptr<logger> logger) {
     details::registry::instance().apply_logger_env_levels(std::move(logger));
 }
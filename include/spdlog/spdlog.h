@@ -118,6 +118,16 @@ SPDLOG_API void shutdown();
 // Automatic registration of loggers when using spdlog::create() or spdlog::create_async
 SPDLOG_API void set_automatic_registration(bool automatic_registration);
 
+// Limit the total bytes (logger names and payloads) of the messages held by the async queues,
+// backtracers and ringbuffer sinks. 0 (the default) means no limit.
+// When the limit is hit, the async queues apply their overflow policy, and the backtracers and
+// ringbuffer sinks drop their oldest messages.
+// The usage is tracked only while a limit is set.
+SPDLOG_API void set_memory_limit(size_t max_bytes);
+
+// Bytes currently held by the messages covered by the memory limit
+SPDLOG_API size_t memory_usage();
+
 // API for using default logger (stdout_color_mt),
 // e.g: spdlog::info("Message {}", 1);
 //
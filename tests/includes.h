@@ -26,12 +26,18 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/async.h"
 #include "spdlog/details/fmt_helper.h"
+#include "spdlog/details/format_cache.h"
 #include "spdlog/mdc.h"
 #include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/binary_file_sink.h"
 #include "spdlog/sinks/daily_file_sink.h"
+#include "spdlog/sinks/dist_sink.h"
 #include "spdlog/sinks/null_sink.h"
 #include "spdlog/sinks/ostream_sink.h"
 #include "spdlog/sinks/rotating_file_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/sinks/msvc_sink.h"
 #include "spdlog/pattern_formatter.h"
+#include "spdlog/json_formatter.h"
+#include "spdlog/details/json_escape.h"
+#include "spdlog/compiled_pattern.h"
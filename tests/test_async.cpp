@@ -130,13 +130,65 @@ TEST_CASE("multithread flush", "[async]") {
             t.join();
         }
     }
+    // concurrent flush requests may be served by a single flush of the sinks
     REQUIRE(test_sink->flush_counter() >= 1);
-    REQUIRE(test_sink->flush_counter() + errmsgs.size() == n_threads * flush_count);
+    REQUIRE(test_sink->flush_counter() + errmsgs.size() <= n_threads * flush_count);
     if (errmsgs.size() > 0) { 
         REQUIRE(errmsgs[0] == "Broken promise"); 
     }
 }
 
+TEST_CASE("flush with overrun policy", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    std::atomic<size_t> dropped{0};
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(4, 1);
+        auto logger = std::make_shared<spdlog::async_logger>(
+            "as", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+        logger->set_error_handler([&](const std::string &) { dropped++; });
+        std::atomic<bool> done{false};
+        std::thread producer([&] {
+            while (!done) {
+                logger->info("Hello message");
+            }
+        });
+        // a flush request dropped by an overrun is reported to the error handler instead of
+        // blocking flush() forever
+        for (int i = 0; i < 20; i++) {
+            logger->flush();
+        }
+        done = true;
+        producer.join();
+    }
+    REQUIRE(test_sink->flush_counter() + dropped <= 20);
+}
+
+TEST_CASE("flush requests dropped after a later one was served", "[async]") {
+    spdlog::details::flush_requests requests;
+    auto first = requests.request();
+    auto second = requests.request();
+    // the later request is served before the earlier one is dropped
+    requests.complete(second);
+    requests.drop(first);
+    REQUIRE(requests.pending_drops() == 0);
+    REQUIRE(requests.wait(first));
+
+    // dropped before the later request is served: the waiter of the dropped request may be
+    // gone, the waiter of the later one forgets it
+    auto third = requests.request();
+    auto fourth = requests.request();
+    requests.drop(third);
+    requests.complete(fourth);
+    REQUIRE(requests.wait(fourth));
+    REQUIRE(requests.pending_drops() == 0);
+
+    auto fifth = requests.request();
+    requests.drop(fifth);
+    REQUIRE_FALSE(requests.wait(fifth));
+    REQUIRE(requests.pending_drops() == 0);
+}
+
 TEST_CASE("async periodic flush", "[async]") {
     auto logger = spdlog::create_async<spdlog::sinks::test_sink_mt>("as");
     auto test_sink = std::static_pointer_cast<spdlog::sinks::test_sink_mt>(logger->sinks()[0]);
@@ -242,3 +294,1040 @@ TEST_CASE("bad_tp", "[async]") {
     logger->info("Please throw an exception");
     REQUIRE(test_sink->msg_counter() == 0);
 }
+
+TEST_CASE("lock_free queue", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t queue_size = 16;
+    size_t messages = 256;
+    size_t n_threads = 4;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(
+            queue_size, 1, spdlog::async_queue_type::lock_free);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n_threads; i++) {
+            threads.emplace_back([logger, messages] {
+                for (size_t j = 0; j < messages; j++) {
+                    logger->info("Hello message #{}", j);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        logger->flush();
+        REQUIRE(tp->overrun_counter() == 0);
+    }
+    REQUIRE(test_sink->msg_counter() == messages * n_threads);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("lock_free queue discard policies", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t queue_size = 4;
+    size_t messages = 1024;
+
+    auto tp = std::make_shared<spdlog::details::thread_pool>(queue_size, 1,
+                                                             spdlog::async_queue_type::lock_free);
+    auto overrun_logger = std::make_shared<spdlog::async_logger>(
+        "as", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+    auto discard_logger = std::make_shared<spdlog::async_logger>(
+        "as2", test_sink, tp, spdlog::async_overflow_policy::discard_new);
+    for (size_t i = 0; i < messages; i++) {
+        overrun_logger->info("Hello message");
+        discard_logger->info("Hello message");
+    }
+    REQUIRE(test_sink->msg_counter() < messages * 2);
+    REQUIRE(tp->overrun_counter() > 0);
+    REQUIRE(tp->discard_counter() > 0);
+}
+
+TEST_CASE("per_thread queue", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t queue_size = 16;
+    size_t messages = 256;
+    size_t n_threads = 4;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(
+            queue_size, 1, spdlog::async_queue_type::per_thread);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n_threads; i++) {
+            threads.emplace_back([logger, messages] {
+                for (size_t j = 0; j < messages; j++) {
+                    logger->info("Hello message #{}", j);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        logger->flush();
+        REQUIRE(tp->overrun_counter() == 0);
+    }
+    REQUIRE(test_sink->msg_counter() == messages * n_threads);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("per_thread queue lane capacity", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(20));
+    size_t lane_size = 16;
+    size_t messages = 100;
+
+    spdlog::details::thread_pool_options options;
+    options.queue_type = spdlog::async_queue_type::per_thread;
+    options.q_max_items = 8192;
+    options.lane_max_items = lane_size;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "as", test_sink, tp, spdlog::async_overflow_policy::discard_new);
+    // the lane of this thread fills up while the pool thread is held by the slow sink, however
+    // big the queue size is. the pool thread may take a batch first.
+    for (size_t i = 0; i < messages; i++) {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->discard_counter() >= messages - 2 * lane_size);
+}
+
+TEST_CASE("byte_ring queue", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    size_t queue_bytes = 4096;
+    size_t messages = 256;
+    size_t n_threads = 4;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(
+            queue_bytes, 1, spdlog::async_queue_type::byte_ring);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n_threads; i++) {
+            threads.emplace_back([logger, messages] {
+                for (size_t j = 0; j < messages; j++) {
+                    // variable sizes, some bigger than the inline buffer of log_msg_buffer
+                    logger->info("{}", std::string(j % 512, 'x'));
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        logger->flush();
+        REQUIRE(tp->overrun_counter() == 0);
+        REQUIRE(tp->discard_counter() == 0);
+    }
+    REQUIRE(test_sink->msg_counter() == messages * n_threads);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("byte_ring queue keeps order", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    size_t messages = 100;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(
+            1024, 1, spdlog::async_queue_type::byte_ring);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        for (size_t i = 0; i < messages; i++) {
+            logger->info("{} {}", i, std::string(i * 3 % 200, 'y'));
+        }
+        logger->flush();
+    }
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == messages);
+    for (size_t i = 0; i < lines.size(); i++) {
+        REQUIRE(lines[i] == spdlog::fmt_lib::format("{} {}", i, std::string(i * 3 % 200, 'y')));
+    }
+}
+
+TEST_CASE("byte_ring queue discard policies", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 1024;
+
+    auto tp = std::make_shared<spdlog::details::thread_pool>(512, 1,
+                                                             spdlog::async_queue_type::byte_ring);
+    auto overrun_logger = std::make_shared<spdlog::async_logger>(
+        "as", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+    auto discard_logger = std::make_shared<spdlog::async_logger>(
+        "as2", test_sink, tp, spdlog::async_overflow_policy::discard_new);
+    for (size_t i = 0; i < messages; i++) {
+        overrun_logger->info("Hello message");
+        discard_logger->info("Hello message");
+    }
+    REQUIRE(test_sink->msg_counter() < messages * 2);
+    // the messages being sunk can't be overrun, so the overrun logger may discard instead
+    // (see "byte_ring queue holds records until released")
+    REQUIRE(tp->discard_counter() > 0);
+
+    // a message bigger than the whole queue is discarded
+    tp->reset_discard_counter();
+    overrun_logger->info(std::string(1024, 'z'));
+    REQUIRE(tp->discard_counter() == 1);
+}
+
+TEST_CASE("byte_ring queue holds records until released", "[async]") {
+    using spdlog::details::async_msg;
+    spdlog::details::byte_ring_queue<async_msg> q(1024);
+    std::vector<std::string> payloads;
+    for (size_t i = 0;; i++) {
+        payloads.push_back(spdlog::fmt_lib::format("message #{}", i));
+        spdlog::details::log_msg msg("ring", spdlog::level::info, payloads.back());
+        if (!q.enqueue_log_if_have_room(nullptr, msg, nullptr)) {
+            payloads.pop_back();
+            break;
+        }
+    }
+    REQUIRE(payloads.size() > 1);
+
+    std::vector<async_msg> msgs(payloads.size());
+    REQUIRE(q.try_dequeue_bulk(msgs.data(), msgs.size()) == payloads.size());
+    // the dequeued messages refer to their records, which keep their space
+    spdlog::details::log_msg extra("ring", spdlog::level::info, "extra");
+    REQUIRE_FALSE(q.enqueue_log_nowait(nullptr, extra, nullptr));
+    REQUIRE(q.overrun_counter() == 0);
+    for (size_t i = 0; i < payloads.size(); i++) {
+        REQUIRE(msgs[i].logger_name == "ring");
+        REQUIRE(msgs[i].payload == payloads[i]);
+    }
+
+    q.release(msgs.data(), msgs.size());
+    // the queued records can be overrun again
+    for (size_t i = 0; i < payloads.size(); i++) {
+        spdlog::details::log_msg msg("ring", spdlog::level::info, payloads[i]);
+        REQUIRE(q.enqueue_log_if_have_room(nullptr, msg, nullptr));
+    }
+    REQUIRE(q.enqueue_log_nowait(nullptr, extra, nullptr));
+    REQUIRE(q.overrun_counter() > 0);
+    // dequeuing into a message releases the record it held
+    while (q.try_dequeue_bulk(msgs.data(), 1) > 0) {
+    }
+    REQUIRE(msgs[0].payload == "extra");
+    q.release(msgs.data(), 1);
+
+    REQUIRE(q.enqueue_log_if_have_room(nullptr, extra, nullptr));
+    // a message destroyed without release() releases its record
+    {
+        async_msg popped;
+        q.dequeue(popped);
+        REQUIRE(popped.payload == "extra");
+        REQUIRE(q.size() == 0);
+    }
+    REQUIRE(q.enqueue_log_if_have_room(nullptr, extra, nullptr));
+}
+
+TEST_CASE("byte_ring queue trims committed records", "[async]") {
+    using spdlog::details::async_msg;
+    using queue_t = spdlog::details::byte_ring_queue<async_msg>;
+    queue_t q(1024);
+    spdlog::details::log_msg msg("ring", spdlog::level::info, "");
+    size_t pos = 0;
+    auto *p = q.reserve_log(nullptr, msg, 700, queue_t::charge_t(), queue_t::push_mode::discard,
+                            std::chrono::milliseconds::zero(), pos);
+    REQUIRE(p != nullptr);
+    std::memcpy(p, "short", 5);
+    q.commit(pos, 5);
+    // the unused space of the last record was given back
+    std::string big(600, 'x');
+    spdlog::details::log_msg big_msg("ring", spdlog::level::info, big);
+    REQUIRE(q.enqueue_log_if_have_room(nullptr, big_msg, nullptr));
+
+    async_msg popped;
+    for (auto expected : {"short", big.c_str()}) {
+        q.dequeue(popped);
+        REQUIRE(popped.payload == expected);
+    }
+    q.release(&popped, 1);
+
+    // a record reserved before another one keeps its space until dequeued
+    p = q.reserve_log(nullptr, msg, 700, queue_t::charge_t(), queue_t::push_mode::discard,
+                      std::chrono::milliseconds::zero(), pos);
+    REQUIRE(p != nullptr);
+    REQUIRE(q.enqueue_log_if_have_room(nullptr, msg, nullptr));
+    q.commit(pos, 0);
+    REQUIRE_FALSE(q.enqueue_log_if_have_room(nullptr, big_msg, nullptr));
+    for (size_t i = 0; i < 2; i++) {
+        q.dequeue(popped);
+        REQUIRE(popped.payload.size() == 0);
+    }
+    q.release(&popped, 1);
+    REQUIRE(q.enqueue_log_if_have_room(nullptr, big_msg, nullptr));
+}
+
+TEST_CASE("pool releases unused loggers", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(128, 2);
+    std::weak_ptr<spdlog::async_logger> weak_logger;
+    {
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        weak_logger = logger;
+        for (int i = 0; i < 100; i++) {
+            logger->info("Hello message #{}", i);
+        }
+        // the pool keeps the logger alive while it has messages
+        REQUIRE(weak_logger.use_count() == 2);
+    }
+    // the pool threads release the logger after its messages were processed, while another
+    // logger keeps posting
+    auto other_logger = std::make_shared<spdlog::async_logger>("as2", test_sink, tp);
+    for (int i = 0; i < 500 && !weak_logger.expired(); i++) {
+        other_logger->info("Hello message #{}", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(weak_logger.expired());
+    REQUIRE(test_sink->msg_counter() >= 100);
+}
+
+TEST_CASE("pool releases unused loggers while idle", "[async]") {
+    for (auto wait_strategy :
+         {spdlog::async_wait_strategy::blocking, spdlog::async_wait_strategy::spin_park,
+          spdlog::async_wait_strategy::spin_yield}) {
+        spdlog::details::thread_pool_options options;
+        options.q_max_items = 128;
+        options.threads_n = 2;
+        options.wait_strategy = wait_strategy;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        std::weak_ptr<spdlog::sinks::test_sink_mt> weak_sink;
+        {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            weak_sink = test_sink;
+            auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+            logger->info("Hello message");
+            logger->flush();
+        }
+        // nothing is posted anymore - the idle pool threads release the logger and its sink
+        for (int i = 0; i < 200 && !weak_sink.expired(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(weak_sink.expired());
+
+        // the pool holds no loggers now - the next one wakes up its threads
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->info("Hello message");
+        logger->flush();
+        REQUIRE(test_sink->msg_counter() == 1);
+    }
+}
+
+TEST_CASE("pool destroyed while producers post through its handle", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(1024, 2);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    std::atomic<size_t> errors{0};
+    logger->set_error_handler([&errors](const std::string &) { errors++; });
+
+    size_t n_threads = 4;
+    size_t messages = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < messages; i++) {
+                logger->info("Hello message #{}", i);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    tp.reset();
+    for (auto &t : threads) {
+        t.join();
+    }
+    // every message was either sinked, dropped by the stopped pool, or reported as posted to a
+    // destroyed pool
+    REQUIRE(test_sink->msg_counter() + logger->drop_counter() + errors == n_threads * messages);
+
+    logger->info("Hello message");
+    REQUIRE(errors > 0);
+}
+
+TEST_CASE("batch processing", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t messages = 1024;
+    size_t n_threads = 4;
+    {
+        spdlog::details::thread_pool_options options;
+        options.q_max_items = 128;
+        options.threads_n = n_threads;
+        options.max_batch_size = 16;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        for (size_t i = 0; i < messages; i++) {
+            logger->info("Hello message #{}", i);
+        }
+        logger->flush();
+    }
+    REQUIRE(test_sink->msg_counter() == messages);
+    REQUIRE(test_sink->flush_counter() == 1);
+}
+
+TEST_CASE("batch processing keeps order", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    size_t messages = 50;  // test sink saves up to 100 lines
+    {
+        spdlog::details::thread_pool_options options;
+        options.q_max_items = 64;
+        options.max_batch_size = 32;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp,
+                                                             spdlog::async_overflow_policy::block);
+        auto logger2 = std::make_shared<spdlog::async_logger>(
+            "as2", test_sink, tp, spdlog::async_overflow_policy::block);
+        logger2->flush_on(spdlog::level::warn);
+        for (size_t i = 0; i < messages; i++) {
+            logger->info("{}", i * 2);
+            logger2->warn("{}", i * 2 + 1);
+        }
+        logger->flush();
+    }
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == messages * 2);
+    for (size_t i = 0; i < lines.size(); i++) {
+        REQUIRE(lines[i] == std::to_string(i));
+    }
+    REQUIRE(test_sink->flush_counter() > 0);
+}
+
+TEST_CASE("sharded pool keeps per logger order", "[async]") {
+    size_t n_loggers = 4;
+    size_t messages = 100;
+    std::vector<std::shared_ptr<spdlog::sinks::test_sink_mt>> test_sinks;
+    {
+        spdlog::details::thread_pool_options options;
+        options.q_max_items = 16;
+        options.threads_n = 3;
+        options.max_batch_size = 4;
+        options.sharded = true;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        REQUIRE(tp->shards_n() == 3);
+
+        std::vector<std::shared_ptr<spdlog::async_logger>> loggers;
+        for (size_t i = 0; i < n_loggers; i++) {
+            test_sinks.push_back(std::make_shared<spdlog::sinks::test_sink_mt>());
+            test_sinks.back()->set_pattern("%v");
+            loggers.push_back(std::make_shared<spdlog::async_logger>(
+                "as" + std::to_string(i), test_sinks.back(), tp));
+            loggers.back()->set_shard(i);
+            REQUIRE(tp->shard_of(*loggers.back()) == i % 3);
+        }
+        for (size_t j = 0; j < messages; j++) {
+            for (auto &logger : loggers) {
+                logger->info("{}", j);
+            }
+        }
+        for (auto &logger : loggers) {
+            logger->flush();
+        }
+        REQUIRE(tp->queue_size() == 0);
+        for (size_t shard = 0; shard < tp->shards_n(); shard++) {
+            REQUIRE(tp->queue_size(shard) == 0);
+        }
+        REQUIRE_THROWS_AS(tp->queue_size(3), spdlog::spdlog_ex);
+    }
+    for (auto &test_sink : test_sinks) {
+        auto lines = test_sink->lines();
+        REQUIRE(lines.size() == messages);
+        for (size_t j = 0; j < lines.size(); j++) {
+            REQUIRE(lines[j] == std::to_string(j));
+        }
+    }
+}
+
+TEST_CASE("clone of an async logger hashes its own shard", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    REQUIRE(logger->shard() == std::hash<std::string>()("as"));
+
+    auto cloned = std::static_pointer_cast<spdlog::async_logger>(logger->clone("as-clone"));
+    REQUIRE(cloned->shard() == std::hash<std::string>()("as-clone"));
+
+    // a pinned shard is kept by the clone
+    logger->set_shard(7);
+    cloned = std::static_pointer_cast<spdlog::async_logger>(logger->clone("as-clone2"));
+    REQUIRE(cloned->shard() == 7);
+}
+
+TEST_CASE("priority lane", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    size_t messages = 200;
+    {
+        spdlog::details::thread_pool_options options;
+        options.q_max_items = 4;
+        options.priority_level = spdlog::level::err;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>(
+            "as", test_sink, tp, spdlog::async_overflow_policy::discard_new);
+        for (size_t i = 0; i < messages; i++) {
+            logger->info("info");
+            if (i % 50 == 0) {
+                logger->error("error");
+            }
+        }
+        logger->flush();
+        REQUIRE(tp->discard_counter() > 0);
+    }
+    // the drop policy applies only to messages below the priority level
+    auto lines = test_sink->lines();
+    REQUIRE(std::count(lines.begin(), lines.end(), "error") == 4);
+}
+
+TEST_CASE("priority lane wakes up idle pool", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    spdlog::details::thread_pool_options options;
+    options.priority_level = spdlog::level::warn;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    // let the pool thread wait for the empty queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    logger->warn("warning");
+    for (int i = 0; i < 1000 && test_sink->msg_counter() == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(test_sink->msg_counter() == 1);
+}
+
+TEST_CASE("wait strategies", "[async]") {
+    using spdlog::async_queue_type;
+    using spdlog::async_wait_strategy;
+    size_t messages = 100;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::lock_free,
+                            async_queue_type::per_thread, async_queue_type::byte_ring}) {
+        for (auto wait_strategy : {async_wait_strategy::spin_park, async_wait_strategy::spin_yield,
+                                   async_wait_strategy::busy_spin}) {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            {
+                spdlog::details::thread_pool_options options;
+                options.q_max_items = queue_type == async_queue_type::byte_ring ? 4096 : 16;
+                options.queue_type = queue_type;
+                options.wait_strategy = wait_strategy;
+                options.spin_count = 100;
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+                for (size_t i = 0; i < messages; i++) {
+                    logger->info("Hello message #{}", i);
+                }
+                logger->flush();
+                // let the pool thread run out of spins and park or yield
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                logger->info("Hello again");
+            }
+            REQUIRE(test_sink->msg_counter() == messages + 1);
+            REQUIRE(test_sink->flush_counter() == 1);
+        }
+    }
+}
+
+TEST_CASE("queue byte budget", "[async]") {
+    using spdlog::async_overflow_policy;
+    std::string payload(100, 'x');
+    size_t messages = 100;
+    // the fields and the MDC are charged too
+    for (std::string charged : {"payload", "fields", "mdc"}) {
+        if (charged == "mdc") {
+            spdlog::mdc::put("data", payload);
+        }
+        for (auto policy : {async_overflow_policy::block, async_overflow_policy::overrun_oldest,
+                            async_overflow_policy::discard_new}) {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            test_sink->set_delay(std::chrono::milliseconds(1));
+            {
+                spdlog::details::thread_pool_options options;
+                options.q_max_bytes = 500;  // about 4 messages
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, policy);
+                for (size_t i = 0; i < messages; i++) {
+                    if (charged == "payload") {
+                        logger->info(payload);
+                    } else if (charged == "fields") {
+                        logger->info("m", spdlog::kv("data", payload));
+                    } else {
+                        logger->info("m");
+                    }
+                    REQUIRE(tp->memory_usage() <= 500);
+                }
+                logger->flush();
+                REQUIRE(tp->memory_usage() == 0);
+                if (policy == async_overflow_policy::block) {
+                    REQUIRE(test_sink->msg_counter() == messages);
+                } else if (policy == async_overflow_policy::overrun_oldest) {
+                    REQUIRE(tp->overrun_counter() > 0);
+                } else {
+                    REQUIRE(tp->discard_counter() > 0);
+                }
+            }
+        }
+    }
+    spdlog::mdc::clear();
+}
+
+TEST_CASE("queue byte budget overrun keeps control messages", "[async]") {
+    using spdlog::async_queue_type;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::per_thread}) {
+        spdlog::details::thread_pool_options options;
+        options.queue_type = queue_type;
+        options.q_max_bytes = 500;
+        options.lane_max_items = 4;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        // keeps the pool thread busy while the queue is overrun
+        auto slow_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        slow_sink->set_delay(std::chrono::milliseconds(500));
+        auto slow_logger = std::make_shared<spdlog::async_logger>("slow", slow_sink, tp);
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        auto logger = std::make_shared<spdlog::async_logger>(
+            "as", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+        std::atomic<size_t> errors{0};
+        logger->set_error_handler([&errors](const std::string &) { errors++; });
+
+        slow_logger->info("slow");
+        while (tp->queue_size() > 0) {
+            std::this_thread::yield();
+        }
+        std::thread flusher([logger] { logger->flush(); });
+        while (tp->queue_size() < 1) {
+            std::this_thread::yield();
+        }
+        // the flush request is the oldest message when the budget is first overrun. the
+        // overrun skips it without waiting for room (with per_thread, this thread's lane is
+        // full by then).
+        auto start = std::chrono::steady_clock::now();
+        std::string payload(100, 'x');
+        for (int i = 0; i < 20; i++) {
+            logger->info(payload);
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(250));
+        flusher.join();
+        REQUIRE(errors == 0);
+        REQUIRE(test_sink->flush_counter() == 1);
+        REQUIRE(tp->overrun_counter() > 0);
+    }
+}
+
+TEST_CASE("pool stats", "[async]") {
+    using spdlog::async_overflow_policy;
+    using spdlog::async_queue_type;
+    size_t messages = 50;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::lock_free,
+                            async_queue_type::byte_ring}) {
+        size_t q_size = queue_type == async_queue_type::byte_ring ? 1024 : 4;
+        for (auto policy : {async_overflow_policy::block, async_overflow_policy::overrun_oldest,
+                            async_overflow_policy::discard_new}) {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            test_sink->set_delay(std::chrono::milliseconds(1));
+            spdlog::details::thread_pool_stats stats;
+            std::shared_ptr<spdlog::async_logger> logger;
+            {
+                spdlog::details::thread_pool_options options;
+                options.q_max_items = q_size;
+                options.queue_type = queue_type;
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, policy);
+                for (size_t i = 0; i < messages; i++) {
+                    logger->info("Hello message #{}", i);
+                }
+                while (test_sink->msg_counter() + tp->overrun_counter() + tp->discard_counter() <
+                       messages) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                stats = tp->stats();
+                REQUIRE(stats.high_water_mark > 0);
+                size_t histogram_total = 0;
+                for (auto n : stats.latency_histogram) {
+                    histogram_total += n;
+                }
+                REQUIRE(histogram_total == test_sink->msg_counter());
+
+                tp->reset_stats();
+                REQUIRE(tp->stats().high_water_mark == 0);
+                REQUIRE(tp->stats().blocked_time.count() == 0);
+            }
+            if (policy == async_overflow_policy::block) {
+                REQUIRE(test_sink->msg_counter() == messages);
+                REQUIRE(stats.blocked_time.count() > 0);
+                REQUIRE(logger->drop_counter() == 0);
+                if (queue_type == async_queue_type::mutex) {
+                    REQUIRE(stats.high_water_mark == q_size);
+                }
+            } else {
+                REQUIRE(logger->drop_counter() > 0);
+                REQUIRE(logger->drop_counter() == stats.overrun_counter + stats.discard_counter);
+                REQUIRE(logger->drop_counter() + test_sink->msg_counter() == messages);
+            }
+        }
+    }
+}
+
+TEST_CASE("block with timeout policy", "[async]") {
+    using spdlog::async_queue_type;
+    size_t messages = 20;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::lock_free,
+                            async_queue_type::byte_ring}) {
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        test_sink->set_delay(std::chrono::milliseconds(5));
+        std::shared_ptr<spdlog::async_logger> logger;
+        {
+            spdlog::details::thread_pool_options options;
+            options.q_max_items = queue_type == async_queue_type::byte_ring ? 1024 : 2;
+            options.queue_type = queue_type;
+            auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+            logger = std::make_shared<spdlog::async_logger>(
+                "as", test_sink, tp, spdlog::async_overflow_policy::block_with_timeout);
+            logger->set_block_timeout(std::chrono::milliseconds(1));
+            for (size_t i = 0; i < messages; i++) {
+                logger->info("Hello message #{}", i);
+            }
+            REQUIRE(tp->discard_counter() == logger->drop_counter());
+            REQUIRE(tp->stats().blocked_time.count() > 0);
+        }
+        REQUIRE(logger->drop_counter() > 0);
+        REQUIRE(test_sink->msg_counter() + logger->drop_counter() == messages);
+    }
+}
+
+TEST_CASE("shutdown with deadline", "[async]") {
+    size_t messages = 200;
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(2));
+    auto tp = std::make_shared<spdlog::details::thread_pool>(messages, 1);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    for (size_t i = 0; i < messages; i++) {
+        logger->info("Hello message #{}", i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto abandoned = tp->shutdown(std::chrono::milliseconds(20));
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+    REQUIRE(abandoned > 0);
+    REQUIRE(test_sink->msg_counter() + abandoned == messages);
+    REQUIRE(logger->drop_counter() == abandoned);
+
+    // the pool is stopped - new messages are dropped
+    logger->info("after shutdown");
+    REQUIRE(logger->drop_counter() == abandoned + 1);
+    size_t errors = 0;
+    logger->set_error_handler([&errors](const std::string &) { errors++; });
+    logger->flush();
+    REQUIRE(errors == 1);
+    REQUIRE(tp->shutdown() == 0);
+}
+
+TEST_CASE("shutdown reports abandoned byte_ring messages", "[async]") {
+    spdlog::details::thread_pool_options options;
+    options.q_max_items = 16384;
+    options.queue_type = spdlog::async_queue_type::byte_ring;
+    options.max_batch_size = 4;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(100));
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    std::atomic<size_t> errors{0};
+    logger->set_error_handler([&errors](const std::string &) { errors++; });
+
+    logger->info("first");
+    while (tp->queue_size() > 0) {
+        std::this_thread::yield();
+    }
+    // the flush request is abandoned in the middle of the queue, not in its last batch
+    for (int i = 0; i < 20; i++) {
+        logger->info("Hello message #{}", i);
+    }
+    std::thread flusher([logger] { logger->flush(); });
+    while (tp->queue_size() < 21) {
+        std::this_thread::yield();
+    }
+    for (int i = 20; i < 40; i++) {
+        logger->info("Hello message #{}", i);
+    }
+
+    auto abandoned = tp->shutdown(std::chrono::milliseconds(10));
+    flusher.join();
+    REQUIRE(abandoned == 40);
+    REQUIRE(logger->drop_counter() == abandoned);
+    REQUIRE(errors == 1);
+}
+
+TEST_CASE("shutdown deadline between flush requests", "[async]") {
+    auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+    // keeps the pool thread busy while the batch is queued
+    auto slow_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    slow_sink->set_delay(std::chrono::milliseconds(200));
+    auto slow_logger = std::make_shared<spdlog::async_logger>("slow", slow_sink, tp);
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(100));
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    std::atomic<size_t> errors{0};
+    logger->set_error_handler([&errors](const std::string &) { errors++; });
+
+    slow_logger->info("slow");
+    while (tp->queue_size() > 0) {
+        std::this_thread::yield();
+    }
+    // one batch: [flush][log][log][flush]
+    std::thread first([logger] { logger->flush(); });
+    while (tp->queue_size() < 1) {
+        std::this_thread::yield();
+    }
+    logger->info("message 1");
+    logger->info("message 2");
+    std::thread second([logger] { logger->flush(); });
+    while (tp->queue_size() < 4) {
+        std::this_thread::yield();
+    }
+
+    // the first request is reached before the deadline, the second after it
+    tp->shutdown(std::chrono::milliseconds(250));
+    first.join();
+    second.join();
+    REQUIRE(test_sink->msg_counter() == 2);
+    REQUIRE(test_sink->flush_counter() == 0);
+    REQUIRE(errors == 2);
+}
+
+TEST_CASE("shutdown without deadline", "[async]") {
+    size_t messages = 100;
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(messages, 2);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    for (size_t i = 0; i < messages; i++) {
+        logger->info("Hello message #{}", i);
+    }
+    REQUIRE(tp->shutdown() == 0);
+    REQUIRE(test_sink->msg_counter() == messages);
+}
+
+#ifdef __linux__
+TEST_CASE("pool thread settings", "[async]") {
+    using spdlog::async_queue_type;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::lock_free,
+                            async_queue_type::byte_ring}) {
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        {
+            spdlog::details::thread_pool_options options;
+            options.threads_n = 2;
+            options.sharded = true;
+            options.queue_type = queue_type;
+            options.cpu_affinity = {0};
+            options.thread_name = "spdlog-pool";
+            options.numa_local_queue = true;
+            auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+            auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+            for (int i = 0; i < 100; i++) {
+                logger->info("Hello message #{}", i);
+            }
+            logger->flush();
+        }
+        REQUIRE(test_sink->msg_counter() == 100);
+    }
+
+    spdlog::details::thread_pool_options options;
+    options.cpu_affinity = {100000};
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+#endif
+
+TEST_CASE("deferred formatting", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->enable_deferred_formatting();
+
+        std::string str = "some string";
+        const char *c_str = "c string";
+        logger->info("{} {:.2f} {} {} {} {}", 42, 3.14159, str, c_str, 'x', true);
+        // the string must have been copied by value
+        str = "modified";
+        logger->info(spdlog::string_view_t("no args"));
+        logger->info("{:>5}|{:<5}|", 7, spdlog::string_view_t("ab"));
+        // not packable arg type - formatted on the calling thread
+        logger->info("{} fallback", nullptr);
+        logger->flush();
+    }
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == 4);
+    REQUIRE(lines[0] == "42 3.14 some string c string x true");
+    REQUIRE(lines[1] == "no args");
+    REQUIRE(lines[2] == "    7|ab   |");
+    REQUIRE(lines[3] == spdlog::fmt_lib::format("{} fallback", nullptr));
+}
+
+#ifndef SPDLOG_USE_STD_FORMAT
+TEST_CASE("deferred formatting null c string", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%v");
+    std::string eager_error;
+    spdlog::logger sync_logger("sync", test_sink);
+    sync_logger.set_error_handler([&](const std::string &msg) { eager_error = msg; });
+    sync_logger.info("{}", static_cast<const char *>(nullptr));
+    REQUIRE_FALSE(eager_error.empty());
+
+    std::string deferred_error;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->enable_deferred_formatting();
+        logger->set_error_handler([&](const std::string &msg) { deferred_error = msg; });
+        logger->info("{}", static_cast<const char *>(nullptr));
+        logger->info("{} after error", "c string");
+        logger->flush();
+    }
+    // reported by the backend as the calling thread would have
+    REQUIRE(deferred_error == eager_error);
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"c string after error"});
+}
+#endif
+
+TEST_CASE("deferred formatting is_deferrable", "[async]") {
+    using spdlog::details::is_deferrable;
+    struct some_type {};
+    REQUIRE(is_deferrable<>::value);
+    REQUIRE(is_deferrable<int, double, const char *, std::string, bool, char>::value);
+    REQUIRE(is_deferrable<const int &, std::string &&, const char (&)[4]>::value);
+    REQUIRE_FALSE(is_deferrable<int, some_type>::value);
+    REQUIRE_FALSE(is_deferrable<std::nullptr_t>::value);
+}
+
+#ifndef SPDLOG_USE_STD_FORMAT
+// formats as the number of messages in the pool's queue
+struct queue_probe {
+    spdlog::details::thread_pool *tp;
+};
+
+template <>
+struct fmt::formatter<queue_probe> : fmt::formatter<size_t> {
+    template <typename FormatContext>
+    auto format(const queue_probe &probe, FormatContext &ctx) const -> decltype(ctx.out()) {
+        return fmt::formatter<size_t>::format(probe.tp->queue_size(), ctx);
+    }
+};
+#endif
+
+TEST_CASE("in place formatting", "[async]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%n %v");
+    size_t messages = 80;
+    size_t errors = 0;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(
+            4096, 1, spdlog::async_queue_type::byte_ring);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->enable_in_place_formatting();
+        logger->set_error_handler([&](const std::string &) { errors++; });
+        // some bigger than the reserved size
+        for (size_t i = 0; i < messages; i++) {
+            logger->info("{} {}", i, std::string(i * 12, 'y'));
+        }
+        // the reservation of a message that failed to format is skipped
+        logger->info(SPDLOG_FMT_RUNTIME("{} {}"), 1);
+        // bigger than the whole queue
+        logger->info("{}", std::string(5000, 'z'));
+        logger->info("after error");
+        logger->flush();
+        REQUIRE(tp->discard_counter() == 1);
+#ifndef SPDLOG_USE_STD_FORMAT
+        // the outliers didn't turn in place formatting off: the message is formatted into its
+        // record, which is already in the queue
+        logger->info("{}", queue_probe{tp.get()});
+        logger->flush();
+        REQUIRE(test_sink->lines().back() == "as 1");
+#endif
+    }
+    REQUIRE(errors == 1);
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() >= messages + 1);
+    for (size_t i = 0; i < messages; i++) {
+        REQUIRE(lines[i] == spdlog::fmt_lib::format("as {} {}", i, std::string(i * 12, 'y')));
+    }
+    REQUIRE(lines[messages] == "as after error");
+
+    // queues that can't reserve records post the messages as usual
+    test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_pattern("%n %v");
+    auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    logger->enable_in_place_formatting();
+    logger->info("{} {}", "mutex", 1);
+    logger->flush();
+    REQUIRE(test_sink->lines().back() == "as mutex 1");
+}
+
+TEST_CASE("shared output of async sinks", "[async]") {
+    auto sink_1 = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto sink_2 = std::make_shared<spdlog::sinks::test_sink_mt>();
+    sink_1->set_pattern("%v %L");
+    sink_2->set_pattern("%v %L");
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(128, 1);
+        auto logger = std::make_shared<spdlog::async_logger>(
+            "as", spdlog::sinks_init_list{sink_1, sink_2}, tp, spdlog::async_overflow_policy::block);
+        for (int i = 0; i < 50; i++) {
+            logger->info("message {}", i);
+        }
+    }
+    REQUIRE(sink_1->msg_counter() == 50);
+    REQUIRE(sink_1->lines() == sink_2->lines());
+    REQUIRE(sink_2->lines()[49] == "message 49 I");
+}
+
+TEST_CASE("fields through the queue", "[async]") {
+    using spdlog::async_queue_type;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::byte_ring}) {
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        test_sink->set_pattern("%v %k");
+        {
+            spdlog::details::thread_pool_options options;
+            options.q_max_items = queue_type == async_queue_type::byte_ring ? 4096 : 16;
+            options.queue_type = queue_type;
+            auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+            auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+            for (int i = 0; i < 20; i++) {
+                std::string path = "/index/" + std::to_string(i);
+                logger->info("request", spdlog::kv("id", i), spdlog::kv("path", path));
+            }
+        }
+        REQUIRE(test_sink->msg_counter() == 20);
+        REQUIRE(test_sink->lines()[19] == "request id:19 path:/index/19");
+    }
+}
+
+TEST_CASE("mdc through the queue", "[async]") {
+    using spdlog::async_queue_type;
+    for (auto queue_type : {async_queue_type::mutex, async_queue_type::lock_free,
+                            async_queue_type::per_thread, async_queue_type::byte_ring}) {
+        for (bool in_place : {false, true}) {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            test_sink->set_pattern("[%&] %v");
+            {
+                spdlog::details::thread_pool_options options;
+                options.q_max_items = queue_type == async_queue_type::byte_ring ? 4096 : 16;
+                options.queue_type = queue_type;
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+                if (in_place) {
+                    logger->enable_in_place_formatting();
+                }
+                spdlog::mdc::put("user", "bob");
+                for (int i = 0; i < 20; i++) {
+                    spdlog::mdc::put("request", std::to_string(i));
+                    logger->info("message {}", i);
+                }
+                spdlog::mdc::clear();
+                logger->info("no mdc");
+            }
+            auto lines = test_sink->lines();
+            REQUIRE(lines.size() == 21);
+            REQUIRE(lines[0] == "[request:0 user:bob] message 0");
+            REQUIRE(lines[19] == "[request:19 user:bob] message 19");
+            REQUIRE(lines[20] == "[] no mdc");
+        }
+    }
+}
@@ -28,6 +28,28 @@ TEST_CASE("bactrace1", "[bactrace]") {
     REQUIRE(test_sink->lines()[7] == "****************** Backtrace End ********************");
 }
 
+TEST_CASE("bactrace-memory-limit", "[bactrace]") {
+    using spdlog::sinks::test_sink_st;
+    auto test_sink = std::make_shared<test_sink_st>();
+    size_t backtrace_size = 5;
+    // "test-backtrace" + "debug message NN" = 30 bytes per message
+    spdlog::set_memory_limit(100);
+    {
+        spdlog::logger logger("test-backtrace", test_sink);
+        logger.set_pattern("%v");
+        logger.enable_backtrace(backtrace_size);
+        for (int i = 0; i < 100; i++) logger.debug("debug message {}", i);
+        REQUIRE(spdlog::memory_usage() == 90);
+
+        logger.dump_backtrace();
+        REQUIRE(spdlog::memory_usage() == 0);
+    }
+    spdlog::set_memory_limit(0);
+    REQUIRE(test_sink->lines().size() == 3 + 2);
+    REQUIRE(test_sink->lines()[1] == "debug message 97");
+    REQUIRE(test_sink->lines()[3] == "debug message 99");
+}
+
 TEST_CASE("bactrace-empty", "[bactrace]") {
     using spdlog::sinks::test_sink_st;
     auto test_sink = std::make_shared<test_sink_st>();
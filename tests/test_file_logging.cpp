@@ -6,6 +6,7 @@
 
 #define SIMPLE_LOG "test_logs/simple_log"
 #define ROTATING_LOG "test_logs/rotating_log"
+#define BINARY_LOG "test_logs/binary_log"
 
 TEST_CASE("simple_file_logger", "[simple_logger]") {
     prepare_logdir();
@@ -101,3 +102,159 @@ TEST_CASE("rotating_file_logger3", "[rotating_logger]") {
     REQUIRE_THROWS_AS(spdlog::rotating_logger_mt("logger", basename, max_size, 0),
                       spdlog::spdlog_ex);
 }
+
+TEST_CASE("simple_file_logger log_batch", "[simple_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(SIMPLE_LOG);
+
+    auto sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(filename);
+    sink->set_pattern("%v");
+    sink->set_level(spdlog::level::info);
+    std::vector<spdlog::details::log_msg> msgs;
+    msgs.emplace_back("test", spdlog::level::info, "Test message 1");
+    msgs.emplace_back("test", spdlog::level::debug, "Skipped message");
+    msgs.emplace_back("test", spdlog::level::warn, "Test message 2");
+    sink->log_batch(msgs.data(), msgs.size());
+    sink->flush();
+
+    using spdlog::details::os::default_eol;
+    REQUIRE(file_contents(SIMPLE_LOG) ==
+            spdlog::fmt_lib::format("Test message 1{}Test message 2{}", default_eol, default_eol));
+}
+
+TEST_CASE("rotating_file_logger log_batch", "[rotating_logger]") {
+    prepare_logdir();
+    size_t max_size = 1024;
+    spdlog::filename_t basename = SPDLOG_FILENAME_T(ROTATING_LOG);
+    auto sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(basename, max_size, 2);
+    sink->set_pattern("%v");
+
+    std::vector<std::string> payloads;
+    for (int i = 0; i < 100; i++) {
+        payloads.push_back(spdlog::fmt_lib::format("Test message {}", i));
+    }
+    std::vector<spdlog::details::log_msg> msgs;
+    for (const auto &payload : payloads) {
+        msgs.emplace_back("test", spdlog::level::info, payload);
+    }
+    sink->log_batch(msgs.data(), msgs.size());
+    sink->flush();
+
+    REQUIRE(get_filesize(ROTATING_LOG) <= max_size);
+    REQUIRE(get_filesize(ROTATING_LOG ".1") <= max_size);
+    REQUIRE(get_filesize(ROTATING_LOG ".1") > max_size / 2);
+}
+
+// decode the binary log, formatted by the pattern
+static std::vector<std::string> decode_binary_log(const std::string &filename,
+                                                  const std::string &pattern,
+                                                  bool *truncated = nullptr) {
+    std::ifstream in(filename, std::ios::binary);
+    spdlog::details::binary_reader reader(in);
+    spdlog::pattern_formatter formatter(pattern, spdlog::pattern_time_type::utc, "");
+    spdlog::details::log_msg msg;
+    std::vector<std::string> lines;
+    while (reader.read(msg)) {
+        spdlog::memory_buf_t formatted;
+        formatter.format(msg, formatted);
+        lines.emplace_back(formatted.data(), formatted.size());
+    }
+    if (truncated != nullptr) {
+        *truncated = reader.truncated();
+    }
+    return lines;
+}
+
+TEST_CASE("binary_file_logger", "[binary_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(BINARY_LOG);
+
+    auto logger = spdlog::binary_logger_mt("logger", filename);
+    logger->set_level(spdlog::level::trace);
+    logger->info("Test message {}", 1);
+    logger->log(spdlog::source_loc{"main.cpp", 12, "main"}, spdlog::level::err, "Test message {}",
+                2, spdlog::kv("latency_us", -5), spdlog::kv("path", "/index"),
+                spdlog::kv("ratio", 0.25), spdlog::kv("ok", true), spdlog::kv("bytes", 7u));
+    logger->trace("");
+    logger->flush();
+    spdlog::drop("logger");
+
+    auto lines = decode_binary_log(BINARY_LOG, "[%n] [%l] [%s:%#:%!] %v {%k}");
+    REQUIRE(lines == std::vector<std::string>{
+                         "[logger] [info] [::] Test message 1 {}",
+                         "[logger] [error] [main.cpp:12:main] Test message 2 {latency_us:-5 "
+                         "path:/index ratio:0.25 ok:true bytes:7}",
+                         "[logger] [trace] [::]  {}"});
+}
+
+TEST_CASE("binary_file_logger log_batch", "[binary_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(BINARY_LOG);
+
+    auto sink = std::make_shared<spdlog::sinks::binary_file_sink_mt>(filename);
+    sink->set_level(spdlog::level::info);
+    // times out of order, and before the epoch
+    std::vector<spdlog::details::log_msg> msgs;
+    msgs.emplace_back("test", spdlog::level::info, "Test message 1");
+    msgs.emplace_back("other", spdlog::level::debug, "Skipped message");
+    msgs.emplace_back("other", spdlog::level::warn, "Test message 2");
+    msgs.emplace_back("test", spdlog::level::critical, "Test message 3");
+    msgs[0].time = spdlog::log_clock::time_point(std::chrono::seconds(1700000000));
+    msgs[2].time = spdlog::log_clock::time_point(std::chrono::seconds(1600000000));
+    msgs[3].time = spdlog::log_clock::time_point(std::chrono::seconds(-1));
+    msgs[2].thread_id = 1234567;
+    sink->log_batch(msgs.data(), msgs.size());
+    sink->flush();
+
+    auto lines = decode_binary_log(BINARY_LOG, "%Y-%m-%d %T [%n] [%L] [%t] %v");
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[0].find("2023-11-14 22:13:20 [test] [I] [") == 0);
+    REQUIRE(lines[1] == "2020-09-13 12:26:40 [other] [W] [1234567] Test message 2");
+    REQUIRE(lines[2].find("1969-12-31 23:59:59 [test] [C] [") == 0);
+}
+
+TEST_CASE("binary_file_logger sessions", "[binary_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(BINARY_LOG);
+
+    // each opening of the file starts a new dictionary
+    for (int i = 0; i < 3; i++) {
+        spdlog::logger logger("logger " + std::to_string(i % 2),
+                              std::make_shared<spdlog::sinks::binary_file_sink_st>(filename));
+        logger.info("Test message {}", i);
+    }
+    REQUIRE(decode_binary_log(BINARY_LOG, "[%n] %v") ==
+            std::vector<std::string>{"[logger 0] Test message 0", "[logger 1] Test message 1",
+                                     "[logger 0] Test message 2"});
+}
+
+TEST_CASE("binary_file_logger truncated", "[binary_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(BINARY_LOG);
+    {
+        spdlog::logger logger("logger",
+                              std::make_shared<spdlog::sinks::binary_file_sink_st>(filename));
+        logger.info("Test message 1");
+        logger.info("Test message 2");
+    }
+    auto contents = file_contents(BINARY_LOG);
+    {
+        std::ofstream out(BINARY_LOG, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size() - 3));
+    }
+    bool truncated = false;
+    REQUIRE(decode_binary_log(BINARY_LOG, "%v", &truncated) ==
+            std::vector<std::string>{"Test message 1"});
+    REQUIRE(truncated);
+}
+
+TEST_CASE("binary_file_logger not binary", "[binary_logger]") {
+    prepare_logdir();
+    spdlog::filename_t filename = SPDLOG_FILENAME_T(SIMPLE_LOG);
+    {
+        spdlog::logger logger("logger",
+                              std::make_shared<spdlog::sinks::basic_file_sink_st>(filename));
+        logger.info("Test message 1");
+    }
+    REQUIRE_THROWS_AS(decode_binary_log(SIMPLE_LOG, "%v"), spdlog::spdlog_ex);
+}
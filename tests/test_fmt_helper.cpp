@@ -80,3 +80,18 @@ TEST_CASE("pad9", "[fmt_helper]") {
     test_pad9(123456789, "123456789");
     test_pad9(1234567891, "1234567891");
 }
+
+TEST_CASE("write_padded", "[fmt_helper]") {
+    char buf[9];
+    auto write = [&](uint32_t n, unsigned int width) {
+        spdlog::details::fmt_helper::write_padded(n, width, buf);
+        return std::string(buf, width);
+    };
+    REQUIRE(write(0, 1) == "0");
+    REQUIRE(write(7, 2) == "07");
+    REQUIRE(write(999, 3) == "999");
+    REQUIRE(write(42, 6) == "000042");
+    REQUIRE(write(999999, 6) == "999999");
+    REQUIRE(write(5, 9) == "000000005");
+    REQUIRE(write(987654321, 9) == "987654321");
+}
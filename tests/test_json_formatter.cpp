@@ -0,0 +1,142 @@
+#include "includes.h"
+#include "test_sink.h"
+
+using spdlog::memory_buf_t;
+using spdlog::details::to_string_view;
+
+static std::string escape_to_str(spdlog::string_view_t text) {
+    memory_buf_t buf;
+    spdlog::details::json::append_escaped(text, buf);
+    return std::string(buf.data(), buf.size());
+}
+
+// utc json of a message at 2023-11-14T22:13:20.123456Z, from thread 42
+static std::string json_to_str(spdlog::details::log_msg &msg) {
+    msg.time = spdlog::log_clock::time_point(
+        std::chrono::duration_cast<spdlog::log_clock::duration>(
+            std::chrono::microseconds(1700000000123456)));
+    msg.thread_id = 42;
+    spdlog::json_formatter formatter(spdlog::pattern_time_type::utc, "\n");
+    memory_buf_t buf;
+    formatter.format(msg, buf);
+    return std::string(buf.data(), buf.size());
+}
+
+TEST_CASE("json escape", "[json_formatter]") {
+    REQUIRE(escape_to_str("").empty());
+    REQUIRE(escape_to_str("plain text") == "plain text");
+    REQUIRE(escape_to_str("say \"hi\"") == "say \\\"hi\\\"");
+    REQUIRE(escape_to_str("c:\\dir") == "c:\\\\dir");
+    REQUIRE(escape_to_str("a\nb\tc\rd\be\ff") == "a\\nb\\tc\\rd\\be\\ff");
+    REQUIRE(escape_to_str(spdlog::string_view_t("\x01\x1f\0", 3)) == "\\u0001\\u001f\\u0000");
+    REQUIRE(escape_to_str("caf\xc3\xa9 \xe2\x82\xac") == "caf\xc3\xa9 \xe2\x82\xac");
+    REQUIRE(escape_to_str("\x7f ~") == "\x7f ~");
+}
+
+TEST_CASE("json escape of invalid utf-8", "[json_formatter]") {
+    const std::string replacement = "\xef\xbf\xbd";
+    const std::string valid = "\xf0\x9f\x98\x80 \xf4\x8f\xbf\xbf";
+    REQUIRE(escape_to_str(valid) == valid);
+    REQUIRE(escape_to_str("a\xff\"b") == "a" + replacement + "\\\"b");
+    // truncated sequences
+    REQUIRE(escape_to_str("\xc3") == replacement);
+    REQUIRE(escape_to_str("\xe2\x82x") == replacement + replacement + "x");
+    // overlong form, surrogate and code point above U+10FFFF
+    REQUIRE(escape_to_str("\xc0\xaf") == replacement + replacement);
+    REQUIRE(escape_to_str("\xed\xa0\x80") == replacement + replacement + replacement);
+    REQUIRE(escape_to_str("\xf4\x90\x80\x80") ==
+            replacement + replacement + replacement + replacement);
+    // invalid bytes found by the vector scan
+    for (size_t size : {16, 33, 64}) {
+        std::string plain(size, 'x');
+        for (size_t pos = 0; pos < size; pos++) {
+            std::string text = plain;
+            text[pos] = '\x80';
+            std::string expected = plain.substr(0, pos) + replacement + plain.substr(pos + 1);
+            REQUIRE(escape_to_str(text) == expected);
+        }
+    }
+}
+
+TEST_CASE("json escape of long text", "[json_formatter]") {
+    // an escape at every position of text longer than the vector widths
+    for (size_t size : {15, 16, 17, 31, 32, 33, 64, 100}) {
+        std::string plain(size, 'x');
+        REQUIRE(escape_to_str(plain) == plain);
+        for (size_t pos = 0; pos < size; pos++) {
+            std::string text = plain;
+            text[pos] = '"';
+            std::string expected = plain.substr(0, pos) + "\\\"" + plain.substr(pos + 1);
+            REQUIRE(escape_to_str(text) == expected);
+            text[pos] = '\x05';
+            expected = plain.substr(0, pos) + "\\u0005" + plain.substr(pos + 1);
+            REQUIRE(escape_to_str(text) == expected);
+        }
+    }
+}
+
+TEST_CASE("json formatter", "[json_formatter]") {
+    spdlog::details::log_msg msg("my \"logger\"", spdlog::level::warn, "hello\nworld");
+    REQUIRE(json_to_str(msg) ==
+            "{\"time\":\"2023-11-14T22:13:20.123456Z\",\"level\":\"warning\","
+            "\"logger\":\"my \\\"logger\\\"\",\"thread\":42,\"message\":\"hello\\nworld\"}\n");
+}
+
+TEST_CASE("json formatter source and fields", "[json_formatter]") {
+    spdlog::details::log_msg msg(spdlog::source_loc{"main.cpp", 12, "main"}, "app",
+                                 spdlog::level::info, "request done");
+    spdlog::field fields[] = {
+        spdlog::kv("latency_us", 123),  spdlog::kv("bytes", 7u),
+        spdlog::kv("ratio", 0.5),       spdlog::kv("cached", true),
+        spdlog::kv("path", "/a\"b"),    spdlog::kv("bad", std::numeric_limits<double>::infinity())};
+    msg.fields = spdlog::field_list(fields, 6);
+    REQUIRE(json_to_str(msg) ==
+            "{\"time\":\"2023-11-14T22:13:20.123456Z\",\"level\":\"info\",\"logger\":\"app\","
+            "\"thread\":42,\"source\":{\"file\":\"main.cpp\",\"line\":12,\"function\":\"main\"},"
+            "\"fields\":{\"latency_us\":123,\"bytes\":7,\"ratio\":0.5,\"cached\":true,"
+            "\"path\":\"/a\\\"b\",\"bad\":null},\"message\":\"request done\"}\n");
+}
+
+TEST_CASE("json formatter mdc", "[json_formatter]") {
+    spdlog::mdc::put("user", "bob");
+    spdlog::mdc::put("session", "a\tb");
+    spdlog::details::log_msg msg("app", spdlog::level::err, "failed");
+    auto json = json_to_str(msg);
+    spdlog::mdc::clear();
+    REQUIRE(json ==
+            "{\"time\":\"2023-11-14T22:13:20.123456Z\",\"level\":\"error\",\"logger\":\"app\","
+            "\"thread\":42,\"mdc\":{\"session\":\"a\\tb\",\"user\":\"bob\"},"
+            "\"message\":\"failed\"}\n");
+}
+
+TEST_CASE("json formatter sink", "[json_formatter]") {
+    auto sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    sink->set_formatter(spdlog::details::make_unique<spdlog::json_formatter>());
+    spdlog::logger logger("json", sink);
+    logger.info("user {} logged in", "bob", spdlog::kv("attempts", 2));
+    logger.info("second");
+
+    auto lines = sink->lines();
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].front() == '{');
+    REQUIRE(lines[0].back() == '}');
+    REQUIRE(lines[0].find("\"logger\":\"json\"") != std::string::npos);
+    REQUIRE(lines[0].find("\"fields\":{\"attempts\":2}") != std::string::npos);
+    REQUIRE(lines[0].find("\"message\":\"user bob logged in\"}") != std::string::npos);
+    REQUIRE(lines[1].find("\"fields\"") == std::string::npos);
+    REQUIRE(lines[1].find("\"message\":\"second\"}") != std::string::npos);
+    // local time with its utc offset
+    auto offset = lines[1].substr(lines[1].find("\",\"level\"") - 6, 6);
+    REQUIRE((offset[0] == '+' || offset[0] == '-'));
+    REQUIRE(offset[3] == ':');
+}
+
+TEST_CASE("json formatter clone", "[json_formatter]") {
+    spdlog::json_formatter formatter(spdlog::pattern_time_type::utc, "\n");
+    auto cloned = formatter.clone();
+    spdlog::details::log_msg msg("app", spdlog::level::info, "cloned");
+    memory_buf_t original_buf, cloned_buf;
+    formatter.format(msg, original_buf);
+    cloned->format(msg, cloned_buf);
+    REQUIRE(to_string_view(original_buf) == to_string_view(cloned_buf));
+}
@@ -74,6 +74,27 @@ TEST_CASE("enqueue_nowait", "[mpmc_blocking_q]") {
     REQUIRE(q.overrun_counter() == 1);
 }
 
+TEST_CASE("enqueue_for", "[mpmc_blocking_q]") {
+    spdlog::details::mpmc_blocking_queue<int> q(1);
+    REQUIRE(q.enqueue_for(1, milliseconds(10)));
+
+    auto start = test_clock::now();
+    REQUIRE_FALSE(q.enqueue_for(2, milliseconds(10)));
+    REQUIRE(millis_from(start) >= milliseconds(9));
+    REQUIRE(q.discard_counter() == 1);
+
+    std::thread consumer([&q] {
+        std::this_thread::sleep_for(milliseconds(10));
+        int item = 0;
+        q.dequeue(item);
+    });
+    REQUIRE(q.enqueue_for(3, milliseconds(10000)));
+    consumer.join();
+    int item = 0;
+    q.dequeue(item);
+    REQUIRE(item == 3);
+}
+
 TEST_CASE("bad_queue", "[mpmc_blocking_q]") {
     size_t q_size = 0;
     spdlog::details::mpmc_blocking_queue<int> q(q_size);
@@ -112,3 +133,215 @@ TEST_CASE("full_queue", "[mpmc_blocking_q]") {
     q.dequeue(item);
     REQUIRE(item == 123456);
 }
+
+TEST_CASE("try_dequeue_bulk", "[mpmc_blocking_q]") {
+    size_t q_size = 10;
+    spdlog::details::mpmc_blocking_queue<int> q(q_size);
+    int items[4] = {};
+    REQUIRE(q.try_dequeue_bulk(items, 4) == 0);
+
+    for (int i = 0; i < 6; i++) {
+        q.enqueue(i + 0);
+    }
+    REQUIRE(q.try_dequeue_bulk(items, 4) == 4);
+    REQUIRE(items[0] == 0);
+    REQUIRE(items[3] == 3);
+    REQUIRE(q.try_dequeue_bulk(items, 4) == 2);
+    REQUIRE(items[1] == 5);
+    REQUIRE(q.try_dequeue_bulk(items, 4) == 0);
+}
+
+TEST_CASE("lockfree_dequeue-empty-nowait", "[mpmc_lockfree_q]") {
+    spdlog::details::mpmc_lockfree_queue<int> q(100);
+    int popped_item = 0;
+    REQUIRE(q.dequeue_for(popped_item, milliseconds::zero()) == false);
+}
+
+TEST_CASE("lockfree_enqueue_nowait", "[mpmc_lockfree_q]") {
+    spdlog::details::mpmc_lockfree_queue<int> q(2);
+    q.enqueue(1);
+    q.enqueue(2);
+    REQUIRE(q.overrun_counter() == 0);
+
+    q.enqueue_nowait(3);
+    REQUIRE(q.overrun_counter() == 1);
+    REQUIRE(q.size() == 2);
+
+    int item = 0;
+    q.dequeue(item);
+    REQUIRE(item == 2);
+    q.dequeue(item);
+    REQUIRE(item == 3);
+}
+
+TEST_CASE("lockfree_enqueue_if_have_room", "[mpmc_lockfree_q]") {
+    spdlog::details::mpmc_lockfree_queue<int> q(2);
+    q.enqueue(1);
+    q.enqueue(2);
+    q.enqueue_if_have_room(3);
+    REQUIRE(q.discard_counter() == 1);
+    REQUIRE(q.size() == 2);
+}
+
+TEST_CASE("lockfree_bad_queue", "[mpmc_lockfree_q]") {
+    spdlog::details::mpmc_lockfree_queue<int> q(0);
+    q.enqueue_nowait(1);
+    REQUIRE(q.overrun_counter() == 1);
+    int i = 0;
+    REQUIRE(q.dequeue_for(i, milliseconds(0)) == false);
+}
+
+TEST_CASE("lockfree_multi_producers", "[mpmc_lockfree_q]") {
+    spdlog::details::mpmc_lockfree_queue<int> q(16);
+    const int n_threads = 4;
+    const int per_thread = 10000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < n_threads; t++) {
+        producers.emplace_back([&q] {
+            for (int i = 0; i < per_thread; i++) {
+                q.enqueue(1);
+            }
+        });
+    }
+
+    long long sum = 0;
+    for (int i = 0; i < n_threads * per_thread; i++) {
+        int item = 0;
+        q.dequeue(item);
+        sum += item;
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    REQUIRE(sum == n_threads * per_thread);
+    REQUIRE(q.size() == 0);
+}
+
+namespace {
+struct stamped_item {
+    int value = 0;
+    std::chrono::system_clock::time_point time;
+};
+}  // namespace
+
+TEST_CASE("lanes_merge_in_time_order", "[spsc_lanes_q]") {
+    spdlog::details::spsc_lanes_queue<stamped_item> q(10);
+    auto push_values = [&q](std::vector<int> values) {
+        for (int v : values) {
+            stamped_item item;
+            item.value = v;
+            item.time = std::chrono::system_clock::time_point(std::chrono::seconds(v));
+            q.enqueue(std::move(item));
+        }
+    };
+    std::thread t1(push_values, std::vector<int>{1, 3, 5});
+    t1.join();
+    std::thread t2(push_values, std::vector<int>{2, 4, 6});
+    t2.join();
+
+    REQUIRE(q.lanes_count() == 2);
+    REQUIRE(q.size() == 6);
+    for (int expected = 1; expected <= 6; expected++) {
+        stamped_item item;
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item.value == expected);
+    }
+    stamped_item item;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+}
+
+TEST_CASE("lanes_overflow_policies", "[spsc_lanes_q]") {
+    spdlog::details::spsc_lanes_queue<stamped_item> q(2);
+    for (int i = 0; i < 3; i++) {
+        stamped_item item;
+        item.value = i;
+        q.enqueue_nowait(std::move(item));
+    }
+    REQUIRE(q.overrun_counter() == 1);
+    stamped_item item;
+    q.enqueue_if_have_room(std::move(item));
+    REQUIRE(q.discard_counter() == 1);
+
+    q.dequeue(item);
+    REQUIRE(item.value == 1);
+    q.dequeue(item);
+    REQUIRE(item.value == 2);
+}
+
+TEST_CASE("lanes_bulk_merge", "[spsc_lanes_q]") {
+    spdlog::details::spsc_lanes_queue<stamped_item> q(10);
+    auto push_values = [&q](std::vector<int> values) {
+        for (int v : values) {
+            stamped_item item;
+            item.value = v;
+            item.time = std::chrono::system_clock::time_point(std::chrono::seconds(v));
+            q.enqueue(std::move(item));
+        }
+    };
+    std::thread t1(push_values, std::vector<int>{1, 4, 7});
+    t1.join();
+    std::thread t2(push_values, std::vector<int>{2, 5, 8});
+    t2.join();
+    std::thread t3(push_values, std::vector<int>{3, 6});
+    t3.join();
+
+    stamped_item items[5];
+    REQUIRE(q.try_dequeue_bulk(items, 5) == 5);
+    for (int i = 0; i < 5; i++) {
+        REQUIRE(items[i].value == i + 1);
+    }
+    REQUIRE(q.dequeue_bulk(items + 0, 1) == 1);
+    REQUIRE(items[0].value == 6);
+    REQUIRE(q.dequeue_bulk_for(items + 1, 4, milliseconds(0)) == 2);
+    REQUIRE(items[1].value == 7);
+    REQUIRE(items[2].value == 8);
+    REQUIRE(q.dequeue_bulk_for(items, 4, milliseconds(0)) == 0);
+}
+
+namespace {
+struct tracked_item {
+    std::shared_ptr<int> token;
+    std::chrono::system_clock::time_point time;
+};
+}  // namespace
+
+TEST_CASE("lanes_freed_with_queue", "[spsc_lanes_q]") {
+    auto token = std::make_shared<int>(0);
+    {
+        spdlog::details::spsc_lanes_queue<tracked_item> q(4);
+        for (int i = 0; i < 3; i++) {
+            tracked_item item;
+            item.token = token;
+            q.enqueue(std::move(item));
+        }
+        REQUIRE(token.use_count() == 4);
+    }
+    // this thread still holds its lane of the destroyed queue, but not the items
+    REQUIRE(token.use_count() == 1);
+}
+
+TEST_CASE("lanes_released_after_threads_exit", "[spsc_lanes_q]") {
+    spdlog::details::spsc_lanes_queue<stamped_item> q(10);
+    for (int i = 0; i < 8; i++) {
+        std::thread t([&q, i] {
+            stamped_item item;
+            item.value = i;
+            q.enqueue(std::move(item));
+        });
+        t.join();
+    }
+    REQUIRE(q.lanes_count() == 8);
+
+    stamped_item items[10];
+    REQUIRE(q.try_dequeue_bulk(items, 10) == 8);
+    // the next scan finds the drained lanes of the exited threads and releases them
+    REQUIRE(q.try_dequeue_bulk(items, 10) == 0);
+    REQUIRE(q.lanes_count() == 0);
+
+    // a live producer keeps its lane
+    stamped_item item;
+    q.enqueue(std::move(item));
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(q.dequeue_for(item, milliseconds(0)) == false);
+    REQUIRE(q.lanes_count() == 1);
+}
@@ -372,6 +372,215 @@ TEST_CASE("clone-custom_formatter", "[pattern_formatter]") {
     REQUIRE(to_string_view(formatted_2) == expected);
 }
 
+// the clones share the compiled pattern, but each has its own objects for the flags with state
+TEST_CASE("clone-formatter-stateful-flags", "[pattern_formatter]") {
+    auto formatter_1 = std::make_shared<spdlog::pattern_formatter>();
+    formatter_1->add_flag<custom_test_flag>('*', "txt").set_pattern(
+        "[%O] [%2*] [%-6l] [%q] [100%%] [%3!!] %v");
+    auto formatter_2 = formatter_1->clone();
+    spdlog::source_loc source_loc{"myfile.cpp", 123, "some_func()"};
+    spdlog::details::log_msg msg(source_loc, "logger-name", spdlog::level::info, "some message");
+
+    memory_buf_t formatted_1;
+    memory_buf_t formatted_2;
+    formatter_1->format(msg, formatted_1);
+    formatted_1.clear();
+    formatter_1->format(msg, formatted_1);
+    formatter_2->format(msg, formatted_2);
+
+    // custom_test_flag prepends the padding to its text on each call
+    std::string rest = "txt] [info  ] [%q] [100%] [som] some message";
+    rest += spdlog::details::os::default_eol;
+    REQUIRE(to_string_view(formatted_1) == "[0] [    " + rest);
+    REQUIRE(to_string_view(formatted_2) == "[0] [  " + rest);
+}
+
+TEST_CASE("cached time prefix", "[pattern_formatter]") {
+    spdlog::pattern_formatter formatter("[%Y-%m-%dT%H:%M:%S.%f%z] [%e|%F] [%l] %v",
+                                        spdlog::pattern_time_type::utc, "\n");
+    spdlog::details::log_msg msg(spdlog::source_loc{}, "logger-name", spdlog::level::info,
+                                 "some message");
+    auto format_at = [&](std::chrono::microseconds since_epoch) {
+        msg.time = spdlog::log_clock::time_point(
+            std::chrono::duration_cast<spdlog::log_clock::duration>(since_epoch));
+        memory_buf_t formatted;
+        formatter.format(msg, formatted);
+        return std::string(formatted.data(), formatted.size());
+    };
+    const auto second = std::chrono::seconds(1700000000);  // 2023-11-14 22:13:20 UTC
+
+    REQUIRE(format_at(second + std::chrono::microseconds(123456)) ==
+            "[2023-11-14T22:13:20.123456+00:00] [123|123456000] [info] some message\n");
+    // same second - only the fractions change
+    REQUIRE(format_at(second + std::chrono::microseconds(987001)) ==
+            "[2023-11-14T22:13:20.987001+00:00] [987|987001000] [info] some message\n");
+    REQUIRE(format_at(second + std::chrono::microseconds(5)) ==
+            "[2023-11-14T22:13:20.000005+00:00] [000|000005000] [info] some message\n");
+    // next second
+    REQUIRE(format_at(second + std::chrono::microseconds(1000042)) ==
+            "[2023-11-14T22:13:21.000042+00:00] [000|000042000] [info] some message\n");
+
+    // padded fractions are not cached
+    formatter.set_pattern("%H:%M:%S.%-4e %v");
+    REQUIRE(format_at(second + std::chrono::microseconds(7000)) == "22:13:20.007  some message\n");
+    REQUIRE(format_at(second + std::chrono::microseconds(8000)) == "22:13:20.008  some message\n");
+}
+
+TEST_CASE("shared output of identical formatters", "[pattern_formatter]") {
+    spdlog::details::log_msg msg(spdlog::source_loc{}, "logger-name", spdlog::level::info,
+                                 "some message");
+    spdlog::pattern_formatter formatter_1("[%^%l%$] %v", spdlog::pattern_time_type::local, "\n");
+    spdlog::pattern_formatter formatter_2("[%^%l%$] %v", spdlog::pattern_time_type::local, "\n");
+    spdlog::pattern_formatter other_eol("[%^%l%$] %v", spdlog::pattern_time_type::local, ";\n");
+    spdlog::pattern_formatter stateful("[%^%l%$] %v%i", spdlog::pattern_time_type::local, "\n");
+
+    spdlog::details::format_cache cache(&msg, 1);
+    spdlog::details::format_cache::scope cache_scope(cache);
+    memory_buf_t formatted_1;
+    formatter_1.format(msg, formatted_1);
+    REQUIRE(to_string_view(formatted_1) == "[info] some message\n");
+
+    // formatter_2 copies the output of formatter_1, even though the payload changed since
+    msg.payload = "other message";
+    memory_buf_t formatted_2;
+    formatted_2.push_back('>');
+    formatter_2.format(msg, formatted_2);
+    REQUIRE(to_string_view(formatted_2) == ">[info] some message\n");
+    REQUIRE(msg.color_range_start == 2);
+    REQUIRE(msg.color_range_end == 6);
+
+    memory_buf_t formatted_3;
+    other_eol.format(msg, formatted_3);
+    REQUIRE(to_string_view(formatted_3) == "[info] other message;\n");
+
+    memory_buf_t formatted_4;
+    stateful.format(msg, formatted_4);
+    REQUIRE(to_string_view(formatted_4) == "[info] other message0\n");
+}
+
+TEST_CASE("shared output of logger sinks", "[pattern_formatter]") {
+    auto sink_1 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink_2 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink_3 = std::make_shared<spdlog::sinks::test_sink_st>();
+    sink_1->set_pattern("[%n] %v");
+    sink_2->set_pattern("[%n] %v");
+    sink_3->set_pattern("%v [%n]");
+    spdlog::logger logger("test", {sink_1, sink_2, sink_3});
+
+    logger.info("message {}", 1);
+    logger.warn("message {}", 2);
+    std::vector<std::string> expected = {"[test] message 1", "[test] message 2"};
+    REQUIRE(sink_1->lines() == expected);
+    REQUIRE(sink_2->lines() == expected);
+    REQUIRE(sink_3->lines() == std::vector<std::string>{"message 1 [test]", "message 2 [test]"});
+}
+
+TEST_CASE("shared output only for shared fingerprints", "[pattern_formatter]") {
+    using spdlog::details::format_cache;
+    auto sink_1 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink_2 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink_3 = std::make_shared<spdlog::sinks::test_sink_st>();
+    sink_1->set_pattern("[%n] %v");
+    sink_2->set_pattern("%v [%n]");
+    sink_3->set_pattern("%v [%n] %i");  // not shareable
+    // console + file with different patterns - no cache
+    REQUIRE(format_cache::shared_fingerprint({sink_1, sink_2, sink_3}) == 0);
+    auto dist = std::make_shared<spdlog::sinks::dist_sink_st>();
+    REQUIRE(format_cache::shared_fingerprint(std::vector<spdlog::sink_ptr>{sink_1, dist}) == 0);
+
+    sink_3->set_pattern("[%n] %v");
+    auto fingerprint = format_cache::shared_fingerprint({sink_1, sink_2, sink_3});
+    REQUIRE(fingerprint != 0);
+    REQUIRE(fingerprint == sink_1->format_fingerprint());
+
+    // only the output of the shared fingerprint is stored
+    spdlog::details::log_msg msg(spdlog::source_loc{}, "logger-name", spdlog::level::info,
+                                 "some message");
+    spdlog::pattern_formatter formatter_1("[%n] %v");
+    spdlog::pattern_formatter formatter_2("%v [%n]");
+    REQUIRE(formatter_1.fingerprint() == fingerprint);
+    format_cache cache(&msg, 1, fingerprint);
+    memory_buf_t formatted;
+    formatter_2.format(msg, formatted);
+    REQUIRE_FALSE(cache.append_to(msg, formatter_2.fingerprint(), "key 2", formatted));
+    formatted.clear();
+    formatter_1.format(msg, formatted);
+    cache.store(msg, fingerprint, "key 1", formatted, 0, false);
+    memory_buf_t copied;
+    REQUIRE(cache.append_to(msg, fingerprint, "key 1", copied));
+    REQUIRE(to_string_view(copied) == to_string_view(formatted));
+    // a colliding fingerprint of a different key doesn't get the output
+    copied.clear();
+    REQUIRE_FALSE(cache.append_to(msg, fingerprint, "key 2", copied));
+    REQUIRE(copied.size() == 0);
+}
+
+TEST_CASE("sinks fingerprint is found once per change", "[pattern_formatter]") {
+    auto sink_1 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink_2 = std::make_shared<spdlog::sinks::test_sink_st>();
+    sink_1->set_pattern("[%n] %v");
+    sink_2->set_pattern("%v [%n]");
+    std::vector<spdlog::sink_ptr> sinks{sink_1, sink_2};
+    spdlog::details::sinks_fingerprint fingerprint;
+    REQUIRE(fingerprint.get(sinks) == 0);
+
+    // a change the owner didn't report keeps the stored fingerprint
+    sinks.push_back(sink_1);
+    REQUIRE(fingerprint.get(sinks) == 0);
+    fingerprint.invalidate();
+    REQUIRE(fingerprint.get(sinks) == sink_1->format_fingerprint());
+    sinks.pop_back();
+    fingerprint.invalidate();
+    REQUIRE(fingerprint.get(sinks) == 0);
+
+    // a sink replacing its formatter starts a new generation
+    auto generation = spdlog::sinks::sink::format_generation();
+    sink_2->set_pattern("[%n] %v");
+    REQUIRE(spdlog::sinks::sink::format_generation() != generation);
+    REQUIRE(fingerprint.get(sinks) == sink_1->format_fingerprint());
+}
+
+TEST_CASE("fields formatter", "[pattern_formatter]") {
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    test_sink->set_pattern("%v [%k]");
+    spdlog::logger logger("test", test_sink);
+    std::string path = "/index";
+
+    logger.info("request done", spdlog::kv("latency_us", 123), spdlog::kv("path", path));
+    logger.info("no fields");
+    logger.info("value {}", spdlog::kv("ok", true), spdlog::kv("ratio", 0.5),
+                spdlog::kv("size", static_cast<size_t>(42)), spdlog::kv("delta", -7));
+    test_sink->set_pattern("%v [%-12k]");
+    logger.info("padded", spdlog::kv("a", "b"));
+
+    REQUIRE(test_sink->lines() ==
+            std::vector<std::string>{"request done [latency_us:123 path:/index]", "no fields []",
+                                     "value ok:true [ok:true ratio:0.5 size:42 delta:-7]",
+                                     "padded [a:b         ]"});
+}
+
+TEST_CASE("fields copied by log_msg_buffer", "[pattern_formatter]") {
+    std::string key = "path";
+    std::string value = "/index";
+    spdlog::field fields[] = {spdlog::kv(key, value), spdlog::kv("latency_us", 123)};
+    spdlog::details::log_msg msg(spdlog::source_loc{}, "logger-name", spdlog::level::info,
+                                 "request done");
+    msg.fields = spdlog::field_list(fields, 2);
+
+    spdlog::details::log_msg_buffer copy(msg);
+    key = "XXXX";
+    value = "XXXXXX";
+    auto moved = std::move(copy);
+    REQUIRE(moved.fields.size() == 2);
+    REQUIRE(moved.fields[0].key() == "path");
+    REQUIRE(moved.fields[0].type() == spdlog::field_type::string);
+    REQUIRE(moved.fields[0].string() == "/index");
+    REQUIRE(moved.fields[1].key() == "latency_us");
+    REQUIRE(moved.fields[1].type() == spdlog::field_type::signed_int);
+    REQUIRE(moved.fields[1].signed_int() == 123);
+    REQUIRE(moved.payload == "request done");
+}
+
 //
 // Test source location formatting
 //
@@ -628,3 +837,145 @@ TEST_CASE("mdc empty", "[pattern_formatter]") {
 
     SECTION("Tear down") { spdlog::mdc::clear(); }
 }
+
+TEST_CASE("mdc put and remove", "[pattern_formatter]") {
+    auto text = [] {
+        auto view = spdlog::mdc::view();
+        return std::string(view.text().data(), view.text().size());
+    };
+    spdlog::mdc::put("m", "1");
+    spdlog::mdc::put("z", "2");
+    spdlog::mdc::put("a", "3");
+    spdlog::mdc::put("q", "4");
+    REQUIRE(text() == "a:3 m:1 q:4 z:2");
+    spdlog::mdc::put("m", "a longer value");
+    spdlog::mdc::put("z", "");
+    spdlog::mdc::put("a", "x");
+    REQUIRE(text() == "a:x m:a longer value q:4 z:");
+    REQUIRE(spdlog::mdc::get("m") == "a longer value");
+    REQUIRE(spdlog::mdc::get("z").empty());
+    REQUIRE(spdlog::mdc::get("b").empty());
+
+    spdlog::mdc::remove("q");
+    REQUIRE(text() == "a:x m:a longer value z:");
+    spdlog::mdc::remove("z");
+    REQUIRE(text() == "a:x m:a longer value");
+    spdlog::mdc::remove("a");
+    spdlog::mdc::remove("b");
+    REQUIRE(text() == "m:a longer value");
+    spdlog::mdc::remove("m");
+    REQUIRE(text().empty());
+    REQUIRE(spdlog::mdc::view().empty());
+
+    // more than fits in the inline buffers
+    std::string expected;
+    for (int i = 99; i >= 0; i--) {
+        spdlog::mdc::put(spdlog::fmt_lib::format("key_{:02}", i), std::to_string(i));
+    }
+    for (int i = 0; i < 100; i++) {
+        expected += spdlog::fmt_lib::format("{}key_{:02}:{}", i == 0 ? "" : " ", i, i);
+    }
+    REQUIRE(text() == expected);
+    auto view = spdlog::mdc::view();
+    REQUIRE(view.size() == 100);
+    REQUIRE(view.key(42) == "key_42");
+    REQUIRE(view.value(42) == "42");
+
+    SECTION("Tear down") { spdlog::mdc::clear(); }
+}
+
+TEST_CASE("mdc get_context", "[pattern_formatter]") {
+    REQUIRE(spdlog::mdc::get_context().empty());
+    spdlog::mdc::put("b", "2");
+    spdlog::mdc::put("a", "1");
+    const auto &context = spdlog::mdc::get_context();
+    REQUIRE(context.size() == 2);
+    REQUIRE(context.at("a") == "1");
+    REQUIRE(context.at("b") == "2");
+    std::string joined;
+    for (const auto &item : spdlog::mdc::get_context()) {
+        joined += item.first + "=" + item.second + ";";
+    }
+    REQUIRE(joined == "a=1;b=2;");
+    spdlog::mdc::remove("a");
+    REQUIRE(spdlog::mdc::get_context().count("a") == 0);
+
+    SECTION("Tear down") { spdlog::mdc::clear(); }
+}
+
+TEST_CASE("mdc padded", "[pattern_formatter]") {
+    spdlog::mdc::put("k1", "v1");
+    spdlog::mdc::put("k2", "v2");
+    REQUIRE(log_to_str("msg", "[%-7&] %v", spdlog::pattern_time_type::local, "\n") ==
+            "[k1:v1  k2:v2  ] msg\n");
+    spdlog::mdc::clear();
+    REQUIRE(log_to_str("msg", "[%4&] %v", spdlog::pattern_time_type::local, "\n") ==
+            "[    ] msg\n");
+}
+
+TEST_CASE("mdc copied by log_msg_buffer", "[pattern_formatter]") {
+    spdlog::pattern_formatter formatter("[%&] %v", spdlog::pattern_time_type::local, "");
+    spdlog::details::log_msg msg("logger-name", spdlog::level::info, "some message");
+    spdlog::mdc::put("mdc_key", "at log time");
+    spdlog::details::log_msg_buffer buffer(msg);
+    spdlog::mdc::put("mdc_key", "later");
+    spdlog::mdc::put("other_key", "later");
+
+    auto copy = buffer;
+    spdlog::details::log_msg_buffer moved(std::move(buffer));
+    for (auto *m : {&copy, &moved}) {
+        memory_buf_t formatted;
+        formatter.format(*m, formatted);
+        REQUIRE(to_string_view(formatted) == "[mdc_key:at log time] some message");
+    }
+    // the message itself uses the MDC of the thread formatting it
+    memory_buf_t formatted;
+    formatter.format(msg, formatted);
+    REQUIRE(to_string_view(formatted) == "[mdc_key:later other_key:later] some message");
+
+    SECTION("Tear down") { spdlog::mdc::clear(); }
+}
+
+#ifdef SPDLOG_HAS_COMPILED_PATTERN
+// format msg by the compiled pattern and by pattern_formatter with the same pattern
+template <spdlog::details::compiled::pattern_string Pattern>
+static void require_same_as_runtime(const spdlog::details::log_msg &msg) {
+    memory_buf_t compiled, runtime;
+    spdlog::compiled_pattern<Pattern> compiled_formatter(spdlog::pattern_time_type::utc, "\n");
+    spdlog::pattern_formatter runtime_formatter(Pattern.data, spdlog::pattern_time_type::utc,
+                                                "\n");
+    compiled_formatter.format(msg, compiled);
+    // twice, to use the cached time
+    compiled.clear();
+    compiled_formatter.format(msg, compiled);
+    runtime_formatter.format(msg, runtime);
+    REQUIRE(to_string_view(compiled) == to_string_view(runtime));
+}
+
+TEST_CASE("compiled pattern", "[pattern_formatter]") {
+    spdlog::details::log_msg msg(spdlog::source_loc{"a/b/c/myfile.cpp", 123, "some_func()"},
+                                 "logger-name", spdlog::level::warn, "some message");
+    require_same_as_runtime<"[%Y-%m-%d %H:%M:%S.%e] [%l] %v">(msg);
+    require_same_as_runtime<"[%D %X] [%L] [%n] [%t] [%P] %v">(msg);
+    require_same_as_runtime<"%C %I %p %R %T %x %f %F %E">(msg);
+    require_same_as_runtime<"[%@] [%s] [%g] [%#] [%!] 100%% %v %">(msg);
+    require_same_as_runtime<"">(msg);
+    require_same_as_runtime<"no flags">(msg);
+
+    spdlog::details::log_msg no_source(spdlog::source_loc{}, "logger-name", spdlog::level::info,
+                                       "some message");
+    require_same_as_runtime<"[%@] [%s] [%#] %v">(no_source);
+
+    memory_buf_t formatted;
+    spdlog::compiled_pattern<"%^%l%$ %v"> color_formatter;
+    color_formatter.format(msg, formatted);
+    REQUIRE(msg.color_range_start == 0);
+    REQUIRE(msg.color_range_end == 7);
+
+    auto cloned = color_formatter.clone();
+    formatted.clear();
+    cloned->format(msg, formatted);
+    REQUIRE(to_string_view(formatted) ==
+            spdlog::fmt_lib::format("warning some message{}", spdlog::details::os::default_eol));
+}
+#endif
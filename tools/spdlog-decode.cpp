@@ -0,0 +1,94 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+// spdlog-decode - write the logs of binary_file_sink as text, formatted by any pattern.
+//
+// Usage: spdlog-decode [-p <pattern>] [-u] [file...]
+//   -p <pattern>  pattern of the output (see pattern_formatter, default "%+")
+//   -u            format the time as utc (default is local time)
+// The files (or stdin if none) are decoded in order to stdout.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+#include "spdlog/spdlog.h"
+#include "spdlog/details/binary_format.h"
+#include "spdlog/pattern_formatter.h"
+
+static void usage(const char *program) {
+    std::fprintf(stderr,
+                 "Usage: %s [-p <pattern>] [-u] [file...]\n"
+                 "  -p <pattern>  pattern of the output (default \"%%+\")\n"
+                 "  -u            format the time as utc (default is local time)\n"
+                 "Decodes the binary logs (or stdin if no file) to stdout.\n",
+                 program);
+}
+
+// decode the stream to stdout. return false on errors.
+static bool decode(std::istream &in, const std::string &name, spdlog::formatter &formatter) {
+    spdlog::details::binary_reader reader(in);
+    spdlog::details::log_msg msg;
+    spdlog::memory_buf_t formatted;
+    try {
+        while (reader.read(msg)) {
+            formatted.clear();
+            formatter.format(msg, formatted);
+            std::fwrite(formatted.data(), 1, formatted.size(), stdout);
+        }
+    } catch (const spdlog::spdlog_ex &ex) {
+        std::fprintf(stderr, "spdlog-decode: %s: %s\n", name.c_str(), ex.what());
+        return false;
+    }
+    if (reader.truncated()) {
+        std::fprintf(stderr, "spdlog-decode: %s: the last record is truncated\n", name.c_str());
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::string pattern = "%+";
+    auto time_type = spdlog::pattern_time_type::local;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pattern = argv[++i];
+        } else if (std::strcmp(argv[i], "-u") == 0) {
+            time_type = spdlog::pattern_time_type::utc;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            files.emplace_back(argv[i]);
+        }
+    }
+
+    spdlog::pattern_formatter formatter(pattern, time_type);
+    bool ok = true;
+    if (files.empty()) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        ok = decode(std::cin, "stdin", formatter);
+    }
+    for (auto &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "spdlog-decode: %s: %s\n", file.c_str(), std::strerror(errno));
+            ok = false;
+            continue;
+        }
+        ok = decode(in, file, formatter) && ok;
+    }
+    std::fflush(stdout);
+    return ok ? 0 : 1;
+}